@@ -0,0 +1,241 @@
+#include "bench_e2e.h"
+#include "fpsi_receiver.h"
+#include "fpsi_receiver_fhe.h"
+#include "fpsi_sender.h"
+#include "fpsi_sender_fhe.h"
+#include "cryptoTools/Network/Session.h"
+#include "cryptoTools/Network/IOService.h"
+#include "link_emulator.h"
+#include "dataset.h"
+#include "hamming.h"
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <set>
+#include <thread>
+
+namespace bench_e2e {
+
+namespace {
+
+// 两端各自只写 result 中属于自己的字段
+void runReceiver(const Config& config, const std::string& data_path, Result& result) {
+    FPSIReceiver receiver(config.n, config.d, config.delta, config.L, config.threads);
+    if (data_path.empty()) {
+        receiver.generateData();
+    } else {
+        receiver.loadData(data_path);
+    }
+
+    osuCrypto::IOService ios;
+    std::string address = "127.0.0.1:" + std::to_string(config.port);
+    osuCrypto::Session session(ios, address, osuCrypto::SessionMode::Server);
+    osuCrypto::Channel chl = session.addChannel();
+
+    receiver.runOffline(chl);
+    receiver.runOnline(chl);
+    chl.close();
+
+    result.receiver_offline_seconds = receiver.offlineTime();
+    result.receiver_online_seconds = receiver.onlineTime();
+    result.receiver_offline = receiver.offlineComm();
+    result.receiver_online = receiver.onlineComm();
+    result.matches = receiver.matches();
+}
+
+void runSender(const Config& config, int port, const std::string& data_path, Result& result) {
+    FPSISender sender(config.m, config.d, config.delta, config.L, config.threads);
+    if (data_path.empty()) {
+        sender.generateData();
+    } else {
+        sender.loadData(data_path);
+    }
+
+    osuCrypto::IOService ios;
+    osuCrypto::Session session(ios, "127.0.0.1", static_cast<u32>(port),
+                               osuCrypto::SessionMode::Client);
+    osuCrypto::Channel chl = session.addChannel();
+
+    sender.runOffline(chl);
+    sender.runOnline(chl);
+    chl.close();
+
+    result.sender_offline_seconds = sender.offlineTime();
+    result.sender_online_seconds = sender.onlineTime();
+    result.sender_offline = sender.offlineComm();
+    result.sender_online = sender.onlineComm();
+}
+
+// FHE 协议的 threads 为在线阶段的并行信道数，两端取较小者
+int onlineThreads(const Config& config) {
+    return config.threads > 0 ? config.threads : ThreadPool::hardwareThreads();
+}
+
+void runReceiverFHE(const Config& config, const std::string& data_path, Result& result,
+                    std::set<int>& matched) {
+    FPSIReceiverFixed receiver(config.n, config.d, config.delta, config.L,
+                               bfv_planner::plan(config.d, config.delta));
+    receiver.setThreads(onlineThreads(config));
+    if (data_path.empty()) {
+        receiver.generateData();
+    } else {
+        receiver.loadData(data_path);
+    }
+
+    osuCrypto::IOService ios;
+    std::string address = "127.0.0.1:" + std::to_string(config.port);
+    osuCrypto::Session session(ios, address, osuCrypto::SessionMode::Server);
+    osuCrypto::Channel chl = session.addChannel();
+
+    receiver.runOffline(chl);
+    receiver.runOnline(session, chl);
+    chl.close();
+
+    result.receiver_offline_seconds = receiver.offlineTime();
+    result.receiver_online_seconds = receiver.onlineTime();
+    result.receiver_offline = receiver.offlineComm();
+    result.receiver_online = receiver.onlineComm();
+    matched = receiver.matchedQueries();
+    result.matches = static_cast<int>(matched.size());
+}
+
+void runSenderFHE(const Config& config, int port, const std::string& data_path, Result& result) {
+    FPSISenderFixed sender(config.m, config.d, config.delta, config.L, onlineThreads(config));
+    if (data_path.empty()) {
+        sender.generateData();
+    } else {
+        sender.loadData(data_path);
+    }
+
+    osuCrypto::IOService ios;
+    osuCrypto::Session session(ios, "127.0.0.1", static_cast<u32>(port),
+                               osuCrypto::SessionMode::Client);
+    osuCrypto::Channel chl = session.addChannel();
+
+    sender.runOffline(chl);
+    sender.runOnline(session, chl);
+    chl.close();
+
+    result.sender_offline_seconds = sender.offlineTime();
+    result.sender_online_seconds = sender.onlineTime();
+    result.sender_offline = sender.offlineComm();
+    result.sender_online = sender.onlineComm();
+}
+
+// 用明文暴力比对核对协议输出：Sender 的第 j 行与任一 Receiver 行距离不超过 delta 即为应找到的匹配
+void checkMatches(const std::string& receiver_path, const std::string& sender_path, int delta,
+                  const std::set<int>& matched, Result& result) {
+    MappedDataset receiver, sender;
+    receiver.open(receiver_path);
+    sender.open(sender_path);
+    BitMatrixView w = receiver.view();
+    BitMatrixView q = sender.view();
+
+    std::vector<uint64_t> bitmap((w.rows + 63) / 64);
+    int expected = 0, found = 0;
+    for (size_t j = 0; j < q.rows; ++j) {
+        if (utils::hammingThresholdBatch(q.row(j), w, delta, bitmap.data()) == 0) {
+            continue;
+        }
+        ++expected;
+        if (matched.count(static_cast<int>(j))) {
+            ++found;
+        }
+    }
+
+    result.expected_matches = expected;
+    result.found_matches = found;
+    result.false_matches = static_cast<int>(matched.size()) - found;
+}
+
+}
+
+const char* protocolName(Protocol protocol) {
+    return protocol == Protocol::FHE ? "fhe" : "simulated";
+}
+
+Result run(const Config& config) {
+    Result result;
+    bool emulate = config.latency_ms > 0 || config.bandwidth_mbps > 0;
+    int sender_port = emulate ? config.port + 1 : config.port;
+
+    std::unique_ptr<LinkEmulator> link;
+    if (emulate) {
+        link = std::make_unique<LinkEmulator>(sender_port, config.port,
+                                              config.latency_ms, config.bandwidth_mbps);
+        link->start();
+    }
+
+    std::string receiver_path, sender_path;
+    if (config.planted_matches > 0) {
+        receiver_path = config.data_dir + "/bench_receiver_" + std::to_string(config.port) + ".bin";
+        sender_path = config.data_dir + "/bench_sender_" + std::to_string(config.port) + ".bin";
+        dataset::generatePair(receiver_path, config.n, sender_path, config.m, config.d,
+                              static_cast<size_t>(config.planted_matches), config.delta,
+                              block(0x62656e6368ULL, static_cast<uint64_t>(config.port)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::set<int> matched;
+    std::exception_ptr receiver_error;
+    std::thread receiver_thread([&]() {
+        try {
+            if (config.protocol == Protocol::FHE) {
+                runReceiverFHE(config, receiver_path, result, matched);
+            } else {
+                runReceiver(config, receiver_path, result);
+            }
+        } catch (...) {
+            receiver_error = std::current_exception();
+        }
+    });
+
+    std::exception_ptr sender_error;
+    try {
+        if (config.protocol == Protocol::FHE) {
+            runSenderFHE(config, sender_port, sender_path, result);
+        } else {
+            runSender(config, sender_port, sender_path, result);
+        }
+    } catch (...) {
+        sender_error = std::current_exception();
+    }
+
+    receiver_thread.join();
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (link) {
+        link->stop();
+        result.link_bytes = link->bytesRelayed();
+    }
+
+    // 模拟协议不输出匹配的查询下标，只核对 FHE 协议
+    std::exception_ptr check_error;
+    if (!receiver_path.empty() && !receiver_error && !sender_error &&
+        config.protocol == Protocol::FHE) {
+        try {
+            checkMatches(receiver_path, sender_path, config.delta, matched, result);
+        } catch (...) {
+            check_error = std::current_exception();
+        }
+    }
+
+    if (!receiver_path.empty()) {
+        std::remove(receiver_path.c_str());
+        std::remove(sender_path.c_str());
+    }
+
+    if (receiver_error) {
+        std::rethrow_exception(receiver_error);
+    }
+    if (sender_error) {
+        std::rethrow_exception(sender_error);
+    }
+    if (check_error) {
+        std::rethrow_exception(check_error);
+    }
+    return result;
+}
+
+}
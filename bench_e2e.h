@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "utils.h"
+
+// 进程内端到端基准：Receiver 与 Sender 各占一个线程，经本机回环连接运行完整协议；
+// latency_ms 或 bandwidth_mbps 非 0 时中间插入 LinkEmulator 模拟链路
+namespace bench_e2e {
+    // Simulated 为 fpsi_sender / fpsi_receiver 的协议，FHE 为 fpsi_sender_fhe / fpsi_receiver_fhe 的协议
+    enum class Protocol { Simulated, FHE };
+
+    const char* protocolName(Protocol protocol);
+
+    struct Config {
+        Protocol protocol = Protocol::Simulated;
+        int n = 1024;               // Receiver 数据量
+        int m = 1024;               // Sender 查询数
+        int d = 128;
+        int delta = 10;
+        int L = 32;
+        int threads = 0;            // 每一端的线程池大小（FHE 为在线信道数），0 表示全部硬件线程
+        double latency_ms = 0.0;    // 单向时延
+        double bandwidth_mbps = 0.0;
+        int port = 23456;           // Receiver 监听端口，模拟链路时中继使用 port + 1
+        int planted_matches = 0;    // > 0 时用 dataset::generatePair 生成含近似匹配的数据集
+        std::string data_dir = "."; // 生成的数据集文件所在目录，运行结束后删除
+    };
+
+    struct Result {
+        double wall_seconds = 0.0;
+        double receiver_offline_seconds = 0.0;
+        double receiver_online_seconds = 0.0;
+        double sender_offline_seconds = 0.0;
+        double sender_online_seconds = 0.0;
+        CommStats receiver_offline;
+        CommStats receiver_online;
+        CommStats sender_offline;
+        CommStats sender_online;
+        int matches = 0;
+        // 明文核对（只在 FHE 协议且 planted_matches > 0 时计算，否则为 -1）：
+        // expected 为暴力比对得到的近似匹配查询数，found 为其中被协议输出的个数，
+        // false_matches 为协议输出但实际不在阈值内的查询数
+        int expected_matches = -1;
+        int found_matches = -1;
+        int false_matches = -1;
+        uint64_t link_bytes = 0;    // 经过模拟链路的字节数（未模拟时为 0）
+    };
+
+    // 任一端抛出的异常在此重新抛出
+    Result run(const Config& config);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// fpsi_bench 的计时与输出工具。每次测量 / 每次端到端运行输出一条 JSON 记录（JSON Lines），
+// 每条记录整行写出后立即刷新
+namespace bench {
+
+    struct Measurement {
+        uint64_t calls = 0;         // fn 的调用次数
+        uint64_t ops = 0;           // calls × ops_per_call
+        double seconds = 0.0;
+        double nsPerOp() const { return ops > 0 ? seconds * 1e9 / ops : 0.0; }
+        double opsPerSecond() const { return seconds > 0 ? ops / seconds : 0.0; }
+    };
+
+    // 先预热一次，再反复调用 fn 直到累计时间不少于 min_seconds（至少调用一次）。
+    // 每次调用完成 ops_per_call 个操作
+    template<typename F>
+    Measurement measure(double min_seconds, uint64_t ops_per_call, F&& fn) {
+        using Clock = std::chrono::steady_clock;
+        fn();
+
+        Measurement m;
+        Clock::time_point start = Clock::now();
+        do {
+            fn();
+            ++m.calls;
+            m.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (m.seconds < min_seconds);
+        m.ops = m.calls * ops_per_call;
+        return m;
+    }
+
+    // 固定调用 calls 次（不预热），用于需要对端按相同次数配合的测量
+    template<typename F>
+    Measurement measureCalls(uint64_t calls, uint64_t ops_per_call, F&& fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; ++i) {
+            fn();
+        }
+
+        Measurement m;
+        m.calls = calls;
+        m.ops = calls * ops_per_call;
+        m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return m;
+    }
+
+    // 单层 JSON 对象，按 add 的顺序输出字段
+    class JsonRecord {
+    public:
+        JsonRecord& add(const std::string& key, const std::string& value) {
+            appendKey(key);
+            appendString(value);
+            return *this;
+        }
+
+        JsonRecord& add(const std::string& key, const char* value) {
+            return add(key, std::string(value));
+        }
+
+        JsonRecord& add(const std::string& key, bool value) {
+            appendKey(key);
+            body_ << (value ? "true" : "false");
+            return *this;
+        }
+
+        template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+        JsonRecord& add(const std::string& key, T value) {
+            appendKey(key);
+            if constexpr (std::is_floating_point_v<T>) {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%.9g", static_cast<double>(value));
+                body_ << buffer;
+            } else {
+                body_ << +value;
+            }
+            return *this;
+        }
+
+        JsonRecord& add(const std::string& key, const Measurement& m) {
+            add(key + "_calls", m.calls);
+            add(key + "_ops", m.ops);
+            add(key + "_seconds", m.seconds);
+            add(key + "_ns_per_op", m.nsPerOp());
+            return *this;
+        }
+
+        std::string str() const { return "{" + body_.str() + "}"; }
+
+    private:
+        void appendKey(const std::string& key) {
+            if (!first_) {
+                body_ << ",";
+            }
+            first_ = false;
+            appendString(key);
+            body_ << ":";
+        }
+
+        void appendString(const std::string& value) {
+            body_ << '"';
+            for (char c : value) {
+                switch (c) {
+                    case '"':  body_ << "\\\""; break;
+                    case '\\': body_ << "\\\\"; break;
+                    case '\n': body_ << "\\n"; break;
+                    case '\t': body_ << "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char buffer[8];
+                            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                            body_ << buffer;
+                        } else {
+                            body_ << c;
+                        }
+                }
+            }
+            body_ << '"';
+        }
+
+        std::ostringstream body_;
+        bool first_ = true;
+    };
+
+    // 记录输出：path 为空时写到构造时的标准输出（之后 std::cout 被重定向也不受影响），否则追加到文件
+    class RecordSink {
+    public:
+        explicit RecordSink(const std::string& path) : stdout_(std::cout.rdbuf()) {
+            if (!path.empty()) {
+                file_.open(path, std::ios::app);
+                if (!file_.is_open()) {
+                    throw std::runtime_error("Cannot open benchmark output: " + path);
+                }
+            }
+        }
+
+        void write(const JsonRecord& record) {
+            std::string line = record.str() + "\n";
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::ostream& out = file_.is_open() ? static_cast<std::ostream&>(file_) : stdout_;
+            out.write(line.data(), static_cast<std::streamsize>(line.size()));
+            out.flush();
+        }
+
+    private:
+        std::ostream stdout_;
+        std::ofstream file_;
+        std::mutex mutex_;
+    };
+}
@@ -0,0 +1,175 @@
+#include "bfv_planner.h"
+#include "he_hamming.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <iostream>
+#include <memory>
+
+using namespace osuCrypto;
+
+namespace {
+
+struct Trial {
+    bool ok = true;
+    int circuit_budget = INT_MAX;
+    int output_budget = INT_MAX;
+};
+
+// 能在 n 上批处理且大于 d 的最小明文模数位数，找不到时返回 -1
+int plainModulusBits(size_t n, int d) {
+    for (int bits = std::max(17, static_cast<int>(std::bit_width(static_cast<unsigned>(d))) + 1);
+         bits <= 30; ++bits) {
+        try {
+            PlainModulus::Batching(n, bits);
+            return bits;
+        } catch (const std::exception&) {
+        }
+    }
+    return -1;
+}
+
+// 在第 level 层上跑一次完整的比较电路：离线密文切换到该层，
+// 分别用距离恰为 δ 和 δ+1 的查询做阈值零测试，记录电路结束和切换到最后一层后的噪声预算
+Trial runTrial(const std::shared_ptr<SEALContext>& context, const SecretKey& secret_key,
+               const PublicKey& public_key, const std::shared_ptr<const GaloisKeys>& galois_keys,
+               int d, int delta, int level, PRNG& prng) {
+    parms_id_type input = bfv_planner::levelParmsId(*context, level);
+
+    PackedHammingEngine engine(context, d);
+    engine.setLevels(input, input);
+    engine.setKeys(public_key, galois_keys);
+
+    Encryptor encryptor(*context, public_key);
+    Decryptor decryptor(*context, secret_key);
+    Evaluator evaluator(*context);
+    BatchEncoder encoder(*context);
+
+    std::vector<std::vector<uint8_t>> w(1, std::vector<uint8_t>(d));
+    for (auto& bit : w[0]) {
+        bit = prng.getBit();
+    }
+
+    Plaintext plain;
+    engine.encodeVectors(w, 0, 1, plain);
+    Ciphertext enc_w;
+    encryptor.encrypt(plain, enc_w);
+    engine.toNTT(enc_w);
+
+    Trial trial;
+    std::vector<uint64_t> slots;
+    for (int flips : {delta, delta + 1}) {
+        if (flips > d) {
+            continue;
+        }
+
+        std::vector<uint8_t> q = w[0];
+        for (int k = 0; k < flips; ++k) {
+            q[k] ^= 1;
+        }
+
+        Ciphertext test = engine.thresholdTest(enc_w, q, delta, prng, 0);
+        trial.circuit_budget = std::min(trial.circuit_budget, decryptor.invariant_noise_budget(test));
+
+        if (test.parms_id() != context->last_parms_id()) {
+            evaluator.mod_switch_to_inplace(test, context->last_parms_id());
+        }
+        trial.output_budget = std::min(trial.output_budget, decryptor.invariant_noise_budget(test));
+
+        decryptor.decrypt(test, plain);
+        encoder.decode(plain, slots);
+        if (PackedHammingEngine::anyZero(slots) != (flips <= delta)) {
+            trial.ok = false;
+        }
+    }
+    return trial;
+}
+
+}
+
+EncryptionParameters BfvPlan::parameters() const {
+    EncryptionParameters parms(scheme_type::bfv);
+    parms.set_poly_modulus_degree(poly_modulus_degree);
+    parms.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+    parms.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, plain_modulus_bits));
+    return parms;
+}
+
+namespace bfv_planner {
+
+BfvPlan defaults() {
+    return BfvPlan{};
+}
+
+parms_id_type levelParmsId(const SEALContext& context, int level) {
+    auto data = context.first_context_data();
+    for (int i = 0; i < level && data->next_context_data(); ++i) {
+        data = data->next_context_data();
+    }
+    return data->parms_id();
+}
+
+int chainLength(const SEALContext& context) {
+    int length = 0;
+    for (auto data = context.first_context_data(); data; data = data->next_context_data()) {
+        ++length;
+    }
+    return length;
+}
+
+BfvPlan plan(int d, int delta, int min_budget) {
+    const int block_size = PackedHammingEngine::blockSize(d);
+    PRNG prng(block(0x6266765f706c616eULL, static_cast<uint64_t>(d) << 32 | delta));
+
+    for (size_t n = 4096; n <= 32768; n <<= 1) {
+        if (static_cast<size_t>(block_size) > n / 2) {
+            continue;
+        }
+
+        BfvPlan candidate;
+        candidate.poly_modulus_degree = n;
+        candidate.plain_modulus_bits = plainModulusBits(n, d);
+        if (candidate.plain_modulus_bits < 0) {
+            continue;
+        }
+
+        auto context = std::make_shared<SEALContext>(candidate.parameters());
+        if (!context->parameters_set()) {
+            continue;
+        }
+        candidate.levels = chainLength(*context);
+
+        KeyGenerator keygen(*context);
+        SecretKey secret_key = keygen.secret_key();
+        PublicKey public_key;
+        keygen.create_public_key(public_key);
+        auto galois_keys = std::make_shared<GaloisKeys>();
+        keygen.create_galois_keys(PackedHammingEngine::galoisSteps(d), *galois_keys);
+
+        // 层越深密文越小：从最后一层往上找第一个可行的层
+        for (int level = candidate.levels - 1; level >= 0; --level) {
+            Trial trial = runTrial(context, secret_key, public_key, galois_keys,
+                                   d, delta, level, prng);
+            if (!trial.ok || trial.circuit_budget < min_budget ||
+                trial.output_budget < min_budget / 2) {
+                continue;
+            }
+
+            candidate.input_level = level;
+            candidate.circuit_budget = trial.circuit_budget;
+            candidate.output_budget = trial.output_budget;
+            std::cout << "BFV 参数规划: n=" << n
+                      << ", 明文模数 " << candidate.plain_modulus_bits << " 位"
+                      << ", 离线密文层 " << level << "/" << (candidate.levels - 1)
+                      << ", 电路后噪声预算 " << trial.circuit_budget << " 位"
+                      << ", 输出噪声预算 " << trial.output_budget << " 位" << std::endl;
+            return candidate;
+        }
+    }
+
+    std::cout << "警告：没有满足噪声预算的 BFV 参数，使用默认参数" << std::endl;
+    return defaults();
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <seal/seal.h>
+#include <cstddef>
+
+using namespace seal;
+
+// BFV 参数方案：多项式次数、明文模数位数，以及离线打包密文所在的层。
+// 系数模数取 CoeffModulus::BFVDefault(n)（128 位安全），双方只需交换 n、位数和层号即可重建同一上下文
+struct BfvPlan {
+    size_t poly_modulus_degree = 8192;
+    int plain_modulus_bits = 20;
+    int input_level = 0;        // 离线密文从 first_parms_id 往下切换的层数
+    int levels = 1;             // 数据层链长（first 到 last，含两端）
+    int circuit_budget = -1;    // 试算：比较电路结束时的噪声预算（位），-1 表示未试算
+    int output_budget = -1;     // 试算：切换到最后一层之后的噪声预算
+
+    EncryptionParameters parameters() const;
+};
+
+namespace bfv_planner {
+    // 原来的固定参数：8192 / BFVDefault / 20 位明文模数，离线密文保持在 first_parms_id
+    BfvPlan defaults();
+
+    // 按实际的 (d, δ) 试算比较电路，选出最小的可行参数。
+    // 依次尝试 n = 4096 .. 32768（需 slots/2 >= 块大小 D），明文模数取不小于 17 位且大于 d 的批处理素数；
+    // 在最小的可行 n 上，从最深的一层往上找离线密文可以停留的最低层：
+    // 距离为 δ 的查询必须匹配、δ+1 必须不匹配，电路结束后预算不少于 min_budget，
+    // 比较结果切换到最后一层后预算不少于 min_budget / 2。全部失败时返回 defaults()
+    BfvPlan plan(int d, int delta, int min_budget = 10);
+
+    // 从 first_parms_id 往下第 level 层的 parms_id，超出链长时取最后一层
+    parms_id_type levelParmsId(const SEALContext& context, int level);
+
+    // 数据层链长
+    int chainLength(const SEALContext& context);
+}
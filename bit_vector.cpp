@@ -0,0 +1,63 @@
+#include "bit_vector.h"
+#include <algorithm>
+
+BitVector::BitVector(int d)
+    : d_(d), words_(wordsFor(d), 0) {
+}
+
+BitVector BitVector::fromBytes(const std::vector<uint8_t>& bits) {
+    BitVector vec(static_cast<int>(bits.size()));
+
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i]) {
+            vec.words_[i >> 6] |= (1ULL << (i & 63));
+        }
+    }
+
+    return vec;
+}
+
+std::vector<uint8_t> BitVector::toBytes() const {
+    std::vector<uint8_t> bits(d_);
+    for (int i = 0; i < d_; ++i) {
+        bits[i] = get(i) ? 1 : 0;
+    }
+    return bits;
+}
+
+void BitVector::set(int i, bool bit) {
+    uint64_t mask = 1ULL << (i & 63);
+    if (bit) {
+        words_[i >> 6] |= mask;
+    } else {
+        words_[i >> 6] &= ~mask;
+    }
+}
+
+void BitMatrix::resize(size_t rows, int d) {
+    rows_ = rows;
+    d_ = d;
+    words_per_row_ = BitVector::wordsFor(d);
+
+    data_.assign(rows_ * words_per_row_, 0);
+}
+
+void BitMatrix::setRow(size_t i, const std::vector<uint8_t>& bits) {
+    uint64_t* words = row(i);
+    std::fill(words, words + words_per_row_, 0);
+
+    int len = std::min(static_cast<int>(bits.size()), d_);
+    for (int k = 0; k < len; ++k) {
+        if (bits[k]) {
+            words[k >> 6] |= (1ULL << (k & 63));
+        }
+    }
+}
+
+std::vector<uint8_t> BitMatrix::rowBytes(size_t i) const {
+    std::vector<uint8_t> bits(d_);
+    for (int k = 0; k < d_; ++k) {
+        bits[k] = get(i, k) ? 1 : 0;
+    }
+    return bits;
+}
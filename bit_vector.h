@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 打包比特向量：每 64 位存为一个 uint64_t，第 i 位位于 words[i / 64] 的第 (i % 64) 位。
+// 约定：最后一个字中超出维度 d 的高位始终为 0，这样按字做 XOR/popcount 时无需额外掩码。
+
+// 单个打包向量的只读视图（不持有内存）
+struct BitView {
+    const uint64_t* words = nullptr;
+    int d = 0;
+
+    int wordCount() const { return (d + 63) / 64; }
+
+    bool get(int i) const {
+        return (words[i >> 6] >> (i & 63)) & 1ULL;
+    }
+};
+
+// 整个数据集的只读视图，行与行在内存中连续存放
+struct BitMatrixView {
+    const uint64_t* data = nullptr;
+    size_t rows = 0;
+    int d = 0;
+    int words_per_row = 0;
+
+    BitView row(size_t i) const {
+        return BitView{data + i * words_per_row, d};
+    }
+};
+
+// 持有内存的单个打包向量
+class BitVector {
+public:
+    BitVector() = default;
+    explicit BitVector(int d);
+
+    // 从每字节一位的旧格式转换
+    static BitVector fromBytes(const std::vector<uint8_t>& bits);
+
+    // 转换回每字节一位的格式（用于调试和旧接口）
+    std::vector<uint8_t> toBytes() const;
+
+    bool get(int i) const { return (words_[i >> 6] >> (i & 63)) & 1ULL; }
+    void set(int i, bool bit);
+    void flip(int i) { words_[i >> 6] ^= (1ULL << (i & 63)); }
+
+    int size() const { return d_; }
+    int wordCount() const { return static_cast<int>(words_.size()); }
+
+    uint64_t* data() { return words_.data(); }
+    const uint64_t* data() const { return words_.data(); }
+
+    BitView view() const { return BitView{words_.data(), d_}; }
+
+    static int wordsFor(int d) { return (d + 63) / 64; }
+
+    // 维度 d 对应的最后一个字的有效位掩码
+    static uint64_t tailMask(int d) {
+        int rem = d & 63;
+        return rem == 0 ? ~0ULL : ((1ULL << rem) - 1);
+    }
+
+private:
+    int d_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+// 持有内存的数据集：n 个 d 维打包向量，整体存放在一块连续内存（arena）中
+class BitMatrix {
+public:
+    BitMatrix() = default;
+    BitMatrix(size_t rows, int d) { resize(rows, d); }
+
+    // 重新分配并清零
+    void resize(size_t rows, int d);
+
+    size_t rows() const { return rows_; }
+    int dim() const { return d_; }
+    int wordsPerRow() const { return words_per_row_; }
+
+    uint64_t* row(size_t i) { return data_.data() + i * words_per_row_; }
+    const uint64_t* row(size_t i) const { return data_.data() + i * words_per_row_; }
+
+    bool get(size_t i, int k) const {
+        return (row(i)[k >> 6] >> (k & 63)) & 1ULL;
+    }
+
+    // 从每字节一位的格式写入第 i 行
+    void setRow(size_t i, const std::vector<uint8_t>& bits);
+
+    // 将第 i 行转换回每字节一位的格式
+    std::vector<uint8_t> rowBytes(size_t i) const;
+
+    BitView view(size_t i) const { return BitView{row(i), d_}; }
+    BitMatrixView view() const {
+        return BitMatrixView{data_.data(), rows_, d_, words_per_row_};
+    }
+
+    uint64_t* data() { return data_.data(); }
+    const uint64_t* data() const { return data_.data(); }
+
+    // 数据集占用的字节数
+    size_t memoryBytes() const { return data_.size() * sizeof(uint64_t); }
+
+private:
+    size_t rows_ = 0;
+    int d_ = 0;
+    int words_per_row_ = 0;
+    std::vector<uint64_t> data_;
+};
@@ -0,0 +1,138 @@
+#include "cipher_io.h"
+#include "metrics.h"
+#include <cstring>
+#include <stdexcept>
+
+CipherIO::CipherIO(std::shared_ptr<SEALContext> context, compr_mode_type compression)
+    : context_(context), compression_(compression) {}
+
+std::string CipherIO::compressionName(compr_mode_type compression) {
+    switch (compression) {
+        case compr_mode_type::none: return "none";
+        case compr_mode_type::zlib: return "zlib";
+        case compr_mode_type::zstd: return "zstd";
+        default: return "unknown";
+    }
+}
+
+uint64_t CipherIO::send(Channel& chl, const Ciphertext& cipher) {
+    return sendBatch(chl, &cipher, 1);
+}
+
+uint64_t CipherIO::sendBatch(Channel& chl, const Ciphertext* ciphers, size_t count) {
+    size_t size = serializeBatch(ciphers, count);
+    metrics::ScopedTimer timer(metrics::Stage::NetworkSend);
+    chl.send(buffer_.data(), size);
+    return size;
+}
+
+size_t CipherIO::serializeBatch(const Ciphertext* ciphers, size_t count) {
+    metrics::ScopedTimer timer(metrics::Stage::Serialize);
+    size_t header_bytes = sizeof(uint32_t) + count * sizeof(uint64_t);
+
+    // save_size 给出序列化大小的上界，先按上界预留，再按实际大小截断
+    size_t bound = header_bytes;
+    for (size_t i = 0; i < count; ++i) {
+        bound += static_cast<size_t>(ciphers[i].save_size(compression_));
+    }
+    buffer_.resize(bound);
+
+    uint32_t count32 = static_cast<uint32_t>(count);
+    std::memcpy(buffer_.data(), &count32, sizeof(uint32_t));
+
+    size_t offset = header_bytes;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t size = static_cast<uint64_t>(ciphers[i].save(
+            reinterpret_cast<seal_byte*>(buffer_.data() + offset),
+            buffer_.size() - offset, compression_));
+        std::memcpy(buffer_.data() + sizeof(uint32_t) + i * sizeof(uint64_t),
+                    &size, sizeof(uint64_t));
+        offset += size;
+    }
+    buffer_.resize(offset);
+    return offset;
+}
+
+uint64_t CipherIO::sendFrame(Channel& chl, const uint8_t* frame, size_t size) {
+    parseFrame(frame, size);
+    metrics::ScopedTimer timer(metrics::Stage::NetworkSend);
+    chl.send(frame, size);
+    return size;
+}
+
+size_t CipherIO::receiveFrame(Channel& chl) {
+    {
+        metrics::ScopedTimer timer(metrics::Stage::NetworkWait);
+        chl.recv(buffer_);
+    }
+    return parseFrame(buffer_.data(), buffer_.size());
+}
+
+size_t CipherIO::parseFrame(const uint8_t* frame, size_t size) {
+    if (size < sizeof(uint32_t)) {
+        throw std::runtime_error("Truncated ciphertext frame");
+    }
+
+    uint32_t count = 0;
+    std::memcpy(&count, frame, sizeof(uint32_t));
+
+    size_t header_bytes = sizeof(uint32_t) + static_cast<size_t>(count) * sizeof(uint64_t);
+    if (size < header_bytes) {
+        throw std::runtime_error("Truncated ciphertext frame");
+    }
+
+    sizes_.resize(count);
+    std::memcpy(sizes_.data(), frame + sizeof(uint32_t), count * sizeof(uint64_t));
+
+    // 逐个扣减剩余长度而不是先求和，恶意构造的大小字段无法让累加回绕
+    uint64_t remaining = size - header_bytes;
+    for (uint64_t cipher_size : sizes_) {
+        if (cipher_size > remaining) {
+            throw std::runtime_error("Ciphertext frame size mismatch");
+        }
+        remaining -= cipher_size;
+    }
+    if (remaining != 0) {
+        throw std::runtime_error("Ciphertext frame size mismatch");
+    }
+
+    return count;
+}
+
+void CipherIO::loadFrame(const uint8_t* frame, Ciphertext* ciphers, size_t count) {
+    metrics::ScopedTimer timer(metrics::Stage::Deserialize);
+    size_t offset = sizeof(uint32_t) + count * sizeof(uint64_t);
+    for (size_t i = 0; i < count; ++i) {
+        ciphers[i].load(*context_,
+                        reinterpret_cast<const seal_byte*>(frame + offset),
+                        sizes_[i]);
+        offset += sizes_[i];
+    }
+}
+
+size_t CipherIO::loadBatch(const uint8_t* frame, size_t size, std::vector<Ciphertext>& ciphers) {
+    size_t count = parseFrame(frame, size);
+    size_t first = ciphers.size();
+    ciphers.resize(first + count);
+    loadFrame(frame, ciphers.data() + first, count);
+    return count;
+}
+
+uint64_t CipherIO::receive(Channel& chl, Ciphertext& cipher) {
+    return receiveBatch(chl, &cipher, 1);
+}
+
+uint64_t CipherIO::receiveBatch(Channel& chl, Ciphertext* ciphers, size_t count) {
+    if (receiveFrame(chl) != count) {
+        throw std::runtime_error("Unexpected ciphertext count in frame");
+    }
+    loadFrame(buffer_.data(), ciphers, count);
+    return buffer_.size();
+}
+
+uint64_t CipherIO::receiveBatch(Channel& chl, std::vector<Ciphertext>& ciphers) {
+    size_t count = receiveFrame(chl);
+    ciphers.resize(count);
+    loadFrame(buffer_.data(), ciphers.data(), count);
+    return buffer_.size();
+}
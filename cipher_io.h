@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <seal/seal.h>
+#include "cryptoTools/Network/Channel.h"
+
+using namespace seal;
+using namespace osuCrypto;
+
+// 成帧的密文收发：Ciphertext::save 直接写入可复用的缓冲区，
+// 多个密文合并为一条消息：[u32 count][u64 size × count][密文字节...]。
+// 压缩方式按链路选择（局域网上 none 通常最快），接收端根据 SEAL 头部自动识别。
+class CipherIO {
+public:
+    explicit CipherIO(std::shared_ptr<SEALContext> context,
+                      compr_mode_type compression = compr_mode_type::none);
+
+    void setCompression(compr_mode_type compression) { compression_ = compression; }
+    compr_mode_type compression() const { return compression_; }
+
+    // 发送单个 / 多个密文，返回发送的字节数
+    uint64_t send(Channel& chl, const Ciphertext& cipher);
+    uint64_t sendBatch(Channel& chl, const Ciphertext* ciphers, size_t count);
+    uint64_t sendBatch(Channel& chl, const std::vector<Ciphertext>& ciphers) {
+        return sendBatch(chl, ciphers.data(), ciphers.size());
+    }
+
+    // 接收单个 / 多个密文，返回接收的字节数；帧内密文数与 count 不一致时抛出异常
+    uint64_t receive(Channel& chl, Ciphertext& cipher);
+    uint64_t receiveBatch(Channel& chl, Ciphertext* ciphers, size_t count);
+
+    // 接收一帧，密文数由帧头决定
+    uint64_t receiveBatch(Channel& chl, std::vector<Ciphertext>& ciphers);
+
+    // 只序列化不发送：把密文写成一帧放入 lastFrame()，返回帧的字节数
+    size_t serializeBatch(const Ciphertext* ciphers, size_t count);
+
+    // 最近一次发送或接收的完整帧，可以原样写入缓存，之后用 sendFrame 重发
+    const std::vector<uint8_t>& lastFrame() const { return buffer_; }
+
+    // 原样发送一帧已序列化的密文（例如从缓存映射的数据），返回发送的字节数
+    uint64_t sendFrame(Channel& chl, const uint8_t* frame, size_t size);
+
+    // 解析内存中的一帧并把其中的密文追加到 ciphers 末尾，返回帧内密文数
+    size_t loadBatch(const uint8_t* frame, size_t size, std::vector<Ciphertext>& ciphers);
+
+    static std::string compressionName(compr_mode_type compression);
+
+private:
+    // 接收一帧并解析帧头，返回帧内密文数
+    size_t receiveFrame(Channel& chl);
+    size_t parseFrame(const uint8_t* frame, size_t size);
+    void loadFrame(const uint8_t* frame, Ciphertext* ciphers, size_t count);
+
+    std::shared_ptr<SEALContext> context_;
+    compr_mode_type compression_;
+
+    std::vector<uint8_t> buffer_;       // 发送 / 接收共用，容量只增不减
+    std::vector<uint64_t> sizes_;
+};
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "dataset.h"
+#include "utils.h"
+
+// 生成一对打包数据集文件，供 fpsi_receiver / fpsi_sender 通过 mmap 加载
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <receiver.bin> <n> <sender.bin> <m> [d=128] [matches=m/16] [max_distance=10] [seed=1]"
+                  << std::endl;
+        return 1;
+    }
+    
+    std::string receiver_path = argv[1];
+    size_t n = std::strtoull(argv[2], nullptr, 10);
+    std::string sender_path = argv[3];
+    size_t m = std::strtoull(argv[4], nullptr, 10);
+    int d = argc > 5 ? std::atoi(argv[5]) : 128;
+    size_t matches = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : m / 16;
+    int max_distance = argc > 7 ? std::atoi(argv[7]) : 10;
+    uint64_t seed = argc > 8 ? std::strtoull(argv[8], nullptr, 10) : 1;
+    
+    std::cout << "生成数据集: n=" << n << ", m=" << m << ", d=" << d 
+              << ", 近似匹配=" << matches << ", 最大距离=" << max_distance << std::endl;
+    
+    try {
+        Timer timer;
+        timer.start();
+        dataset::generatePair(receiver_path, n, sender_path, m, d, matches, max_distance,
+                              block(0, seed));
+        timer.stop();
+        
+        std::cout << "完成: " << timer.getElapsedSeconds() << " 秒" << std::endl;
+        std::cout << "  " << receiver_path << std::endl;
+        std::cout << "  " << sender_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "dataset.h"
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char DATASET_MAGIC[8] = {'F', 'P', 'S', 'I', 'D', 'S', 'E', 'T'};
+const uint32_t DATASET_VERSION = 1;
+const size_t GENERATE_CHUNK_ROWS = 1 << 16;
+
+DatasetHeader makeHeader(size_t rows, int d) {
+    DatasetHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.version = DATASET_VERSION;
+    header.d = static_cast<uint32_t>(d);
+    header.rows = rows;
+    header.words_per_row = static_cast<uint32_t>(BitVector::wordsFor(d));
+    header.data_offset = sizeof(DatasetHeader);
+    return header;
+}
+
+void fillRandomRow(uint64_t* row, int d, PRNG& prng) {
+    int words = BitVector::wordsFor(d);
+    prng.get(row, words);
+    row[words - 1] &= BitVector::tailMask(d);
+}
+
+void writeOrThrow(std::ofstream& out, const void* data, size_t bytes, const std::string& path) {
+    out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    if (!out) {
+        throw std::runtime_error("Failed to write dataset file: " + path);
+    }
+}
+
+}
+
+MappedDataset::~MappedDataset() {
+    close();
+}
+
+void MappedDataset::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open dataset file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(DatasetHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Dataset file too small: " + path);
+    }
+
+    length_ = static_cast<size_t>(st.st_size);
+    base_ = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        length_ = 0;
+        throw std::runtime_error("mmap failed for dataset file: " + path);
+    }
+
+    DatasetHeader header;
+    std::memcpy(&header, base_, sizeof(header));
+
+    bool valid = std::memcmp(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) == 0 &&
+                 header.version == DATASET_VERSION &&
+                 header.d > 0 &&
+                 header.words_per_row == static_cast<uint32_t>(BitVector::wordsFor(header.d)) &&
+                 header.data_offset % sizeof(uint64_t) == 0 &&
+                 header.data_offset <= length_ &&
+                 (length_ - header.data_offset) / sizeof(uint64_t) / header.words_per_row
+                     >= header.rows;
+    if (!valid) {
+        close();
+        throw std::runtime_error("Invalid dataset file: " + path);
+    }
+
+    // 数据集通常按行顺序扫描
+    madvise(base_, length_, MADV_SEQUENTIAL);
+
+    view_.data = reinterpret_cast<const uint64_t*>(
+        static_cast<const uint8_t*>(base_) + header.data_offset);
+    view_.rows = header.rows;
+    view_.d = static_cast<int>(header.d);
+    view_.words_per_row = static_cast<int>(header.words_per_row);
+}
+
+void MappedDataset::close() {
+    if (base_) {
+        munmap(base_, length_);
+    }
+    base_ = nullptr;
+    length_ = 0;
+    view_ = BitMatrixView{};
+}
+
+namespace dataset {
+
+void write(const std::string& path, const BitMatrixView& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create dataset file: " + path);
+    }
+
+    DatasetHeader header = makeHeader(data.rows, data.d);
+    writeOrThrow(out, &header, sizeof(header), path);
+    writeOrThrow(out, data.data, data.rows * data.words_per_row * sizeof(uint64_t), path);
+}
+
+void generateRandom(BitMatrix& out, size_t rows, int d, PRNG& prng) {
+    out.resize(rows, d);
+    for (size_t i = 0; i < rows; ++i) {
+        fillRandomRow(out.row(i), d, prng);
+    }
+}
+
+void plantNearMatch(const uint64_t* src, uint64_t* dst, int d, int distance,
+                    PRNG& prng, std::vector<int>& positions) {
+    int words = BitVector::wordsFor(d);
+    std::copy(src, src + words, dst);
+
+    distance = std::min(distance, d);
+    if (static_cast<int>(positions.size()) != d) {
+        positions.resize(d);
+        std::iota(positions.begin(), positions.end(), 0);
+    }
+
+    // 部分 Fisher-Yates：只确定前 distance 个位置
+    std::vector<int> picks(distance);
+    for (int t = 0; t < distance; ++t) {
+        int pick = t + static_cast<int>(prng.get<uint64_t>() % (d - t));
+        picks[t] = pick;
+        std::swap(positions[t], positions[pick]);
+        int bit = positions[t];
+        dst[bit >> 6] ^= 1ULL << (bit & 63);
+    }
+
+    // 逆序撤销交换，positions 恢复为恒等排列
+    for (int t = distance - 1; t >= 0; --t) {
+        std::swap(positions[t], positions[picks[t]]);
+    }
+}
+
+void generatePair(const std::string& receiver_path, size_t n,
+                  const std::string& sender_path, size_t m,
+                  int d, size_t matches, int max_distance, block seed) {
+    if (n == 0 || matches > m || max_distance < 0) {
+        throw std::runtime_error("Invalid dataset generation parameters");
+    }
+
+    PRNG prng(seed);
+    int words = BitVector::wordsFor(d);
+    std::vector<uint64_t> chunk(GENERATE_CHUNK_ROWS * words);
+
+    // Receiver：逐块生成随机行
+    {
+        std::ofstream out(receiver_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot create dataset file: " + receiver_path);
+        }
+        DatasetHeader header = makeHeader(n, d);
+        writeOrThrow(out, &header, sizeof(header), receiver_path);
+
+        for (size_t begin = 0; begin < n; begin += GENERATE_CHUNK_ROWS) {
+            size_t count = std::min(GENERATE_CHUNK_ROWS, n - begin);
+            for (size_t i = 0; i < count; ++i) {
+                fillRandomRow(chunk.data() + i * words, d, prng);
+            }
+            writeOrThrow(out, chunk.data(), count * words * sizeof(uint64_t), receiver_path);
+        }
+    }
+
+    // Sender：近似匹配的源行直接从映射后的 Receiver 文件读取
+    MappedDataset receiver;
+    receiver.open(receiver_path);
+    BitMatrixView w = receiver.view();
+
+    std::ofstream out(sender_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create dataset file: " + sender_path);
+    }
+    DatasetHeader header = makeHeader(m, d);
+    writeOrThrow(out, &header, sizeof(header), sender_path);
+
+    std::vector<int> positions;
+    size_t remaining_matches = matches;
+    for (size_t begin = 0; begin < m; begin += GENERATE_CHUNK_ROWS) {
+        size_t count = std::min(GENERATE_CHUNK_ROWS, m - begin);
+        for (size_t i = 0; i < count; ++i) {
+            // 选择抽样（Knuth 算法 S）：恰好 matches 行被选中，且位置均匀随机
+            size_t remaining_rows = m - (begin + i);
+            uint64_t* dst = chunk.data() + i * words;
+            if (prng.get<uint64_t>() % remaining_rows < remaining_matches) {
+                size_t src = prng.get<uint64_t>() % n;
+                int distance = static_cast<int>(prng.get<uint64_t>() % (max_distance + 1));
+                plantNearMatch(w.row(src).words, dst, d, distance, prng, positions);
+                --remaining_matches;
+            } else {
+                fillRandomRow(dst, d, prng);
+            }
+        }
+        writeOrThrow(out, chunk.data(), count * words * sizeof(uint64_t), sender_path);
+    }
+}
+
+std::vector<std::vector<uint8_t>> readBytes(const std::string& path, int d) {
+    MappedDataset mapped;
+    mapped.open(path);
+    if (mapped.dim() != d) {
+        throw std::runtime_error("Dataset dimension mismatch: " + path);
+    }
+
+    BitMatrixView view = mapped.view();
+    std::vector<std::vector<uint8_t>> rows(view.rows, std::vector<uint8_t>(d));
+    for (size_t i = 0; i < view.rows; ++i) {
+        BitView row = view.row(i);
+        for (int k = 0; k < d; ++k) {
+            rows[i][k] = row.get(k) ? 1 : 0;
+        }
+    }
+    return rows;
+}
+
+}
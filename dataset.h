@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "bit_vector.h"
+
+using namespace osuCrypto;
+
+// 打包数据集文件格式（小端）：
+//   [DatasetHeader，64 字节][rows × words_per_row 个 uint64_t，行与行连续存放]
+// 行布局与 BitMatrix 完全一致（超出 d 的高位为 0），mmap 之后直接作为 BitMatrixView 使用，
+// 不做任何解析或拷贝。
+struct DatasetHeader {
+    char magic[8];              // "FPSIDSET"
+    uint32_t version;
+    uint32_t d;
+    uint64_t rows;
+    uint32_t words_per_row;
+    uint32_t reserved;
+    uint64_t data_offset;       // 行数据起始偏移（字节）
+    uint8_t padding[24];
+};
+static_assert(sizeof(DatasetHeader) == 64, "DatasetHeader must be 64 bytes");
+
+// 只读内存映射的数据集文件
+class MappedDataset {
+public:
+    MappedDataset() = default;
+    ~MappedDataset();
+
+    MappedDataset(const MappedDataset&) = delete;
+    MappedDataset& operator=(const MappedDataset&) = delete;
+
+    // 打开并映射文件，格式不符时抛出异常
+    void open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return base_ != nullptr; }
+    size_t rows() const { return view_.rows; }
+    int dim() const { return view_.d; }
+    BitMatrixView view() const { return view_; }
+
+private:
+    void* base_ = nullptr;
+    size_t length_ = 0;
+    BitMatrixView view_;
+};
+
+namespace dataset {
+    // 写出数据集文件
+    void write(const std::string& path, const BitMatrixView& data);
+
+    // 批量生成随机数据：按整字从 PRNG 取随机比特
+    void generateRandom(BitMatrix& out, size_t rows, int d, PRNG& prng);
+
+    // dst = src 随机翻转 distance 个比特。positions 为调用方复用的 [0, d) 排列，
+    // 部分 Fisher-Yates 只交换 distance 次，结束后恢复原排列，因此每次为 O(distance)
+    void plantNearMatch(const uint64_t* src, uint64_t* dst, int d, int distance,
+                        PRNG& prng, std::vector<int>& positions);
+
+    // 流式生成一对数据集文件，内存只占一个分块：
+    // Receiver 文件 n 行随机向量；Sender 文件 m 行，其中恰好 matches 行是随机 Receiver 行
+    // 翻转 [0, max_distance] 个比特得到的近似匹配，其余为随机向量
+    void generatePair(const std::string& receiver_path, size_t n,
+                      const std::string& sender_path, size_t m,
+                      int d, size_t matches, int max_distance, block seed);
+
+    // 读入整个数据集文件并展开为每字节一位的向量（FHE 两端使用的格式），维度不是 d 时抛出异常
+    std::vector<std::vector<uint8_t>> readBytes(const std::string& path, int d);
+}
@@ -1,12 +1,68 @@
 #include "elsh.h"
+#include "fixed_shape.h"
+#include "metrics.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <random>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// 通用 ID 内核：字数与 L 为运行时参数
+void computeIDRowsGeneric(const uint64_t* masks, int mask_words, int L,
+                          const uint64_t* rows, int words_per_row, size_t n,
+                          ELSHFmap::ID* out) {
+    int words = std::min(mask_words, words_per_row);
+    
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t* v = rows + i * words_per_row;
+        ELSHFmap::ID* ids = out + i * L;
+        
+        for (int l = 0; l < L; ++l) {
+            const uint64_t* mask = masks + static_cast<size_t>(l) * mask_words;
+            uint64_t h = 0;
+            
+            for (int w = 0; w < words; ++w) {
+                h = fixed_shape::absorbWord(h, v[w] & mask[w]);
+            }
+            
+            ids[l] = ELSHFmap::makeID(l, h);
+        }
+    }
+}
+
+// 固定形状的 ID 内核：每行 L 次定长的 AND + 哈希吸收全部在编译期展开
+template<int D, int L>
+struct FixedIDKernel {
+    static void run(const uint64_t* masks, int, int,
+                    const uint64_t* rows, int words_per_row, size_t n,
+                    ELSHFmap::ID* out) {
+        constexpr int W = fixed_shape::wordsFor(D);
+        
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t* v = rows + i * words_per_row;
+            ELSHFmap::ID* ids = out + i * L;
+            
+            for (int l = 0; l < L; ++l) {
+                ids[l] = ELSHFmap::makeID(l, fixed_shape::maskedProjection<W>(v, masks + l * W));
+            }
+        }
+    }
+};
+
+}
 
 ELSHFmap::ELSHFmap(int d, int delta, int L, double tau)
     : d_(d), delta_(delta), L_(L), tau_(tau) {
     
+    if (L_ <= 0 || L_ > MAX_L) {
+        throw std::runtime_error("ELSHFmap: L must be in [1, " + std::to_string(MAX_L) + "]");
+    }
+    id_kernel_ = fixed_shape::select<FixedIDKernel>(d_, L_);
+    
     // 计算 k = ceil(d / (delta + 1))
     k_ = static_cast<int>(std::ceil(static_cast<double>(d) / (delta + 1)));
     
@@ -15,6 +71,7 @@ ELSHFmap::ELSHFmap(int d, int delta, int L, double tau)
     std::cout << "  阈值 δ = " << delta_ << std::endl;
     std::cout << "  子集大小 k = " << k_ << std::endl;
     std::cout << "  哈希函数数量 L = " << L_ << std::endl;
+    std::cout << "  ID 内核 = " << (id_kernel_ ? "固定形状特化" : "通用") << std::endl;
     
     // 选择高熵维度
     selectHighEntropyDimensions();
@@ -28,17 +85,27 @@ ELSHFmap::ELSHFmap(int d, int delta, int L, double tau)
 
 void ELSHFmap::selectHighEntropyDimensions() {
     // 模拟熵计算：假设所有维度都是高熵
-    // 在实际应用中，应该根据数据集统计计算熵
-    high_entropy_dims_.reserve(d_);
-    
+    // 实际数据集请使用 fitToData() 或 loadParams()
     std::mt19937 rng(42);
     std::uniform_real_distribution<double> dist(0.4, 0.6);
     
+    std::vector<double> probs(d_);
+    for (int i = 0; i < d_; ++i) {
+        probs[i] = dist(rng);
+    }
+    
+    selectHighEntropyDimensions(probs);
+}
+
+void ELSHFmap::selectHighEntropyDimensions(const std::vector<double>& probs) {
+    high_entropy_dims_.clear();
+    high_entropy_dims_.reserve(d_);
+    
     std::vector<std::pair<double, int>> entropy_dims;
+    entropy_dims.reserve(d_);
     
     for (int i = 0; i < d_; ++i) {
-        double p = dist(rng);
-        p = std::max(0.01, std::min(0.99, p));
+        double p = std::max(0.01, std::min(0.99, probs[i]));
         
         // 计算熵 H = -p*log2(p) - (1-p)*log2(1-p)
         double entropy = -p * std::log2(p) - (1 - p) * std::log2(1 - p);
@@ -50,6 +117,8 @@ void ELSHFmap::selectHighEntropyDimensions() {
     std::sort(entropy_dims.begin(), entropy_dims.end(), 
               std::greater<std::pair<double, int>>());
     
+    entropy_ranking_ = entropy_dims;
+    
     // 选择高熵维度
     for (const auto& [entropy, dim] : entropy_dims) {
         if (entropy > tau_ || high_entropy_dims_.size() < static_cast<size_t>(k_ * L_)) {
@@ -87,22 +156,93 @@ void ELSHFmap::generateRandomSubsets() {
         
         subsets_[l] = subset;
     }
+    
+    buildSubsetMasks();
 }
 
-std::set<std::string> ELSHFmap::computeID(const std::vector<uint8_t>& vector) {
-    std::set<std::string> ids;
+void ELSHFmap::buildSubsetMasks() {
+    mask_words_ = BitVector::wordsFor(d_);
+    subset_masks_.assign(static_cast<size_t>(L_) * mask_words_, 0);
     
     for (int l = 0; l < L_; ++l) {
-        int parity = 0;
-        
+        uint64_t* mask = subset_masks_.data() + static_cast<size_t>(l) * mask_words_;
         for (int dim : subsets_[l]) {
-            if (dim < static_cast<int>(vector.size())) {
-                parity ^= static_cast<int>(vector[dim]);
-            }
+            mask[dim >> 6] |= (1ULL << (dim & 63));
         }
-        
-        // 构造 ID 字符串: "l||parity"
-        std::string id = std::to_string(l) + "||" + std::to_string(parity);
+    }
+}
+
+void ELSHFmap::computeIDRows(const uint64_t* rows, int words_per_row, size_t n, ID* out) const {
+    // 第 l 个 ID = (l, hash(v AND mask_l))；
+    // 行比掩码短（维度不一致的输入）时只能走通用实现
+    if (id_kernel_ && words_per_row >= mask_words_) {
+        id_kernel_(subset_masks_.data(), mask_words_, L_, rows, words_per_row, n, out);
+    } else {
+        computeIDRowsGeneric(subset_masks_.data(), mask_words_, L_, rows, words_per_row, n, out);
+    }
+}
+
+void ELSHFmap::computeIDs(const BitView& vector, ID* out) const {
+    computeIDRows(vector.words, vector.wordCount(), 1, out);
+}
+
+void ELSHFmap::computeIDBatch(const BitMatrixView& vectors, ID* out) const {
+    metrics::ScopedTimer timer(metrics::Stage::ELSH);
+    computeIDRows(vectors.data, vectors.words_per_row, vectors.rows, out);
+}
+
+std::vector<ELSHFmap::ID> ELSHFmap::computeIDBatchFlat(const BitMatrix& vectors) const {
+    std::vector<ID> ids(vectors.rows() * L_);
+    computeIDBatch(vectors.view(), ids.data());
+    return ids;
+}
+
+size_t ELSHFmap::batchChunkRows(int words_per_row) const {
+    const size_t kChunkBytes = 128 * 1024;
+    size_t row_bytes = (static_cast<size_t>(words_per_row) + L_) * sizeof(uint64_t);
+    return std::max<size_t>(64, kChunkBytes / row_bytes);
+}
+
+void ELSHFmap::computeIDBatch(const BitMatrixView& vectors, ID* out,
+                              ThreadPool& pool) const {
+    metrics::ScopedTimer timer(metrics::Stage::ELSH);
+    size_t chunk = batchChunkRows(vectors.words_per_row);
+    
+    pool.parallelFor(vectors.rows, chunk, [&](size_t begin, size_t end) {
+        computeIDRows(vectors.data + begin * vectors.words_per_row, vectors.words_per_row,
+                      end - begin, out + begin * L_);
+    });
+}
+
+std::vector<ELSHFmap::ID> ELSHFmap::computeIDBatchFlat(const BitMatrix& vectors,
+                                                       ThreadPool& pool) const {
+    std::vector<ID> ids(vectors.rows() * L_);
+    computeIDBatch(vectors.view(), ids.data(), pool);
+    return ids;
+}
+
+std::vector<ELSHFmap::ID> ELSHFmap::computeIDBatchFlat(
+    const std::vector<std::vector<uint8_t>>& vectors, ThreadPool* pool) const {
+    BitMatrix packed(vectors.size(), d_);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        packed.setRow(i, vectors[i]);
+    }
+    return pool ? computeIDBatchFlat(packed, *pool) : computeIDBatchFlat(packed);
+}
+
+std::set<std::string> ELSHFmap::computeID(const std::vector<uint8_t>& vector) {
+    return computeID(BitVector::fromBytes(vector).view());
+}
+
+std::set<std::string> ELSHFmap::computeID(const BitView& vector) {
+    std::set<std::string> ids;
+    
+    std::vector<ID> fast(L_);
+    computeIDs(vector, fast.data());
+    
+    for (int l = 0; l < L_; ++l) {
+        // 构造 ID 字符串: "l||projection"
+        std::string id = std::to_string(l) + "||" + std::to_string(idProjection(fast[l]));
         ids.insert(id);
     }
     
@@ -120,4 +260,250 @@ std::vector<std::set<std::string>> ELSHFmap::computeIDBatch(
     }
     
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<std::set<std::string>> ELSHFmap::computeIDBatch(const BitMatrix& vectors) {
+    std::vector<std::set<std::string>> result;
+    result.reserve(vectors.rows());
+    
+    for (size_t i = 0; i < vectors.rows(); ++i) {
+        result.push_back(computeID(vectors.view(i)));
+    }
+    
+    return result;
+}
+
+
+// 统计 rows 中若干行（由 row_index 给出）每个维度上 1 的个数，累加到 counts
+// 采用按位切片的纵向计数器：每处理一行只做若干次按字 AND/XOR，
+// 每 255 行把 8 个比特平面展开到整数计数器中
+template<typename RowIndex>
+static void accumulateBitCounts(const BitMatrixView& rows, size_t begin, size_t end,
+                                RowIndex row_index, uint64_t* counts) {
+    const int words = rows.words_per_row;
+    const int kPlanes = 8;
+    std::vector<uint64_t> planes(static_cast<size_t>(words) * kPlanes, 0);
+    
+    auto flush = [&]() {
+        for (int w = 0; w < words; ++w) {
+            const uint64_t* plane = planes.data() + static_cast<size_t>(w) * kPlanes;
+            for (int bit = 0; bit < 64; ++bit) {
+                int dim = w * 64 + bit;
+                if (dim >= rows.d) {
+                    break;
+                }
+                uint64_t c = 0;
+                for (int k = 0; k < kPlanes; ++k) {
+                    c |= ((plane[k] >> bit) & 1ULL) << k;
+                }
+                counts[dim] += c;
+            }
+        }
+        std::fill(planes.begin(), planes.end(), 0);
+    };
+    
+    int pending = 0;
+    for (size_t s = begin; s < end; ++s) {
+        const uint64_t* row = rows.data + row_index(s) * rows.words_per_row;
+        
+        for (int w = 0; w < words; ++w) {
+            uint64_t* plane = planes.data() + static_cast<size_t>(w) * kPlanes;
+            uint64_t carry = row[w];
+            for (int k = 0; k < kPlanes && carry; ++k) {
+                uint64_t next = plane[k] & carry;
+                plane[k] ^= carry;
+                carry = next;
+            }
+        }
+        
+        if (++pending == 255) {
+            flush();
+            pending = 0;
+        }
+    }
+    
+    if (pending > 0) {
+        flush();
+    }
+}
+
+std::vector<uint64_t> ELSHFmap::countBitFrequencies(const BitMatrixView& data,
+                                                    ThreadPool* pool,
+                                                    size_t max_rows,
+                                                    size_t* sampled_rows) {
+    // 超过 max_rows 时按固定步长抽样，保证结果可复现
+    size_t stride = 1;
+    if (max_rows > 0 && data.rows > max_rows) {
+        stride = (data.rows + max_rows - 1) / max_rows;
+    }
+    size_t samples = (data.rows + stride - 1) / stride;
+    if (sampled_rows) {
+        *sampled_rows = samples;
+    }
+    
+    auto row_index = [stride](size_t s) { return s * stride; };
+    std::vector<uint64_t> counts(data.d, 0);
+    
+    if (pool == nullptr) {
+        accumulateBitCounts(data, 0, samples, row_index, counts.data());
+        return counts;
+    }
+    
+    // 每块各自计数，最后加锁归约（加法满足交换律，结果与串行一致）
+    std::mutex reduce_mutex;
+    size_t chunk = std::max<size_t>(4096, samples / (4 * pool->size()) + 1);
+    
+    pool->parallelFor(samples, chunk, [&](size_t begin, size_t end) {
+        std::vector<uint64_t> local(data.d, 0);
+        accumulateBitCounts(data, begin, end, row_index, local.data());
+        
+        std::lock_guard<std::mutex> lock(reduce_mutex);
+        for (int i = 0; i < data.d; ++i) {
+            counts[i] += local[i];
+        }
+    });
+    
+    return counts;
+}
+
+void ELSHFmap::fitToData(const BitMatrixView& data, ThreadPool* pool, size_t max_rows) {
+    if (data.d != d_) {
+        throw std::runtime_error("ELSHFmap::fitToData: dimension mismatch");
+    }
+    if (data.rows == 0) {
+        throw std::runtime_error("ELSHFmap::fitToData: empty dataset");
+    }
+    
+    size_t samples = 0;
+    std::vector<uint64_t> counts = countBitFrequencies(data, pool, max_rows, &samples);
+    
+    std::vector<double> probs(d_);
+    for (int i = 0; i < d_; ++i) {
+        probs[i] = static_cast<double>(counts[i]) / samples;
+    }
+    
+    selectHighEntropyDimensions(probs);
+    generateRandomSubsets();
+    
+    size_t low_entropy = 0;
+    for (const auto& [entropy, dim] : entropy_ranking_) {
+        if (entropy <= tau_) {
+            ++low_entropy;
+        }
+    }
+    
+    std::cout << "E-LSH: 基于 " << samples << " 个样本重新选择维度, "
+              << "低熵维度 " << low_entropy << "/" << d_ << std::endl;
+}
+
+// 参数文件格式（小端二进制）：
+//   magic "ELSH" | version u32 | d, delta, L, k (i32) | tau (f64)
+//   ranking: d × (entropy f64, dim i32)
+//   high_entropy_dims: count u32 + count × i32
+//   subsets: L × (size u32 + size × i32)
+static const char kParamsMagic[4] = {'E', 'L', 'S', 'H'};
+static const uint32_t kParamsVersion = 1;
+
+template<typename T>
+static void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static T readPod(std::ifstream& in) {
+    T value{};
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("E-LSH 参数文件已损坏");
+    }
+    return value;
+}
+
+void ELSHFmap::saveParams(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("无法写入 E-LSH 参数文件: " + filename);
+    }
+    
+    out.write(kParamsMagic, sizeof(kParamsMagic));
+    writePod(out, kParamsVersion);
+    writePod(out, static_cast<int32_t>(d_));
+    writePod(out, static_cast<int32_t>(delta_));
+    writePod(out, static_cast<int32_t>(L_));
+    writePod(out, static_cast<int32_t>(k_));
+    writePod(out, tau_);
+    
+    for (const auto& [entropy, dim] : entropy_ranking_) {
+        writePod(out, entropy);
+        writePod(out, static_cast<int32_t>(dim));
+    }
+    
+    writePod(out, static_cast<uint32_t>(high_entropy_dims_.size()));
+    for (int dim : high_entropy_dims_) {
+        writePod(out, static_cast<int32_t>(dim));
+    }
+    
+    for (const auto& subset : subsets_) {
+        writePod(out, static_cast<uint32_t>(subset.size()));
+        for (int dim : subset) {
+            writePod(out, static_cast<int32_t>(dim));
+        }
+    }
+}
+
+bool ELSHFmap::loadParams(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + 4, kParamsMagic)) {
+        throw std::runtime_error("不是 E-LSH 参数文件: " + filename);
+    }
+    if (readPod<uint32_t>(in) != kParamsVersion) {
+        throw std::runtime_error("E-LSH 参数文件版本不匹配: " + filename);
+    }
+    
+    int d = readPod<int32_t>(in);
+    int delta = readPod<int32_t>(in);
+    int L = readPod<int32_t>(in);
+    int k = readPod<int32_t>(in);
+    double tau = readPod<double>(in);
+    
+    if (d != d_ || delta != delta_ || L != L_ || k != k_) {
+        throw std::runtime_error("E-LSH 参数文件与当前配置 (d, δ, L) 不一致: " + filename);
+    }
+    tau_ = tau;
+    
+    auto readDim = [&]() {
+        int dim = readPod<int32_t>(in);
+        if (dim < 0 || dim >= d_) {
+            throw std::runtime_error("E-LSH 参数文件包含非法维度");
+        }
+        return dim;
+    };
+    
+    entropy_ranking_.resize(d_);
+    for (auto& [entropy, dim] : entropy_ranking_) {
+        entropy = readPod<double>(in);
+        dim = readDim();
+    }
+    
+    high_entropy_dims_.resize(readPod<uint32_t>(in));
+    for (int& dim : high_entropy_dims_) {
+        dim = readDim();
+    }
+    
+    subsets_.assign(L_, {});
+    for (auto& subset : subsets_) {
+        subset.resize(readPod<uint32_t>(in));
+        for (int& dim : subset) {
+            dim = readDim();
+        }
+    }
+    
+    buildSubsetMasks();
+    return true;
+}
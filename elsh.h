@@ -6,20 +6,70 @@
 #include <cstdint>
 #include "cryptoTools/Common/Defines.h"
 #include "cryptoTools/Crypto/PRNG.h"
+#include "bit_vector.h"
+#include "thread_pool.h"
 
 using namespace osuCrypto;
 
 class ELSHFmap {
 public:
+    // 整数 ID：高 8 位为哈希函数下标 l，低 56 位为向量在子集 S_l 上的投影 (v AND mask_l) 的哈希。
+    // 两个向量在 S_l 的 k 个维度上逐位相同时第 l 个 ID 相同，不同投影碰撞的概率约为 2^-56
+    using ID = uint64_t;
+    static constexpr int ID_INDEX_SHIFT = 56;
+    static constexpr int MAX_L = (1 << (64 - ID_INDEX_SHIFT)) - 1;     // l < 255，ID 不会等于 ~0（IdIndex 的空槽）
+    static constexpr ID ID_PROJECTION_MASK = (1ULL << ID_INDEX_SHIFT) - 1;
+    
     // 构造函数
     ELSHFmap(int d, int delta, int L, double tau = 0.5);
     
+    static ID makeID(int l, uint64_t projection) {
+        return (static_cast<uint64_t>(l) << ID_INDEX_SHIFT) | (projection & ID_PROJECTION_MASK);
+    }
+    static int idIndex(ID id) { return static_cast<int>(id >> ID_INDEX_SHIFT); }
+    static uint64_t idProjection(ID id) { return id & ID_PROJECTION_MASK; }
+    
+    // 由 ID 派生 64 位 OKVS 键（splitmix64 终结函数，跨编译器稳定）
+    static uint64_t idKey(ID id) {
+        uint64_t z = id + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    
+    // 双方共用的 OKVS 键：只由 ID 决定，不含记录或查询下标，
+    // 这样 Sender 的查询 ID 与 Receiver 记录的 ID 相同时查到的正是 Receiver 编码的键
+    // ordinal 区分共享同一 ID 的多条记录（FHE 协议按 (ID, 序号) 逐条编码），序号 0 即 okvsKey(id)
+    static block okvsKey(ID id, uint32_t ordinal = 0) {
+        return block(idKey(id), static_cast<uint64_t>(idIndex(id)) | (static_cast<uint64_t>(ordinal) << 8));
+    }
+    
+    // 快速路径：将 L 个 ID 写入调用方提供的缓冲区 out[0..L)，不做任何堆分配
+    void computeIDs(const BitView& vector, ID* out) const;
+    
+    // 快速路径批量版本：out 需要有 n * L 个元素，第 i 个向量的 ID 位于 out[i*L, (i+1)*L)
+    void computeIDBatch(const BitMatrixView& vectors, ID* out) const;
+    std::vector<ID> computeIDBatchFlat(const BitMatrix& vectors) const;
+    
+    // 多线程版本：按缓存大小分块，在线程池上并行计算，输出顺序与串行版本一致
+    void computeIDBatch(const BitMatrixView& vectors, ID* out, ThreadPool& pool) const;
+    std::vector<ID> computeIDBatchFlat(const BitMatrix& vectors, ThreadPool& pool) const;
+    
+    // 字节向量（每个元素一个比特）先打包为 BitMatrix 再走快速路径，供 FHE 协议使用；pool 非空时多线程
+    std::vector<ID> computeIDBatchFlat(const std::vector<std::vector<uint8_t>>& vectors,
+                                       ThreadPool* pool = nullptr) const;
+    
+    // 每块处理的向量数：使输入与输出合计约占 L2 缓存的一半
+    size_t batchChunkRows(int words_per_row) const;
+    
     // 计算单个向量的 ID 集合
     std::set<std::string> computeID(const std::vector<uint8_t>& vector);
+    std::set<std::string> computeID(const BitView& vector);
     
     // 批量计算 ID 集合
     std::vector<std::set<std::string>> computeIDBatch(
         const std::vector<std::vector<uint8_t>>& vectors);
+    std::vector<std::set<std::string>> computeIDBatch(const BitMatrix& vectors);
     
     // 获取参数
     int getD() const { return d_; }
@@ -27,8 +77,29 @@ public:
     int getL() const { return L_; }
     int getK() const { return k_; }
     
+    // (d, L) 是否命中编译期特化的 ID 内核（见 fixed_shape.h）
+    bool usesFixedShape() const { return id_kernel_ != nullptr; }
+    
     // 获取子集（用于调试）
     const std::vector<std::vector<int>>& getSubsets() const { return subsets_; }
+    
+    // 按熵降序排列的 (熵, 维度)
+    const std::vector<std::pair<double, int>>& getEntropyRanking() const { return entropy_ranking_; }
+    
+    // 单次遍历统计每个维度上 1 的个数；data 可以指向 mmap 的内存。
+    // max_rows > 0 时按固定步长抽样不超过 max_rows 行；pool 非空时多线程归约
+    static std::vector<uint64_t> countBitFrequencies(const BitMatrixView& data,
+                                                     ThreadPool* pool = nullptr,
+                                                     size_t max_rows = 0,
+                                                     size_t* sampled_rows = nullptr);
+    
+    // 根据真实数据的比特频率重新选择高熵维度并生成子集
+    void fitToData(const BitMatrixView& data, ThreadPool* pool = nullptr, size_t max_rows = 0);
+    
+    // 保存 / 加载熵排序与子集，双方加载同一文件即可得到一致的 ID。
+    // loadParams 在文件不存在时返回 false，文件与 (d, δ, L) 不一致时抛出异常
+    void saveParams(const std::string& filename) const;
+    bool loadParams(const std::string& filename);
 
 private:
     int d_;           // 向量维度
@@ -38,11 +109,25 @@ private:
     int k_;           // 子集大小
     
     std::vector<int> high_entropy_dims_;        // 高熵维度
+    std::vector<std::pair<double, int>> entropy_ranking_;  // (熵, 维度)，按熵降序
     std::vector<std::vector<int>> subsets_;     // L 个随机子集
+    std::vector<uint64_t> subset_masks_;        // 子集的打包位掩码，L × mask_words_
+    int mask_words_ = 0;                        // 每个掩码的字数
+    
+    // 批量 ID 内核：n 行连续存放的打包向量，每行 words_per_row 个字，输出 n × L 个 ID
+    using IDKernel = void (*)(const uint64_t* masks, int mask_words, int L,
+                              const uint64_t* rows, int words_per_row, size_t n, ID* out);
+    IDKernel id_kernel_ = nullptr;              // 常见形状的特化实例，其余形状为空，走通用实现
+    
+    void computeIDRows(const uint64_t* rows, int words_per_row, size_t n, ID* out) const;
     
     // 选择高熵维度
     void selectHighEntropyDimensions();
+    void selectHighEntropyDimensions(const std::vector<double>& probs);
     
     // 生成随机子集
     void generateRandomSubsets();
+    
+    // 由 subsets_ 预计算打包位掩码
+    void buildSubsetMasks();
 };
\ No newline at end of file
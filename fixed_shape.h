@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+// 常见固定形状 (d = 128/256/512/1024, L = 8/16/32) 的编译期特化工具。
+// 字数和哈希函数数在编译期已知时循环可以完全展开、数据放进定长 std::array；
+// select 在运行时把 (d, L) 映射到对应的模板实例，不在表中的形状返回 nullptr，调用方走通用路径
+namespace fixed_shape {
+    constexpr int wordsFor(int d) { return (d + 63) / 64; }
+
+    // 定长打包向量
+    template<int D>
+    using Words = std::array<uint64_t, wordsFor(D)>;
+
+    // 编译期字数的 popcount(a ^ b)
+    template<int W>
+    inline uint32_t hammingDistance(const uint64_t* a, const uint64_t* b) {
+        uint32_t dist = 0;
+        for (int w = 0; w < W; ++w) {
+            dist += std::popcount(a[w] ^ b[w]);
+        }
+        return dist;
+    }
+
+    // 投影哈希吸收一个字：h' = splitmix64(h XOR word)，通用内核与特化内核共用以保证结果一致
+    inline uint64_t absorbWord(uint64_t h, uint64_t word) {
+        uint64_t z = h ^ word;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // 编译期字数的投影哈希：逐字吸收 v AND mask
+    template<int W>
+    inline uint64_t maskedProjection(const uint64_t* v, const uint64_t* mask) {
+        uint64_t h = 0;
+        for (int w = 0; w < W; ++w) {
+            h = absorbWord(h, v[w] & mask[w]);
+        }
+        return h;
+    }
+
+    template<template<int, int> class Kernel, int D>
+    auto selectL(int L) -> decltype(&Kernel<D, 8>::run) {
+        switch (L) {
+            case 8:  return &Kernel<D, 8>::run;
+            case 16: return &Kernel<D, 16>::run;
+            case 32: return &Kernel<D, 32>::run;
+            default: return nullptr;
+        }
+    }
+
+    // Kernel<D, L>::run 的所有实例签名相同
+    template<template<int, int> class Kernel>
+    auto select(int d, int L) -> decltype(&Kernel<128, 8>::run) {
+        switch (d) {
+            case 128:  return selectL<Kernel, 128>(L);
+            case 256:  return selectL<Kernel, 256>(L);
+            case 512:  return selectL<Kernel, 512>(L);
+            case 1024: return selectL<Kernel, 1024>(L);
+            default:   return nullptr;
+        }
+    }
+
+    // 只依赖字数的内核：Kernel<W>::run，W 为 d = 128/256/512/1024 对应的 2/4/8/16
+    template<template<int> class Kernel>
+    auto selectWords(int words) -> decltype(&Kernel<2>::run) {
+        switch (words) {
+            case 2:  return &Kernel<2>::run;
+            case 4:  return &Kernel<4>::run;
+            case 8:  return &Kernel<8>::run;
+            case 16: return &Kernel<16>::run;
+            default: return nullptr;
+        }
+    }
+}
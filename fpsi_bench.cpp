@@ -0,0 +1,644 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+
+#include <seal/seal.h>
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Network/Channel.h"
+#include "cryptoTools/Network/Session.h"
+#include "cryptoTools/Network/IOService.h"
+
+#include "bench_e2e.h"
+#include "bench_harness.h"
+#include "bfv_planner.h"
+#include "bit_vector.h"
+#include "cipher_io.h"
+#include "dataset.h"
+#include "elsh.h"
+#include "hamming.h"
+#include "he_hamming.h"
+#include "metrics.h"
+#include "okvs_shard.h"
+#include "secure_primitives.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace osuCrypto;
+using namespace seal;
+
+// 微基准与进程内端到端基准。每次测量输出一条 JSON 记录（见 bench_harness.h），
+// 协议本身的日志默认丢弃，--verbose 时保留
+namespace {
+
+struct Options {
+    bool micro = true;
+    bool e2e = true;
+    std::vector<bench_e2e::Protocol> protocol = {bench_e2e::Protocol::Simulated};
+    std::vector<int> n = {1024};
+    std::vector<int> m;                     // 为空时与 n 相同
+    std::vector<int> d = {128};
+    std::vector<int> delta = {10};
+    std::vector<int> L = {32};
+    std::vector<int> threads = {0};
+    std::vector<double> latency_ms = {0.0};
+    std::vector<double> bandwidth_mbps = {0.0};
+    int repeat = 1;
+    int planted_matches = 0;
+    bool verify = false;                    // 核对 FHE 协议是否找到植入的近似匹配，失败时退出码非 0
+    double min_seconds = 0.5;               // 每个微基准的最短测量时间
+    size_t okvs_items = 1 << 16;
+    int port = 23456;
+    std::string out;                        // 为空时写到标准输出
+    bool verbose = false;
+};
+
+// 协议日志的去处
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+template<typename T>
+std::vector<T> parseList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        std::stringstream parser(item);
+        T value;
+        if (!(parser >> value)) {
+            throw std::runtime_error("Invalid list value: " + item);
+        }
+        values.push_back(value);
+    }
+    if (values.empty()) {
+        throw std::runtime_error("Empty list: " + text);
+    }
+    return values;
+}
+
+std::vector<bench_e2e::Protocol> parseProtocols(const std::string& text) {
+    std::vector<bench_e2e::Protocol> protocols;
+    for (const std::string& name : parseList<std::string>(text)) {
+        if (name == "simulated") {
+            protocols.push_back(bench_e2e::Protocol::Simulated);
+        } else if (name == "fhe") {
+            protocols.push_back(bench_e2e::Protocol::FHE);
+        } else {
+            throw std::runtime_error("Unknown protocol: " + name);
+        }
+    }
+    return protocols;
+}
+
+void printUsage() {
+    std::cerr << "用法: fpsi_bench [--micro | --e2e] [--protocol simulated,fhe]\n"
+              << "                  [--n LIST] [--m LIST] [--d LIST] [--delta LIST]\n"
+              << "                  [--L LIST] [--threads LIST] [--latency-ms LIST] [--bandwidth-mbps LIST]\n"
+              << "                  [--repeat R] [--matches K] [--verify] [--min-time S] [--okvs-items N]\n"
+              << "                  [--port P] [--out FILE] [--metrics FILE] [--verbose]\n"
+              << "LIST 为逗号分隔的取值，端到端基准对全部组合做笛卡尔积扫描" << std::endl;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    bool only_micro = false, only_e2e = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + flag);
+            }
+            return argv[++i];
+        };
+
+        if (flag == "--micro") only_micro = true;
+        else if (flag == "--e2e") only_e2e = true;
+        else if (flag == "--protocol") options.protocol = parseProtocols(value());
+        else if (flag == "--n") options.n = parseList<int>(value());
+        else if (flag == "--m") options.m = parseList<int>(value());
+        else if (flag == "--d") options.d = parseList<int>(value());
+        else if (flag == "--delta") options.delta = parseList<int>(value());
+        else if (flag == "--L") options.L = parseList<int>(value());
+        else if (flag == "--threads") options.threads = parseList<int>(value());
+        else if (flag == "--latency-ms") options.latency_ms = parseList<double>(value());
+        else if (flag == "--bandwidth-mbps") options.bandwidth_mbps = parseList<double>(value());
+        else if (flag == "--repeat") options.repeat = std::max(std::atoi(value().c_str()), 1);
+        else if (flag == "--matches") options.planted_matches = std::max(std::atoi(value().c_str()), 0);
+        else if (flag == "--verify") options.verify = true;
+        else if (flag == "--min-time") options.min_seconds = std::atof(value().c_str());
+        else if (flag == "--okvs-items") options.okvs_items = std::strtoull(value().c_str(), nullptr, 10);
+        else if (flag == "--port") options.port = std::atoi(value().c_str());
+        else if (flag == "--out") options.out = value();
+        else if (flag == "--verbose") options.verbose = true;
+        else if (flag == "--help" || flag == "-h") {
+            printUsage();
+            std::exit(0);
+        } else {
+            printUsage();
+            throw std::runtime_error("Unknown option: " + flag);
+        }
+    }
+
+    if (only_micro != only_e2e) {
+        options.micro = only_micro;
+        options.e2e = only_e2e;
+    }
+    if (options.verify && options.planted_matches == 0) {
+        throw std::runtime_error("--verify requires --matches K");
+    }
+    return options;
+}
+
+// 所有记录共有的字段
+bench::JsonRecord baseRecord(const std::string& type, const std::string& name) {
+    bench::JsonRecord record;
+    record.add("type", type)
+          .add("name", name)
+          .add("timestamp", static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+              std::chrono::system_clock::now().time_since_epoch()).count()))
+          .add("hamming_kernel", utils::hammingKernelName())
+          .add("hw_threads", ThreadPool::hardwareThreads());
+    return record;
+}
+
+void emitMicro(bench::RecordSink& sink, const std::string& name, int d, int L,
+               const bench::Measurement& m, int threads = 1) {
+    bench::JsonRecord record = baseRecord("micro", name);
+    record.add("d", d)
+          .add("L", L)
+          .add("threads", threads)
+          .add("calls", m.calls)
+          .add("ops", m.ops)
+          .add("seconds", m.seconds)
+          .add("ns_per_op", m.nsPerOp())
+          .add("ops_per_second", m.opsPerSecond());
+    sink.write(record);
+}
+
+// 同一进程内的一对已连接信道，用于需要两端配合的原语
+struct Loopback {
+    IOService ios;
+    Session server;
+    Session client;
+    Channel local;
+    Channel peer;
+
+    explicit Loopback(int port)
+        : server(ios, "127.0.0.1:" + std::to_string(port), SessionMode::Server),
+          client(ios, "127.0.0.1:" + std::to_string(port), SessionMode::Client),
+          local(client.addChannel()),
+          peer(server.addChannel()) {}
+
+    ~Loopback() {
+        local.close();
+        peer.close();
+    }
+};
+
+// 本端调用 calls 次 local 计时，对端线程同步调用 calls 次 peer
+template<typename Local, typename Peer>
+bench::Measurement measurePair(uint64_t calls, uint64_t ops_per_call, Local&& local, Peer&& peer) {
+    std::exception_ptr peer_error;
+    std::thread peer_thread([&]() {
+        try {
+            for (uint64_t i = 0; i < calls; ++i) {
+                peer();
+            }
+        } catch (...) {
+            peer_error = std::current_exception();
+        }
+    });
+
+    bench::Measurement m = bench::measureCalls(calls, ops_per_call, local);
+    peer_thread.join();
+    if (peer_error) {
+        std::rethrow_exception(peer_error);
+    }
+    return m;
+}
+
+void benchElsh(bench::RecordSink& sink, const Options& options, int d, int delta, int L,
+               ThreadPool& pool) {
+    ELSHFmap elsh(d, delta, L);
+    PRNG prng(block(1, static_cast<uint64_t>(d)));
+    BitMatrix rows;
+    dataset::generateRandom(rows, 4096, d, prng);
+    std::vector<ELSHFmap::ID> ids(rows.rows() * L);
+
+    emitMicro(sink, elsh.usesFixedShape() ? "elsh.computeIDs.fixed" : "elsh.computeIDs", d, L,
+        bench::measure(options.min_seconds, rows.rows(), [&]() {
+            for (size_t i = 0; i < rows.rows(); ++i) {
+                elsh.computeIDs(rows.view(i), ids.data() + i * L);
+            }
+        }));
+
+    emitMicro(sink, "elsh.computeIDBatch", d, L,
+        bench::measure(options.min_seconds, rows.rows(), [&]() {
+            elsh.computeIDBatch(rows.view(), ids.data(), pool);
+        }), pool.size());
+
+    // 旧的字符串 ID 接口
+    const size_t legacy_rows = 256;
+    emitMicro(sink, "elsh.computeID", d, L,
+        bench::measure(options.min_seconds, legacy_rows, [&]() {
+            for (size_t i = 0; i < legacy_rows; ++i) {
+                elsh.computeID(rows.view(i));
+            }
+        }));
+}
+
+void benchHamming(bench::RecordSink& sink, const Options& options, int d, int delta) {
+    PRNG prng(block(2, static_cast<uint64_t>(d)));
+    BitMatrix rows, query;
+    dataset::generateRandom(rows, 1 << 16, d, prng);
+    dataset::generateRandom(query, 1, d, prng);
+    std::vector<uint32_t> distances(rows.rows());
+    std::vector<uint64_t> bitmap((rows.rows() + 63) / 64);
+    volatile uint64_t checksum = 0;
+
+    emitMicro(sink, "hamming.distanceWords", d, 0,
+        bench::measure(options.min_seconds, rows.rows(), [&]() {
+            uint64_t total = 0;
+            for (size_t i = 0; i < rows.rows(); ++i) {
+                total += utils::hammingDistanceWords(query.row(0), rows.row(i), rows.wordsPerRow());
+            }
+            checksum = checksum + total;
+        }));
+
+    emitMicro(sink, "hamming.distanceBatch", d, 0,
+        bench::measure(options.min_seconds, rows.rows(), [&]() {
+            utils::hammingDistanceBatch(query.view(0), rows.view(), distances.data());
+        }));
+
+    emitMicro(sink, "hamming.thresholdBatch", d, 0,
+        bench::measure(options.min_seconds, rows.rows(), [&]() {
+            checksum = checksum + utils::hammingThresholdBatch(query.view(0), rows.view(), delta, bitmap.data());
+        }));
+}
+
+void benchOkvs(bench::RecordSink& sink, const Options& options, ThreadPool& pool) {
+    PRNG prng(block(3, 3));
+    size_t n = options.okvs_items;
+    std::vector<block> keys(n), values(n), decoded(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = prng.get<block>();
+        values[i] = prng.get<block>();
+    }
+
+    std::unique_ptr<ShardedOkvs> okvs;
+    emitMicro(sink, "okvs.encode", 0, 0,
+        bench::measure(options.min_seconds, n, [&]() {
+            okvs = std::make_unique<ShardedOkvs>();
+            okvs->encode(keys.data(), values.data(), n, 0, block(4, 4), &pool);
+        }), pool.size());
+
+    emitMicro(sink, "okvs.decodeBatch", 0, 0,
+        bench::measure(options.min_seconds, n, [&]() {
+            okvs->decodeBatch(keys.data(), n, decoded.data(), &pool);
+        }), pool.size());
+
+    emitMicro(sink, "okvs.decode", 0, 0,
+        bench::measure(options.min_seconds, 4096, [&]() {
+            for (size_t i = 0; i < 4096; ++i) {
+                decoded[i] = okvs->decode(keys[i]);
+            }
+        }));
+}
+
+// FHE 相关基准共用的上下文与密钥
+struct FheSetup {
+    BfvPlan plan = bfv_planner::defaults();
+    std::shared_ptr<SEALContext> context;
+    SecretKey secret_key;
+    PublicKey public_key;
+
+    FheSetup() {
+        context = std::make_shared<SEALContext>(plan.parameters());
+        KeyGenerator keygen(*context);
+        secret_key = keygen.secret_key();
+        keygen.create_public_key(public_key);
+    }
+
+    std::shared_ptr<GaloisKeys> galoisKeys(const std::vector<int>& steps) const {
+        KeyGenerator keygen(*context, secret_key);
+        auto keys = std::make_shared<GaloisKeys>();
+        keygen.create_galois_keys(steps, *keys);
+        return keys;
+    }
+};
+
+void benchCipherIO(bench::RecordSink& sink, const Options& options, const FheSetup& fhe) {
+    const size_t count = 16;
+    Encryptor encryptor(*fhe.context, fhe.public_key);
+    std::vector<Ciphertext> ciphers(count);
+    for (auto& cipher : ciphers) {
+        encryptor.encrypt_zero(cipher);
+    }
+
+    for (compr_mode_type mode : {compr_mode_type::none, compr_mode_type::zstd}) {
+        std::string suffix = "." + CipherIO::compressionName(mode);
+        try {
+            CipherIO io(fhe.context, mode);
+            size_t frame_bytes = io.serializeBatch(ciphers.data(), count);
+
+            emitMicro(sink, "cipher.serialize" + suffix, 0, 0,
+                bench::measure(options.min_seconds, count, [&]() {
+                    io.serializeBatch(ciphers.data(), count);
+                }));
+
+            std::vector<uint8_t> frame = io.lastFrame();
+            std::vector<Ciphertext> loaded;
+            emitMicro(sink, "cipher.deserialize" + suffix, 0, 0,
+                bench::measure(options.min_seconds, count, [&]() {
+                    loaded.clear();
+                    io.loadBatch(frame.data(), frame.size(), loaded);
+                }));
+
+            bench::JsonRecord record = baseRecord("micro", "cipher.size" + suffix);
+            record.add("poly_modulus_degree", fhe.plan.poly_modulus_degree)
+                  .add("bytes_per_cipher", frame_bytes / count);
+            sink.write(record);
+        } catch (const std::exception& e) {
+            std::cerr << "[bench] 跳过 cipher" << suffix << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void benchSecurePrimitives(bench::RecordSink& sink, const Options& options, const FheSetup& fhe,
+                           int d, int delta, int L) {
+    PRNG prng(block(5, static_cast<uint64_t>(d)));
+    auto randomBits = [&](size_t count) {
+        std::vector<uint8_t> bits(count);
+        for (auto& bit : bits) {
+            bit = prng.getBit();
+        }
+        return bits;
+    };
+
+    // ssPEQT 份额生成
+    std::vector<uint8_t> x = randomBits(d), y = randomBits(d), share_a, share_b;
+    emitMicro(sink, "ssPEQT.generateSharesBatch", d, L,
+        bench::measure(options.min_seconds, d, [&]() {
+            SecretSharedPEQT::generateSharesBatch(x, y, share_a, share_b, prng);
+        }));
+
+    // FHE 阈值比较：逐份额加密的单比较版本
+    FHEThresholdComparison comparison(fhe.context, fhe.public_key, fhe.secret_key);
+    std::vector<Ciphertext> encrypted;
+    emitMicro(sink, "fheThreshold.encryptReceiverShares", d, L,
+        bench::measure(options.min_seconds, d, [&]() {
+            comparison.encryptReceiverShares(share_a, encrypted);
+        }));
+
+    uint64_t mask = 0;
+    Ciphertext masked_sum;
+    emitMicro(sink, "fheThreshold.computeMaskedSum", d, L,
+        bench::measure(options.min_seconds, 1, [&]() {
+            masked_sum = comparison.computeMaskedSum(encrypted, share_b, mask, prng);
+        }));
+
+    emitMicro(sink, "fheThreshold.decryptAndCompare", d, L,
+        bench::measure(options.min_seconds, 1, [&]() {
+            comparison.decryptAndCompare(masked_sum, mask, d, delta);
+        }));
+
+    // 批量版本：一个密文装满的比较数
+    comparison.setGaloisKeys(fhe.galoisKeys(FHEThresholdComparison::galoisSteps(d)));
+    size_t comparisons = comparison.comparisonsPerCiphertext(d);
+    std::vector<std::vector<uint8_t>> batch_a(comparisons), batch_b(comparisons);
+    for (size_t c = 0; c < comparisons; ++c) {
+        batch_a[c] = randomBits(d);
+        batch_b[c] = randomBits(d);
+    }
+
+    std::vector<Ciphertext> encrypted_batches;
+    emitMicro(sink, "fheThreshold.encryptReceiverSharesBatch", d, L,
+        bench::measure(options.min_seconds, comparisons, [&]() {
+            comparison.encryptReceiverSharesBatch(batch_a, encrypted_batches);
+        }));
+
+    std::vector<uint64_t> masks;
+    std::vector<Ciphertext> masked_batches;
+    emitMicro(sink, "fheThreshold.computeMaskedSumBatch", d, L,
+        bench::measure(options.min_seconds, comparisons, [&]() {
+            masked_batches = comparison.computeMaskedSumBatch(encrypted_batches, batch_b, masks, prng);
+        }));
+
+    emitMicro(sink, "fheThreshold.decryptAndCompareBatch", d, L,
+        bench::measure(options.min_seconds, comparisons, [&]() {
+            comparison.decryptAndCompareBatch(masked_batches, masks, d, delta);
+        }));
+
+    // 槽位打包的同态 Hamming 阈值测试（FHE 路径的在线主循环）
+    PackedHammingEngine engine(fhe.context, d);
+    engine.setKeys(fhe.public_key, fhe.galoisKeys(PackedHammingEngine::galoisSteps(d)));
+    std::vector<std::vector<uint8_t>> packed(1, randomBits(d));
+    Plaintext plain;
+    engine.encodeVectors(packed, 0, 1, plain);
+    Encryptor encryptor(*fhe.context, fhe.public_key);
+    Ciphertext enc_w;
+    encryptor.encrypt(plain, enc_w);
+    engine.toNTT(enc_w);
+    std::vector<uint8_t> q = randomBits(d);
+
+    emitMicro(sink, "he.hammingDistance", d, L,
+        bench::measure(options.min_seconds, 1, [&]() {
+            engine.hammingDistance(enc_w, q);
+        }));
+
+    emitMicro(sink, "he.thresholdTest", d, L,
+        bench::measure(options.min_seconds, 1, [&]() {
+            engine.thresholdTest(enc_w, q, delta, prng);
+        }));
+
+    // 需要两端配合的原语经回环信道测量，包含真实的收发开销
+    Loopback loopback(options.port);
+
+    const size_t queries = 1024;
+    std::vector<uint8_t> row_matches = randomBits(queries);
+    emitMicro(sink, "peqt.anyOneBatch", d, L,
+        measurePair(20, queries,
+            [&]() { PrivateEqualityTest::receiveAnyOneBatch(queries, loopback.local); },
+            [&]() { PrivateEqualityTest::sendAnyOneBatch(row_matches, loopback.peer); }));
+
+    std::vector<uint8_t> msg0(d, 0), msg1 = randomBits(d);
+    emitMicro(sink, "ot.sendReceive", d, L,
+        measurePair(200, 1,
+            [&]() { ObliviousTransfer::send(msg0, msg1, loopback.local, prng); },
+            [&]() { ObliviousTransfer::receive<std::vector<uint8_t>>(1, loopback.peer); }));
+}
+
+void runMicro(bench::RecordSink& sink, const Options& options) {
+    ThreadPool pool(options.threads.front());
+
+    for (int d : options.d) {
+        for (int L : options.L) {
+            std::cerr << "[bench] micro: elsh d=" << d << ", L=" << L << std::endl;
+            benchElsh(sink, options, d, options.delta.front(), L, pool);
+        }
+        std::cerr << "[bench] micro: hamming d=" << d << std::endl;
+        benchHamming(sink, options, d, options.delta.front());
+    }
+
+    std::cerr << "[bench] micro: okvs " << options.okvs_items << " items" << std::endl;
+    benchOkvs(sink, options, pool);
+
+    std::cerr << "[bench] micro: ciphertext serialization" << std::endl;
+    FheSetup fhe;
+    benchCipherIO(sink, options, fhe);
+
+    for (int d : options.d) {
+        std::cerr << "[bench] micro: secure primitives d=" << d << std::endl;
+        benchSecurePrimitives(sink, options, fhe, d, options.delta.front(), options.L.front());
+    }
+}
+
+// 返回 --verify 核对失败（或运行失败）的次数
+int runEndToEnd(bench::RecordSink& sink, const Options& options) {
+    std::vector<int> ms = options.m.empty() ? std::vector<int>{0} : options.m;
+    size_t total = options.protocol.size() * options.n.size() * ms.size() * options.d.size() * options.delta.size() *
+                   options.L.size() * options.threads.size() * options.latency_ms.size() *
+                   options.bandwidth_mbps.size() * options.repeat;
+
+    size_t index = 0;
+    int failures = 0;
+    for (bench_e2e::Protocol protocol : options.protocol)
+    for (int n : options.n)
+    for (int m : ms)
+    for (int d : options.d)
+    for (int delta : options.delta)
+    for (int L : options.L)
+    for (int threads : options.threads)
+    for (double latency : options.latency_ms)
+    for (double bandwidth : options.bandwidth_mbps)
+    for (int rep = 0; rep < options.repeat; ++rep) {
+        bench_e2e::Config config;
+        config.protocol = protocol;
+        config.n = n;
+        config.m = m > 0 ? m : n;
+        config.d = d;
+        config.delta = delta;
+        config.L = L;
+        config.threads = threads;
+        config.latency_ms = latency;
+        config.bandwidth_mbps = bandwidth;
+        config.planted_matches = std::min(options.planted_matches, std::min(config.n, config.m));
+        // 每次运行换一组端口，避开上一轮连接的 TIME_WAIT
+        config.port = options.port + 2 + static_cast<int>(2 * (index % 1000));
+        ++index;
+
+        std::cerr << "[bench] e2e " << index << "/" << total << ": "
+                  << bench_e2e::protocolName(protocol) << ", n=" << config.n << ", m=" << config.m
+                  << ", d=" << d << ", δ=" << delta << ", L=" << L << ", threads=" << threads
+                  << ", latency=" << latency << "ms, bandwidth=" << bandwidth << "Mbps" << std::endl;
+
+        bench::JsonRecord record = baseRecord("e2e", "fpsi");
+        record.add("protocol", bench_e2e::protocolName(protocol))
+              .add("n", config.n)
+              .add("m", config.m)
+              .add("d", d)
+              .add("delta", delta)
+              .add("L", L)
+              .add("threads", threads > 0 ? threads : ThreadPool::hardwareThreads())
+              .add("latency_ms", latency)
+              .add("bandwidth_mbps", bandwidth)
+              .add("planted_matches", config.planted_matches)
+              .add("repeat", rep);
+
+        try {
+            bench_e2e::Result result = bench_e2e::run(config);
+            record.add("ok", true)
+                  .add("wall_seconds", result.wall_seconds)
+                  .add("receiver_offline_seconds", result.receiver_offline_seconds)
+                  .add("receiver_online_seconds", result.receiver_online_seconds)
+                  .add("sender_offline_seconds", result.sender_offline_seconds)
+                  .add("sender_online_seconds", result.sender_online_seconds)
+                  .add("receiver_offline_sent", result.receiver_offline.getBytesSent())
+                  .add("receiver_offline_received", result.receiver_offline.getBytesReceived())
+                  .add("receiver_online_sent", result.receiver_online.getBytesSent())
+                  .add("receiver_online_received", result.receiver_online.getBytesReceived())
+                  .add("sender_offline_sent", result.sender_offline.getBytesSent())
+                  .add("sender_offline_received", result.sender_offline.getBytesReceived())
+                  .add("sender_online_sent", result.sender_online.getBytesSent())
+                  .add("sender_online_received", result.sender_online.getBytesReceived())
+                  .add("link_bytes", result.link_bytes)
+                  .add("matches", result.matches);
+            
+            if (result.expected_matches >= 0) {
+                record.add("expected_matches", result.expected_matches)
+                      .add("found_matches", result.found_matches)
+                      .add("false_matches", result.false_matches);
+                std::cerr << "[bench] 核对: 应找到 " << result.expected_matches << " 个, 找到 "
+                          << result.found_matches << " 个, 误报 " << result.false_matches << " 个"
+                          << std::endl;
+                // E-LSH 是概率性的，不要求全部找到；但有植入匹配时一个都没找到、或出现误报都是错误
+                bool passed = result.false_matches == 0 &&
+                              (result.expected_matches == 0 || result.found_matches > 0);
+                if (options.verify && !passed) {
+                    ++failures;
+                    std::cerr << "[bench] 核对失败" << std::endl;
+                }
+            }
+        } catch (const std::exception& e) {
+            record.add("ok", false).add("error", e.what());
+            std::cerr << "[bench] e2e 运行失败: " << e.what() << std::endl;
+            if (options.verify) {
+                ++failures;
+            }
+        }
+        sink.write(record);
+    }
+    return failures;
+}
+
+}
+
+int main(int argc, char** argv) {
+    static NullBuffer null_buffer;
+    std::streambuf* stdout_buffer = std::cout.rdbuf();
+    try {
+        // --metrics FILE：整个运行期间的分阶段插桩（端到端时两端合计），会略微增加微基准的开销
+        metrics::Options metrics_options = metrics::extractFlags(argc, argv);
+        Options options = parseOptions(argc, argv);
+        bench::RecordSink sink(options.out);
+
+        if (!options.verbose) {
+            std::cout.rdbuf(&null_buffer);
+        }
+
+        if (options.micro) {
+            runMicro(sink, options);
+        }
+        int failures = 0;
+        if (options.e2e) {
+            failures = runEndToEnd(sink, options);
+        }
+
+        std::cout.rdbuf(stdout_buffer);
+        // 标准输出可能是 JSON 记录流，这里不打印摘要
+        metrics::writeReport(metrics_options, "Bench", false);
+        if (failures > 0) {
+            std::cerr << "Error: " << failures << " 次端到端核对失败" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(stdout_buffer);
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+#include <mutex>
+
+// SEAL 库
+#include <seal/seal.h>
+
+// cryptoTools 库 - 确保正确的头文件顺序
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+// 网络库 - 必须在 Defines 之后
+#include "cryptoTools/Network/Channel.h"
+
+// 项目头文件
+#include "bit_vector.h"
+#include "dataset.h"
+#include "elsh.h"
+#include "id_index.h"
+#include "metrics.h"
+#include "okvs_shard.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace osuCrypto;
+using namespace seal;
+
+// 模拟协议的 Receiver（fpsi_receiver 与 fpsi_bench 共用）：离线编码并发送 OKVS，在线接收查询并匹配
+class FPSIReceiver {
+    // 每个 Sender 会话私有的状态；OKVS、ID 索引、密钥和数据在会话之间只读共享
+    struct SessionState {
+        int id = 0;
+        CommStats offline_comm;
+        CommStats online_comm;
+        double offline_time = 0.0;
+        double online_time = 0.0;
+        int matches = 0;
+    };
+    
+public:
+    FPSIReceiver(int n, int d, int delta, int L, int threads = 0)
+        : n_(n), d_(d), delta_(delta), L_(L) {
+        
+        pool_ = std::make_unique<ThreadPool>(threads);
+        
+        prng_.SetSeed(block(987654, 321098));
+        elsh_ = std::make_unique<ELSHFmap>(d, delta, L);
+        initializeSEAL();
+    }
+    
+    void initializeSEAL() {
+        EncryptionParameters parms(scheme_type::bfv);
+        size_t poly_modulus_degree = 8192;
+        parms.set_poly_modulus_degree(poly_modulus_degree);
+        parms.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+        parms.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, 20));
+        
+        context_ = std::make_shared<SEALContext>(parms);
+        
+        KeyGenerator keygen(*context_);
+        secret_key_ = keygen.secret_key();
+        keygen.create_public_key(public_key_);
+        
+        encryptor_ = std::make_unique<Encryptor>(*context_, public_key_);
+        decryptor_ = std::make_unique<Decryptor>(*context_, secret_key_);
+        evaluator_ = std::make_unique<Evaluator>(*context_);
+        
+        std::cout << "Receiver: SEAL 参数初始化完成" << std::endl;
+        std::cout << "  多项式模数度: " << poly_modulus_degree << std::endl;
+    }
+    
+    void generateData() {
+        std::cout << "Receiver: 生成 " << n_ << " 个 " << d_ << " 维向量..." << std::endl;
+        
+        dataset::generateRandom(W_storage_, n_, d_, prng_);
+        W_ = W_storage_.view();
+        
+        std::cout << "Receiver: 数据生成完成 (" 
+                  << W_storage_.memoryBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+    
+    // 以 mmap 方式加载打包数据集文件（见 dataset.h），行数即 n
+    void loadData(const std::string& path) {
+        mapped_.open(path);
+        if (mapped_.dim() != d_) {
+            throw std::runtime_error("数据集维度与 d 不一致: " + path);
+        }
+        if (mapped_.rows() > static_cast<size_t>(INT32_MAX)) {
+            throw std::runtime_error("数据集行数过多: " + path);
+        }
+        n_ = static_cast<int>(mapped_.rows());
+        W_ = mapped_.view();
+        
+        std::cout << "Receiver: 已映射数据集 " << path << " (" << n_ << " 个向量)" << std::endl;
+    }
+    
+    // 使用与 Sender 共享的 E-LSH 参数文件：存在则加载，否则根据本方数据统计后生成
+    void prepareELSHParams(const std::string& filename) {
+        if (elsh_->loadParams(filename)) {
+            std::cout << "Receiver: 已加载 E-LSH 参数 " << filename << std::endl;
+            return;
+        }
+        
+        std::cout << "Receiver: 统计数据集比特频率以选择高熵维度..." << std::endl;
+        elsh_->fitToData(W_, pool_.get(), ELSH_SAMPLE_ROWS);
+        elsh_->saveParams(filename);
+        std::cout << "Receiver: E-LSH 参数已保存到 " << filename << std::endl;
+    }
+    
+    // 设置 OKVS 分片数（<= 0 表示自动选择）
+    void setOkvsShards(int shards) { okvs_shards_ = shards; }
+    
+    void runOffline(osuCrypto::Channel& chl) {
+        std::cout << "\n========== Receiver: 离线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // 公钥在构造时已生成，先发送，使 Sender 可以在接收 OKVS 的同时初始化 SEAL
+        sendPublicKey(chl, offline_comm_);
+        
+        std::cout << "Receiver: 公钥已发送 (" 
+                  << offline_comm_.getBytesSent() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        
+        std::vector<block> okvs_keys;
+        std::vector<block> okvs_values;
+        prepareOkvsInput(okvs_keys, okvs_values);
+        size_t okvs_items = okvs_keys.size();
+        
+        std::cout << "Receiver: 执行分片 OKVS 编码并流式发送..." << std::endl;
+        
+        // 每个分片编码完成后立即发送，编码与传输重叠
+        MeteredChannel io(chl, offline_comm_);
+        uint64_t okvs_bytes = okvs_.encodeAndSend(
+            okvs_keys.data(), okvs_values.data(), okvs_items, okvs_shards_,
+            block(prng_.get<uint64_t>(), prng_.get<uint64_t>()), *pool_, io.raw());
+        io.countSent(okvs_bytes, 1 + 2 * okvs_.numShards());
+        
+        std::cout << "Receiver: OKVS 发送完成, 分片数 = " << okvs_.numShards()
+                  << ", 输出大小 = " << okvs_.totalSize() << " ("
+                  << okvs_.totalSize() * sizeof(block) / (1024.0 * 1024.0) << " MB)" << std::endl;
+        
+        timer.stop();
+        offline_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Receiver: 离线阶段完成" << std::endl;
+        std::cout << "  时间: " << offline_time_ << " 秒" << std::endl;
+        offline_comm_.print("离线");
+    }
+    
+    // 服务模式：ID、索引和 OKVS 编码只计算一次，之后所有会话只读共享
+    void prepareShared() {
+        std::cout << "\n========== Receiver: 准备共享离线状态 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        std::vector<block> okvs_keys;
+        std::vector<block> okvs_values;
+        prepareOkvsInput(okvs_keys, okvs_values);
+        
+        std::cout << "Receiver: 执行分片 OKVS 编码..." << std::endl;
+        okvs_.encode(okvs_keys.data(), okvs_values.data(), okvs_keys.size(), okvs_shards_,
+                     block(prng_.get<uint64_t>(), prng_.get<uint64_t>()), pool_.get());
+        
+        timer.stop();
+        offline_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Receiver: OKVS 编码完成, 分片数 = " << okvs_.numShards()
+                  << ", 输出大小 = " << okvs_.totalSize() << " ("
+                  << okvs_.totalSize() * sizeof(block) / (1024.0 * 1024.0) << " MB), "
+                  << offline_time_ << " 秒" << std::endl;
+    }
+    
+    // 服务模式下的单个会话：发送共享的公钥与 OKVS，然后运行该会话的在线阶段。
+    // 可在多个线程上并发调用，计算密集的部分共用同一个线程池
+    void serveSession(int id, osuCrypto::Channel& chl) {
+        SessionState session = makeSession(id);
+        
+        Timer timer;
+        timer.start();
+        sendPublicKey(chl, session.offline_comm);
+        MeteredChannel io(chl, session.offline_comm);
+        io.countSent(okvs_.send(io.raw()), 1 + 2 * okvs_.numShards());
+        timer.stop();
+        session.offline_time = timer.getElapsedSeconds();
+        
+        runOnline(chl, session);
+        
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++sessions_served_;
+        offline_comm_.merge(session.offline_comm);
+        online_comm_.merge(session.online_comm);
+        online_time_ += session.online_time;
+        std::cout << "Receiver: 会话 " << id << " 完成 - 离线传输 " << session.offline_time
+                  << " 秒, 在线 " << session.online_time << " 秒, "
+                  << session.matches << " 个匹配的查询" << std::endl;
+    }
+    
+    void printServerStatistics() {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "Receiver 服务统计" << std::endl;
+        std::cout << "========================================" << std::endl;
+        std::cout << "服务会话数: " << sessions_served_ << std::endl;
+        std::cout << "共享离线准备: " << offline_time_ << " 秒（只执行一次）" << std::endl;
+        std::cout << "离线传输合计: " << offline_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << "在线阶段合计: " << online_time_ << " 秒, "
+                  << online_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << "========================================" << std::endl;
+    }
+    
+    // 计算 ID、建立 ID 索引并生成 OKVS 输入（单会话与服务模式共用）
+    void prepareOkvsInput(std::vector<block>& okvs_keys, std::vector<block>& okvs_values) {
+        std::cout << "Receiver: 计算 E-LSH ID..." << std::endl;
+        ID_W_.resize(W_.rows * L_);
+        elsh_->computeIDBatch(W_, ID_W_.data(), *pool_);
+        
+        uint64_t id_count = ID_W_.size();
+        std::cout << "Receiver: 生成了 " << id_count << " 个 ID" << std::endl;
+        
+        // ID → 向量下标索引在离线阶段建好，在线阶段只做查找
+        id_index_.build(ID_W_.data(), n_, L_);
+        std::cout << "Receiver: ID 索引 " << id_index_.numKeys() << " 个键 ("
+                  << id_index_.memoryBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        
+        std::cout << "Receiver: 构造 OKVS 输入..." << std::endl;
+        
+        size_t okvs_items = ID_W_.size();
+        okvs_keys.resize(okvs_items);
+        okvs_values.resize(okvs_items);
+        
+        // 值暂存 ID 本身，去重后替换为该 ID 的掩码种子
+        pool_->parallelFor(n_, 1024, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                for (int l = 0; l < L_; ++l) {
+                    size_t idx = i * L_ + l;
+                    okvs_keys[idx] = ELSHFmap::okvsKey(ID_W_[idx]);
+                    okvs_values[idx] = block(0, ID_W_[idx]);
+                }
+            }
+        });
+        
+        // 每个不同的 ID 存一个值：低 32 位为该 ID 的序号 k，其余 96 位随机，整个值扩展为掩码。
+        // Sender 随 u 回传 k，Receiver 据此取得 ID，共享该 ID 的全部记录都由 id_index_ 给出候选
+        size_t unique_items = ShardedOkvs::dropDuplicateKeys(okvs_keys, okvs_values);
+        key_ids_.resize(unique_items);
+        key_values_.resize(unique_items);
+        for (size_t k = 0; k < unique_items; ++k) {
+            key_ids_[k] = okvs_values[k].get<uint64_t>(0);
+            okvs_values[k] = block(prng_.get<uint64_t>(),
+                                   (prng_.get<uint64_t>() << 32) | static_cast<uint32_t>(k));
+            key_values_[k] = okvs_values[k];
+        }
+        std::cout << "Receiver: OKVS 输入大小 = " << unique_items << " (" << okvs_items
+                  << " 个 ID 去重)" << std::endl;
+    }
+    
+    // 第 row 个 u 向量（查询 row / L 的第 row % L 个 ID）带回的序号为 k 时是否匹配：
+    // 用序号 k 的掩码恢复出 q，与共享该 ID 的每条记录比较 Hamming 距离。
+    // k 来自随机解码值（Sender 的 ID 不在本方集合中）时 ID 的下标一般对不上，
+    // 即使对上，恢复出的向量也是随机的，距离检查不会通过
+    bool matchRow(const uint64_t* u, uint32_t k, int l, uint64_t* recovered) const {
+        if (k >= key_ids_.size() || ELSHFmap::idIndex(key_ids_[k]) != l) {
+            return false;
+        }
+        
+        const int words = W_.words_per_row;
+        utils::expandMask(key_values_[k], recovered, words);
+        for (int w = 0; w < words; ++w) {
+            recovered[w] ^= u[w];
+        }
+        recovered[words - 1] &= BitVector::tailMask(d_);
+        
+        BitView q{recovered, d_};
+        for (uint32_t i : id_index_.find(key_ids_[k])) {
+            if (utils::hammingDistance(q, W_.row(i)) <= delta_) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void sendPublicKey(osuCrypto::Channel& chl, CommStats& comm) {
+        std::call_once(public_key_once_, [this]() {
+            std::stringstream pk_stream;
+            public_key_.save(pk_stream);
+            public_key_bytes_ = pk_stream.str();
+        });
+        MeteredChannel io(chl, comm);
+        io.asyncSend(public_key_bytes_.data(), public_key_bytes_.size());
+    }
+    
+    SessionState makeSession(int id) {
+        SessionState session;
+        session.id = id;
+        return session;
+    }
+    
+    void runOnline(osuCrypto::Channel& chl) {
+        SessionState session = makeSession(0);
+        runOnline(chl, session);
+        online_comm_ = session.online_comm;
+        online_time_ = session.online_time;
+        matches_ = session.matches;
+    }
+    
+    void runOnline(osuCrypto::Channel& chl, SessionState& session) {
+        std::cout << "\n========== Receiver: 在线阶段开始 (会话 " << session.id << ") ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // 接收 Sender 的实际数据集大小和分块大小
+        MeteredChannel io(chl, session.online_comm);
+        int m_sender;
+        int chunk_queries;
+        io.recv(m_sender);
+        io.recv(chunk_queries);
+        
+        if (chunk_queries <= 0) {
+            throw std::runtime_error("Invalid online chunk size");
+        }
+        
+        int rate_s = L_;
+        
+        // m_sender < 0 表示 Sender 使用流式模式，查询总数事先未知：
+        // 每条消息前先收到本条的查询数，查询数为 0 表示结束
+        bool streaming = m_sender < 0;
+        if (streaming) {
+            std::cout << "Receiver: Sender 使用流式模式" << std::endl;
+        } else {
+            std::cout << "Receiver: Sender 数据集大小 = " << m_sender << std::endl;
+        }
+        std::cout << "Receiver: 接收 Sender 的数据..." << std::endl;
+        
+        int64_t total_received = 0;
+        int matches_found = 0;
+        
+        // 每条消息是 chunk_queries 个查询的全部 u 向量（按位打包），其后是每个 u 的 32 位序号
+        // （两个一字），接收缓冲区复用
+        const int words = W_.words_per_row;
+        const size_t max_rows = static_cast<size_t>(chunk_queries) * rate_s;
+        std::vector<uint64_t> u_buffer(max_rows * words + (max_rows + 1) / 2);
+        std::vector<uint64_t> recovered(words);
+        
+        for (int64_t chunk_begin = 0;; chunk_begin += chunk_queries) {
+            int queries = 0;
+            if (streaming) {
+                io.recv(queries);
+                if (queries < 0 || queries > chunk_queries) {
+                    throw std::runtime_error("Invalid streamed chunk size");
+                }
+            } else if (chunk_begin < m_sender) {
+                queries = static_cast<int>(std::min<int64_t>(chunk_queries, m_sender - chunk_begin));
+            }
+            if (queries == 0) {
+                break;
+            }
+            
+            if (chunk_begin % 256 == 0) {
+                if (streaming) {
+                    std::cout << "Receiver: 处理进度 " << chunk_begin << ", 已有 "
+                              << matches_found << " 个匹配的查询 (" << timer.getElapsedSecondsSoFar()
+                              << " 秒)" << std::endl;
+                } else {
+                    std::cout << "Receiver: 处理进度 " << chunk_begin << "/" << m_sender << std::endl;
+                }
+            }
+            
+            size_t rows = static_cast<size_t>(queries) * rate_s;
+            io.recv(u_buffer.data(), rows * words + (rows + 1) / 2);
+            const uint64_t* tags = u_buffer.data() + rows * words;
+            
+            // 一个查询的任一 ID 给出距离不超过 δ 的记录即为匹配
+            for (int j = 0; j < queries; ++j) {
+                bool matched = false;
+                for (int l = 0; l < rate_s && !matched; ++l) {
+                    size_t r = static_cast<size_t>(j) * rate_s + l;
+                    uint32_t k = static_cast<uint32_t>(tags[r / 2] >> (32 * (r % 2)));
+                    matched = matchRow(u_buffer.data() + r * words, k, l, recovered.data());
+                }
+                total_received += rate_s;
+                matches_found += matched;
+            }
+        }
+        
+        std::cout << "Receiver: 共接收 " << total_received << " 个 u 向量" << std::endl;
+        std::cout << "Receiver: 找到 " << matches_found << " 个匹配的查询" << std::endl;
+        
+        timer.stop();
+        session.online_time = timer.getElapsedSeconds();
+        session.matches = matches_found;
+        
+        std::cout << "Receiver: 在线阶段完成" << std::endl;
+        std::cout << "  时间: " << session.online_time << " 秒" << std::endl;
+        session.online_comm.print("在线");
+    }
+    
+    double offlineTime() const { return offline_time_; }
+    double onlineTime() const { return online_time_; }
+    const CommStats& offlineComm() const { return offline_comm_; }
+    const CommStats& onlineComm() const { return online_comm_; }
+    int matches() const { return matches_; }
+    
+    void printStatistics() {
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "Receiver 统计信息" << std::endl;
+        std::cout << "========================================" << std::endl;
+        std::cout << "参数: n=" << n_ << ", d=" << d_ 
+                  << ", δ=" << delta_ << ", L=" << L_ << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "离线阶段:" << std::endl;
+        std::cout << "  时间: " << offline_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << offline_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "在线阶段:" << std::endl;
+        std::cout << "  时间: " << online_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << online_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "总计:" << std::endl;
+        std::cout << "  时间: " << (offline_time_ + online_time_) << " 秒" << std::endl;
+        std::cout << "  通信: " 
+                  << (offline_comm_.getTotalMegabytes() + online_comm_.getTotalMegabytes()) 
+                  << " MB" << std::endl;
+        std::cout << "========================================" << std::endl;
+        
+        utils::saveStats("fpsi_stats.txt", "Receiver", offline_time_, online_time_,
+                        offline_comm_, online_comm_, n_, d_, delta_);
+    }
+
+private:
+    static constexpr size_t ELSH_SAMPLE_ROWS = 1 << 20;
+    
+    int n_;
+    int d_;
+    int delta_;
+    int L_;
+    
+    PRNG prng_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<ELSHFmap> elsh_;
+    
+    std::shared_ptr<SEALContext> context_;
+    SecretKey secret_key_;
+    PublicKey public_key_;
+    std::unique_ptr<Encryptor> encryptor_;
+    std::unique_ptr<Decryptor> decryptor_;
+    std::unique_ptr<Evaluator> evaluator_;
+    
+    BitMatrix W_storage_;               // generateData 生成的数据
+    MappedDataset mapped_;              // loadData 映射的数据集文件
+    BitMatrixView W_;                   // 当前使用的数据（指向以上两者之一）
+    std::vector<ELSHFmap::ID> ID_W_;    // n × L 个 ID，按行连续存放
+    IdIndex id_index_;                  // ID → 共享该 ID 的全部向量下标
+    std::vector<ELSHFmap::ID> key_ids_; // OKVS 中第 k 个不同 ID 及其值（掩码种子）
+    std::vector<block> key_values_;
+    ShardedOkvs okvs_;
+    int okvs_shards_ = 0;   // 0 表示根据数据量和线程数自动选择
+    
+    std::string public_key_bytes_;      // 序列化的公钥，所有会话共用
+    std::once_flag public_key_once_;
+    std::mutex stats_mutex_;            // 保护服务模式下的累计统计
+    int sessions_served_ = 0;
+    int matches_ = 0;                   // 单会话模式下匹配的查询数
+    
+    double offline_time_ = 0.0;
+    double online_time_ = 0.0;
+    CommStats offline_comm_;
+    CommStats online_comm_;
+};
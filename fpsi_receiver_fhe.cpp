@@ -0,0 +1,87 @@
+#include "fpsi_receiver_fhe.h"
+
+#include "cryptoTools/Network/IOService.h"
+
+int main(int argc, char** argv) {
+    int n = 256;
+    int d = 128;
+    int delta = 10;
+    int L = 8;
+    int records_per_cipher = 0;    // 0 表示每个密文打包 ⌊slots/D⌋ 个向量
+    compr_mode_type cipher_compression = compr_mode_type::none;    // 局域网上不压缩更快
+    int window_batches = 8;        // 离线传输最多未确认的批次数
+    int update_rounds = 0;         // 离线之后模拟的增量更新轮数（两端需一致）
+    double update_fraction = 0.01; // 每轮删除并新增的记录比例
+    bool plan_parameters = true;   // 按 (d, δ) 试算选择 BFV 参数，false 时使用原来的固定参数
+    
+    int online_threads = 1;
+    std::string cache_dir;
+    metrics::Options metrics_options;
+    try {
+        // --threads N：线程预算，即离线线程池大小与在线阶段并行信道数（可出现在任意位置）
+        online_threads = multi_channel::extractThreadsFlag(argc, argv, 1);
+        
+        // --cache DIR：离线状态缓存目录，参数与数据不变时跳过离线阶段
+        cache_dir = OfflineCache::extractDirFlag(argc, argv);
+        
+        // --metrics FILE：启用分阶段插桩，结束时写出 JSON（FILE 以 .prom 结尾时为 Prometheus 文本）
+        metrics_options = metrics::extractFlags(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [port] [data]"
+                  << " [--threads N] [--cache DIR] [--metrics FILE]" << std::endl;
+        return 1;
+    }
+    
+    int port = 12345;
+    if (argc > 1) port = std::atoi(argv[1]);
+    std::string data_path;    // 为空时随机生成数据，否则加载 fpsi_datagen 生成的文件
+    if (argc > 2) data_path = argv[2];
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "FPSI 协议 - Receiver (修复版)" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "参数: n=" << n << ", d=" << d << ", δ=" << delta << ", L=" << L << std::endl;
+    std::cout << "监听端口: " << port << ", 在线线程: " << online_threads << std::endl;
+    std::cout << "========================================" << std::endl;
+    
+    try {
+        BfvPlan plan = plan_parameters ? bfv_planner::plan(d, delta) : bfv_planner::defaults();
+        FPSIReceiverFixed receiver(n, d, delta, L, plan, records_per_cipher);
+        receiver.setCipherCompression(cipher_compression);
+        receiver.setTransferWindow(window_batches);
+        receiver.setThreads(online_threads);
+        receiver.setCacheDir(cache_dir);
+        if (data_path.empty()) {
+            receiver.generateData();
+        } else {
+            receiver.loadData(data_path);
+        }
+        
+        std::cout << "\nReceiver: 等待连接..." << std::endl;
+        
+        IOService ios;
+        std::string address = "127.0.0.1:" + std::to_string(port);
+        Session session(ios, address, SessionMode::Server);
+        Channel chl = session.addChannel();
+        
+        std::cout << "Receiver: 已连接!" << std::endl;
+        
+        receiver.runOffline(chl);
+        for (int round = 0; round < update_rounds; ++round) {
+            receiver.simulateUpdates(update_fraction);
+            receiver.syncUpdates(chl);
+        }
+        receiver.runOnline(session, chl);
+        receiver.printStatistics();
+        metrics::writeReport(metrics_options, "Receiver");
+        
+        std::cout << "\n✓ Receiver: 协议执行完成!" << std::endl;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
\ No newline at end of file
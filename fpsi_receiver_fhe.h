@@ -0,0 +1,930 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+
+#include <seal/seal.h>
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Network/Channel.h"
+#include "cryptoTools/Network/Session.h"
+
+#include "bfv_planner.h"
+#include "cipher_io.h"
+#include "dataset.h"
+#include "elsh.h"
+#include "he_hamming.h"
+#include "id_index.h"
+#include "metrics.h"
+#include "multi_channel.h"
+#include "offline_cache.h"
+#include "okvs_shard.h"
+#include "ot_extension.h"
+#include "segmented_okvs.h"
+#include "utils.h"
+#include "secure_primitives.h"
+
+using namespace osuCrypto;
+using namespace seal;
+
+// FHE 协议的 Receiver（fpsi_receiver_fhe 与 fpsi_bench 共用）：离线发送 OKVS 与打包加密的数据库，
+// 在线解密 Sender 的阈值测试密文，回送逐查询匹配位，再经 OT 得到模糊交集
+class FPSIReceiverFixed {
+    // 在线阶段每个线程 / 信道的私有状态
+    struct OnlineWorker {
+        MemoryPoolHandle pool;      // 线程私有的 SEAL 内存池
+        std::vector<Ciphertext> tests;  // 以下为逐帧复用的临时对象
+        Plaintext plain;
+        std::vector<uint64_t> decoded;
+        std::unique_ptr<Decryptor> decryptor;
+        std::unique_ptr<BatchEncoder> encoder;
+        std::unique_ptr<CipherIO> io;
+        CommStats comm;
+        std::vector<std::pair<int, std::vector<uint8_t>>> fuzzy;    // (j, 收到的向量)
+    };
+    
+public:
+    // records_per_cipher <= 0 时每个密文打包 ⌊slots/D⌋ 个向量，1 即每个向量一个密文
+    FPSIReceiverFixed(int n, int d, int delta, int L, const BfvPlan& plan, int records_per_cipher = 0)
+        : n_(n), d_(d), delta_(delta), L_(L), plan_(plan) {
+        
+        prng_.SetSeed(block(987654, 321098));
+        pool_ = std::make_unique<ThreadPool>(online_threads_);
+        elsh_ = std::make_unique<ELSHFmap>(d, delta, L);
+        initializeSEAL();
+        
+        int max_records = hamming_->recordsPerCiphertext();
+        records_per_cipher_ = records_per_cipher > 0
+                              ? std::min(records_per_cipher, max_records) : max_records;
+        num_ciphers_ = (n_ + records_per_cipher_ - 1) / records_per_cipher_;
+    }
+    
+    void initializeSEAL() {
+        context_ = std::make_shared<SEALContext>(plan_.parameters());
+        input_parms_id_ = bfv_planner::levelParmsId(*context_, plan_.input_level);
+        
+        evaluator_ = std::make_unique<Evaluator>(*context_);
+        encoder_ = std::make_unique<BatchEncoder>(*context_);
+        hamming_ = std::make_unique<PackedHammingEngine>(context_, d_);
+        hamming_->setLevels(input_parms_id_, context_->last_parms_id());
+        cipher_io_ = std::make_unique<CipherIO>(context_);
+        
+        slot_count_ = encoder_->slot_count();
+        
+        std::cout << "Receiver: SEAL初始化完成" << std::endl;
+        std::cout << "  Poly modulus degree: " << plan_.poly_modulus_degree
+                  << ", plain modulus: " << plan_.plain_modulus_bits << " bits" << std::endl;
+        std::cout << "  Slot count: " << slot_count_
+                  << ", 离线密文层: " << plan_.input_level << std::endl;
+    }
+    
+    // 冷启动：生成密钥并预先序列化，发送和写入缓存共用同一份字节
+    void generateKeys() {
+        keygen_ = std::make_unique<KeyGenerator>(*context_);
+        secret_key_ = keygen_->secret_key();
+        keygen_->create_public_key(public_key_);
+        public_key_bytes_ = serialize(public_key_);
+        
+        // Sender 在槽位内求和需要的 Galois 密钥
+        galois_key_bytes_ = serialize(keygen_->create_galois_keys(PackedHammingEngine::galoisSteps(d_)));
+        installKeys();
+    }
+    
+    void installKeys() {
+        encryptor_ = std::make_unique<Encryptor>(*context_, public_key_);
+        decryptor_ = std::make_unique<Decryptor>(*context_, secret_key_);
+    }
+    
+    template<typename T>
+    static std::string serialize(const T& object) {
+        std::stringstream stream;
+        object.save(stream);
+        return stream.str();
+    }
+    
+    // 离线状态缓存目录，为空时每次都完整执行离线阶段
+    void setCacheDir(const std::string& dir) { cache_ = OfflineCache(dir); }
+    
+    // 离线产物只取决于 SEAL 参数与密文层、(n, d, δ, L)、打包方式、E-LSH 子集和数据本身
+    block stateHash() const {
+        ContentHasher hasher;
+        hasher.update(serialize(context_->key_context_data()->parms()));
+        hasher.updateValue(plan_.input_level);
+        hasher.updateValue(n_);
+        hasher.updateValue(d_);
+        hasher.updateValue(delta_);
+        hasher.updateValue(L_);
+        hasher.updateValue(records_per_cipher_);
+        for (const auto& subset : elsh_->getSubsets()) {
+            hasher.update(subset.data(), subset.size() * sizeof(int));
+        }
+        for (const auto& w : W_) {
+            hasher.update(w.data(), w.size());
+        }
+        return hasher.final();
+    }
+    
+    // 离线密文传输允许的未确认批次数
+    void setTransferWindow(int batches) {
+        window_batches_ = std::max(batches, 1);
+    }
+    
+    // 本端发送密文时使用的压缩方式
+    void setCipherCompression(compr_mode_type compression) {
+        cipher_io_->setCompression(compression);
+        std::cout << "Receiver: 密文压缩方式 = " << CipherIO::compressionName(compression) << std::endl;
+    }
+    
+    void generateData() {
+        std::cout << "Receiver: 生成 " << n_ << " 个 " << d_ << " 维向量..." << std::endl;
+        
+        W_.resize(n_);
+        for (int i = 0; i < n_; ++i) {
+            W_[i] = utils::generateRandomBinaryVector(d_, prng_);
+        }
+        
+        std::cout << "Receiver: 数据生成完成" << std::endl;
+    }
+    
+    // 加载 fpsi_datagen 生成的数据集文件，行数即记录数 n，密文数随之重新计算
+    void loadData(const std::string& path) {
+        W_ = dataset::readBytes(path, d_);
+        n_ = static_cast<int>(W_.size());
+        num_ciphers_ = (n_ + records_per_cipher_ - 1) / records_per_cipher_;
+        
+        std::cout << "Receiver: 已加载数据集 " << path << " (" << n_ << " 个向量)" << std::endl;
+    }
+    
+    void runOffline(Channel& chl) {
+        std::cout << "\n========== Receiver: 离线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        live_.assign(n_, 1);
+        cipher_version_.assign(num_ciphers_, 0);
+        
+        sendPlan(chl);
+        
+        block state = stateHash();
+        bool warm = cache_.open(state);
+        if (warm) {
+            loadCachedState();
+        } else {
+            generateKeys();
+            if (cache_.enabled()) {
+                cache_.begin();
+                cache_.put("secret_key", serialize(secret_key_));
+                cache_.put("public_key", public_key_bytes_);
+                cache_.put("galois_keys", galois_key_bytes_);
+            }
+            
+            std::cout << "Receiver: 计算 E-LSH ID..." << std::endl;
+            ID_W_ = elsh_->computeIDBatchFlat(W_, pool_.get());
+            std::cout << "Receiver: 生成了 " << ID_W_.size() << " 个 ID" << std::endl;
+            
+            buildOKVS();
+        }
+        
+        // 缓存标识同时绑定状态与公钥：Sender 缓存的密文库只在同一把密钥下可用。
+        // 不使用缓存时发送全零，Sender 总是完整接收
+        block token(0, 0);
+        if (cache_.enabled()) {
+            ContentHasher hasher;
+            hasher.updateValue(state);
+            hasher.update(public_key_bytes_);
+            token = hasher.final();
+        }
+        MeteredChannel io(chl, offline_comm_);
+        io.send(token);
+        uint8_t peer_cached = 0;
+        io.recv(peer_cached);
+        
+        if (peer_cached) {
+            std::cout << "Receiver: Sender 已缓存 OKVS、密文库与密钥，跳过传输" << std::endl;
+        } else {
+            sendOKVS(chl);
+            sendEncryptedVectorsBatched(chl);
+            sendPublicKey(chl);
+        }
+        
+        if (!warm && !peer_cached && cache_.enabled()) {
+            elsh_->saveParams(cache_.stagingPath("elsh_params"));
+            cache_.adopt("elsh_params");
+            cache_.commit(state);
+            std::cout << "Receiver: 离线状态已写入缓存 " << cache_.dir() << std::endl;
+        }
+        
+        // OT 相关性不能跨会话复用，每次重新生成
+        setupOT(chl);
+        
+        timer.stop();
+        offline_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Receiver: 离线阶段完成 - " << offline_time_ << " 秒" << std::endl;
+        offline_comm_.print("离线");
+    }
+    
+    // Sender 按同一方案重建 SEAL 上下文（系数模数由 n 决定）
+    void sendPlan(Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        uint64_t degree = plan_.poly_modulus_degree;
+        io.send(degree);
+        io.send(plan_.plain_modulus_bits);
+        io.send(plan_.input_level);
+    }
+    
+    // 按 Sender 的查询数预先生成 OT 扩展相关性
+    void setupOT(Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        int m_sender;
+        io.recv(m_sender);
+        
+        std::cout << "Receiver: 生成 " << m_sender << " 个 OT 扩展..." << std::endl;
+        
+        uint64_t sent = chl.getTotalDataSent();
+        uint64_t received = chl.getTotalDataRecv();
+        ot_receiver_.setup(m_sender, chl, prng_);
+        io.countSent(chl.getTotalDataSent() - sent);
+        io.countReceived(chl.getTotalDataRecv() - received);
+    }
+    
+    // 热启动：密钥、OKVS 与 E-LSH 参数从缓存读回，打包密文库保持映射，需要时原样重发
+    void loadCachedState() {
+        std::cout << "Receiver: 命中离线缓存 " << cache_.dir() << "，跳过密钥生成、OKVS 编码与加密" << std::endl;
+        
+        MappedFile file;
+        cache_.map("secret_key", file);
+        secret_key_.load(*context_, reinterpret_cast<const seal_byte*>(file.data()), file.size());
+        
+        cache_.map("public_key", file);
+        public_key_bytes_.assign(reinterpret_cast<const char*>(file.data()), file.size());
+        public_key_.load(*context_, reinterpret_cast<const seal_byte*>(file.data()), file.size());
+        
+        cache_.map("galois_keys", file);
+        galois_key_bytes_.assign(reinterpret_cast<const char*>(file.data()), file.size());
+        
+        cache_.map("elsh_params", file);
+        elsh_->loadParams(cache_.path("elsh_params"));
+        
+        cache_.map("okvs", file);
+        ShardedOkvs base;
+        base.loadFlat(file.data(), file.size());
+        okvs_.setBase(std::move(base));
+        
+        cache_.map("packed_db", cached_db_);
+        installKeys();
+    }
+    
+    void buildOKVS() {
+        std::cout << "Receiver: 构造 OKVS..." << std::endl;
+        
+        id_index_.build(ID_W_.data(), n_, L_);
+        std::vector<block> okvs_keys;
+        std::vector<block> okvs_values;
+        appendAllKeys(okvs_keys, okvs_values);
+        std::cout << "Receiver: OKVS 输入大小 = " << okvs_keys.size() << " (" << id_index_.numKeys()
+                  << " 个不同 ID, 每个 ID 的全部记录都编码)" << std::endl;
+        
+        okvs_.resetBase(okvs_keys.data(), okvs_values.data(), okvs_keys.size(),
+                        block(prng_.get<uint64_t>(), prng_.get<uint64_t>()), pool_.get());
+        std::cout << "Receiver: OKVS 基础段 " << okvs_.base().numShards() << " 个分片" << std::endl;
+        
+        if (cache_.enabled()) {
+            OfflineCache::Writer writer = cache_.create("okvs");
+            okvs_.base().writeFlat([&](const void* data, size_t size) { writer.write(data, size); });
+            writer.close();
+        }
+    }
+    
+    // 共享 id 的全部存活记录（id_index_ 给出，按槽位升序）逐条编码：第 t 条的键为
+    // ELSHFmap::okvsKey(id, t)，值的低 64 位为 密文下标 | 候选数 << 32，高 64 位为密文内的组号
+    // （最高 32 位留给段校验标签）。Sender 先解码序号 0 得到候选数，再解码其余序号
+    void appendBucketKeys(ELSHFmap::ID id, std::vector<block>& keys, std::vector<block>& values) const {
+        IdIndex::Span span = id_index_.find(id);
+        uint32_t count = 0;
+        for (uint32_t slot : span) {
+            count += live_[slot];
+        }
+        
+        uint32_t t = 0;
+        for (uint32_t slot : span) {
+            if (!live_[slot]) {
+                continue;
+            }
+            uint64_t cipher = slot / records_per_cipher_;
+            keys.push_back(ELSHFmap::okvsKey(id, t++));
+            values.push_back(block(slot % records_per_cipher_, cipher | (static_cast<uint64_t>(count) << 32)));
+        }
+    }
+    
+    // 全部存活记录的键值对：每个 ID 在它的第一条存活记录处编码一次
+    void appendAllKeys(std::vector<block>& keys, std::vector<block>& values) const {
+        for (int slot = 0; slot < n_; ++slot) {
+            if (!live_[slot]) {
+                continue;
+            }
+            const ELSHFmap::ID* ids = ID_W_.data() + static_cast<size_t>(slot) * L_;
+            for (int l = 0; l < L_; ++l) {
+                for (uint32_t first : id_index_.find(ids[l])) {
+                    if (live_[first]) {
+                        if (first == static_cast<uint32_t>(slot)) {
+                            appendBucketKeys(ids[l], keys, values);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    
+    void sendOKVS(Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        io.countSent(okvs_.base().send(io.raw()));
+        
+        std::cout << "Receiver: OKVS 发送完成 (" 
+                  << okvs_.base().totalSize() * sizeof(block) / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+    
+    void sendEncryptedVectorsBatched(Channel& chl) {
+        std::cout << "Receiver: 分批发送加密向量..." << std::endl;
+        std::cout << "Receiver: 将 " << n_ << " 个向量打包到 " << num_ciphers_ 
+                  << " 个密文 (每个密文 " << records_per_cipher_ << " 个向量)" << std::endl;
+        std::cout << "Receiver: 通信量从 " << (n_ * d_) << " 个密文减少到 " 
+                  << num_ciphers_ << " 个密文 (压缩 " 
+                  << static_cast<double>(n_) * d_ / num_ciphers_ << "×)" << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        io.send(num_ciphers_);
+        
+        // 基于信用的滑动窗口：最多 window_batches_ 个批次未确认，
+        // Sender 每处理完一批返回一个信用（批次号），避免每批一个 RTT
+        const int BATCH_SIZE = 16;
+        int num_batches = (num_ciphers_ + BATCH_SIZE - 1) / BATCH_SIZE;
+        int acked = 0;
+        
+        // 缓存文件为逐批的成帧密文：[u64 帧长][帧]...，热启动时原样重发
+        std::vector<std::pair<const uint8_t*, size_t>> cached_frames;
+        if (cached_db_.size() > 0) {
+            const uint8_t* p = cached_db_.data();
+            const uint8_t* end = p + cached_db_.size();
+            while (static_cast<size_t>(end - p) >= sizeof(uint64_t)) {
+                uint64_t size;
+                std::memcpy(&size, p, sizeof(uint64_t));
+                p += sizeof(uint64_t);
+                if (size > static_cast<uint64_t>(end - p)) break;
+                cached_frames.emplace_back(p, size);
+                p += size;
+            }
+            if (static_cast<int>(cached_frames.size()) != num_batches || p != end) {
+                throw std::runtime_error("Cached ciphertext database does not match batch layout");
+            }
+        }
+        
+        std::unique_ptr<OfflineCache::Writer> db_writer;
+        if (cache_.enabled() && cached_frames.empty()) {
+            db_writer = std::make_unique<OfflineCache::Writer>(cache_.create("packed_db"));
+        }
+        
+        auto awaitCredit = [&]() {
+            uint32_t credit;
+            io.recv(credit);
+            if (credit != static_cast<uint32_t>(acked)) {
+                throw std::runtime_error("Batch sync failed");
+            }
+            ++acked;
+        };
+        
+        for (int batch = 0; batch < num_batches; ++batch) {
+            int batch_start = batch * BATCH_SIZE;
+            int batch_end = std::min(batch_start + BATCH_SIZE, num_ciphers_);
+            
+            std::cout << "Receiver: 发送批次 " << (batch + 1) << "/" << num_batches 
+                      << " (密文 " << batch_start << "-" << (batch_end - 1) << ")" << std::endl;
+            
+            if (!cached_frames.empty()) {
+                const auto& [frame, size] = cached_frames[batch];
+                io.countSent(cipher_io_->sendFrame(io.raw(), frame, size));
+            } else {
+                // 整批密文合并为一条成帧消息
+                std::vector<Ciphertext> batch_ciphers(batch_end - batch_start);
+                for (int c = batch_start; c < batch_end; ++c) {
+                    size_t first = static_cast<size_t>(c) * records_per_cipher_;
+                    size_t count = std::min<size_t>(records_per_cipher_, n_ - first);
+                    encryptPacked(first, count, batch_ciphers[c - batch_start]);
+                }
+                io.countSent(cipher_io_->sendBatch(io.raw(), batch_ciphers));
+                
+                if (db_writer) {
+                    const std::vector<uint8_t>& frame = cipher_io_->lastFrame();
+                    db_writer->writeValue(static_cast<uint64_t>(frame.size()));
+                    db_writer->write(frame.data(), frame.size());
+                }
+            }
+            
+            if (batch + 1 - acked >= window_batches_) {
+                awaitCredit();
+            }
+        }
+        
+        while (acked < num_batches) {
+            awaitCredit();
+        }
+        
+        if (db_writer) {
+            db_writer->close();
+        }
+        
+        std::cout << "Receiver: 所有加密向量发送完成" << std::endl;
+        if (modswitch_saved_bytes_ > 0) {
+            std::cout << "Receiver: 模切换节省 " << modswitch_saved_bytes_ / (1024.0 * 1024.0)
+                      << " MB" << std::endl;
+        }
+    }
+    
+    // 编码并加密一个打包密文，再切换到规划的输入层：Sender 只在该层上计算，更高层的模数不必发送
+    void encryptPacked(size_t first, size_t count, Ciphertext& destination) {
+        metrics::ScopedTimer timer(metrics::Stage::Encrypt);
+        Plaintext plain;
+        hamming_->encodeVectors(W_, first, count, plain);
+        encryptor_->encrypt(plain, destination);
+        if (destination.parms_id() != input_parms_id_) {
+            size_t full = destination.save_size(compr_mode_type::none);
+            evaluator_->mod_switch_to_inplace(destination, input_parms_id_);
+            modswitch_saved_bytes_ += full - destination.save_size(compr_mode_type::none);
+        }
+    }
+    
+    void sendPublicKey(Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        io.send(public_key_bytes_);
+        
+        std::cout << "Receiver: 公钥发送完成 (" 
+                  << public_key_bytes_.size() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        
+        io.send(galois_key_bytes_);
+        
+        std::cout << "Receiver: Galois 密钥发送完成 (" 
+                  << galois_key_bytes_.size() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+    
+    // 新增一条记录：优先复用已删除记录的槽位，否则追加到末尾（必要时新增一个密文）。
+    // 变化在 applyUpdates 时编码，返回记录所在的槽位
+    int addRecord(std::vector<uint8_t> w) {
+        ensureIDs();
+        
+        int slot;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            slot = n_++;
+            W_.emplace_back();
+            ID_W_.resize(ID_W_.size() + L_);
+            live_.push_back(0);
+            if (slot / records_per_cipher_ >= num_ciphers_) {
+                ++num_ciphers_;
+                cipher_version_.push_back(0);
+            }
+        }
+        
+        W_[slot] = std::move(w);
+        elsh_->computeIDs(BitVector::fromBytes(W_[slot]).view(),
+                          ID_W_.data() + static_cast<size_t>(slot) * L_);
+        live_[slot] = 1;
+        pending_slots_.push_back(slot);
+        dirty_ciphers_.insert(slot / records_per_cipher_);
+        return slot;
+    }
+    
+    // 删除一条记录：向量清零后随所在密文重新加密，槽位标记为已删除。
+    // 旧段中指向该槽位的键直到下次压缩才消失，Sender 依据删除标记跳过这些候选
+    void removeRecord(int slot) {
+        if (slot < 0 || slot >= n_ || !live_[slot]) {
+            throw std::runtime_error("No live record at slot " + std::to_string(slot));
+        }
+        ensureIDs();
+        
+        live_[slot] = 0;
+        W_[slot].assign(d_, 0);
+        free_slots_.push_back(slot);
+        pending_slots_.erase(std::remove(pending_slots_.begin(), pending_slots_.end(), slot),
+                             pending_slots_.end());
+        dirty_ciphers_.insert(slot / records_per_cipher_);
+    }
+    
+    // 把累积的增删生效：新增记录的 ID 编码为一个 delta 段，改动过的密文记入新版本号。
+    // delta 段累计的键数超过基础段的 COMPACTION_RATIO 或段数超过 MAX_SEGMENTS 时在后台压缩
+    void applyUpdates() {
+        if (okvs_.finishCompaction()) {
+            std::cout << "Receiver: OKVS 压缩完成 (第 " << okvs_.generation() << " 代)" << std::endl;
+        }
+        
+        // ID 索引覆盖全部槽位（已删除的槽位在编码时按 live_ 跳过），新增记录之后重建
+        ensureIDs();
+        id_index_.build(ID_W_.data(), n_, L_);
+        
+        // 新增记录所在的每个 ID 整组重新编码：delta 段中的序号 0 带新的候选数，
+        // 其余序号也全部在同一段中，Sender 解码时不会混用旧段里的旧序号
+        if (!pending_slots_.empty()) {
+            std::vector<ELSHFmap::ID> touched;
+            for (int slot : pending_slots_) {
+                const ELSHFmap::ID* ids = ID_W_.data() + static_cast<size_t>(slot) * L_;
+                touched.insert(touched.end(), ids, ids + L_);
+            }
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            
+            std::vector<block> keys, values;
+            for (ELSHFmap::ID id : touched) {
+                appendBucketKeys(id, keys, values);
+            }
+            okvs_.appendSegment(keys.data(), values.data(), keys.size(),
+                                block(prng_.get<uint64_t>(), prng_.get<uint64_t>()));
+        }
+        
+        ++db_version_;
+        for (int c : dirty_ciphers_) {
+            cipher_version_[c] = db_version_;
+        }
+        
+        std::cout << "Receiver: 数据库版本 " << db_version_ << " - " << pending_slots_.size()
+                  << " 条新增, " << dirty_ciphers_.size() << " 个密文待重新加密, OKVS "
+                  << okvs_.numSegments() << " 段" << std::endl;
+        pending_slots_.clear();
+        dirty_ciphers_.clear();
+        
+        if (!okvs_.compactionPending() &&
+            (okvs_.numSegments() > MAX_SEGMENTS ||
+             okvs_.deltaItems() > COMPACTION_RATIO * okvs_.base().numItems())) {
+            std::vector<block> keys, values;
+            appendAllKeys(keys, values);
+            std::cout << "Receiver: 后台压缩 OKVS (" << keys.size() << " 个键)..." << std::endl;
+            okvs_.startCompaction(std::move(keys), std::move(values),
+                                  block(prng_.get<uint64_t>(), prng_.get<uint64_t>()));
+        }
+    }
+    
+    // 模拟一天的数据库变化：随机删除 fraction 比例的记录，再新增同样数量的随机记录
+    void simulateUpdates(double fraction) {
+        std::vector<int> live_slots;
+        for (int slot = 0; slot < n_; ++slot) {
+            if (live_[slot]) {
+                live_slots.push_back(slot);
+            }
+        }
+        
+        int changes = std::max(1, static_cast<int>(fraction * live_slots.size()));
+        changes = std::min(changes, static_cast<int>(live_slots.size()));
+        for (int k = 0; k < changes; ++k) {
+            size_t pick = k + prng_.get<uint64_t>() % (live_slots.size() - k);
+            std::swap(live_slots[k], live_slots[pick]);
+            removeRecord(live_slots[k]);
+        }
+        for (int k = 0; k < changes; ++k) {
+            addRecord(utils::generateRandomBinaryVector(d_, prng_));
+        }
+        
+        applyUpdates();
+    }
+    
+    // 把 Sender 上次同步之后的变化发过去：新增的 OKVS 段（期间压缩过则发送全部段）、
+    // 已删除槽位的完整列表，以及版本号晚于 Sender 已知版本的密文（只重新加密这些密文）
+    void syncUpdates(Channel& chl) {
+        std::cout << "\n========== Receiver: 增量同步 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        CommStats comm;
+        MeteredChannel io(chl, comm);
+        
+        uint64_t peer_generation = 0, peer_version = 0;
+        uint32_t peer_segments = 0;
+        io.recv(peer_generation);
+        io.recv(peer_segments);
+        io.recv(peer_version);
+        
+        io.countSent(okvs_.sendSince(io.raw(), peer_generation, static_cast<int>(peer_segments)));
+        
+        // 删除标记：(密文下标, 组号) 对
+        std::vector<uint32_t> tombstones;
+        for (int slot : free_slots_) {
+            tombstones.push_back(static_cast<uint32_t>(slot / records_per_cipher_));
+            tombstones.push_back(static_cast<uint32_t>(slot % records_per_cipher_));
+        }
+        io.send(num_ciphers_);
+        sendList(io, tombstones);
+        
+        std::vector<uint32_t> changed;
+        for (int c = 0; c < num_ciphers_; ++c) {
+            if (cipher_version_[c] > peer_version) {
+                changed.push_back(static_cast<uint32_t>(c));
+            }
+        }
+        sendList(io, changed);
+        
+        const size_t BATCH_SIZE = 16;
+        std::vector<Ciphertext> batch_ciphers;
+        for (size_t begin = 0; begin < changed.size(); begin += BATCH_SIZE) {
+            size_t end = std::min(begin + BATCH_SIZE, changed.size());
+            batch_ciphers.resize(end - begin);
+            for (size_t k = begin; k < end; ++k) {
+                size_t first = static_cast<size_t>(changed[k]) * records_per_cipher_;
+                size_t count = std::min<size_t>(records_per_cipher_, n_ - first);
+                encryptPacked(first, count, batch_ciphers[k - begin]);
+            }
+            io.countSent(cipher_io_->sendBatch(io.raw(), batch_ciphers));
+        }
+        
+        io.send(db_version_);
+        
+        timer.stop();
+        std::cout << "Receiver: 同步到版本 " << db_version_ << " - 重新加密 " << changed.size()
+                  << "/" << num_ciphers_ << " 个密文, " << tombstones.size() / 2 << " 个删除标记 ("
+                  << timer.getElapsedSeconds() << " 秒)" << std::endl;
+        comm.print("增量同步");
+        offline_comm_.merge(comm);
+    }
+    
+    // 线程预算：离线线程池大小（E-LSH ID、OKVS 分片编码）与在线信道数（与 Sender 协商后取较小者）
+    void setThreads(int threads) {
+        online_threads_ = std::max(threads, 1);
+        pool_ = std::make_unique<ThreadPool>(online_threads_);
+    }
+    
+    void runOnline(Session& session, Channel& chl) {
+        std::cout << "\n========== Receiver: 在线阶段 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        MeteredChannel io(chl, online_comm_);
+        int m_sender, batch_queries;
+        io.recv(m_sender);
+        io.recv(batch_queries);
+        if (m_sender > 0 && batch_queries <= 0) {
+            throw std::runtime_error("Invalid online batch size");
+        }
+        
+        // open 在主信道上交换一次线程数
+        std::vector<Channel> channels = multi_channel::open(session, chl, online_threads_);
+        int num_threads = static_cast<int>(channels.size());
+        io.countSent(sizeof(uint32_t));
+        io.countReceived(sizeof(uint32_t));
+        
+        if (static_cast<size_t>(m_sender) > ot_receiver_.size()) {
+            throw std::runtime_error("Sender query count exceeds precomputed OTs");
+        }
+        
+        std::cout << "Receiver: Sender 数据集大小 = " << m_sender 
+                  << " (" << num_threads << " 个信道, 每批 " << batch_queries << " 个)" << std::endl;
+        
+        matched_sender_indices_.clear();
+        fuzzy_intersection_.clear();
+        
+        // 每个线程独立的 Decryptor / BatchEncoder / 收发缓冲
+        std::vector<OnlineWorker> workers(num_threads);
+        for (auto& worker : workers) {
+            worker.pool = MemoryPoolHandle::New();
+            worker.plain = Plaintext(worker.pool);
+            worker.decryptor = std::make_unique<Decryptor>(*context_, secret_key_);
+            worker.encoder = std::make_unique<BatchEncoder>(*context_);
+            worker.io = std::make_unique<CipherIO>(context_, cipher_io_->compression());
+        }
+        
+        // 查询按批处理（非流式时整个查询集为一批），每批在全部信道上完成测试、匹配位与
+        // 输出传输之后再开始下一批；各线程区间连续且递增，每批按线程顺序合并即按 j 有序
+        for (int batch_begin = 0; batch_begin < m_sender; batch_begin += batch_queries) {
+            int batch_count = std::min(batch_queries, m_sender - batch_begin);
+            multi_channel::run(channels, [&](int t, Channel& c) {
+                int begin, end;
+                multi_channel::splitRange(batch_count, num_threads, t, begin, end);
+                processRange(workers[t], c, batch_begin + begin, batch_begin + end,
+                             t == 0 && batch_count == m_sender);
+            });
+            
+            for (auto& worker : workers) {
+                for (auto& [j, vec] : worker.fuzzy) {
+                    matched_sender_indices_.insert(j);
+                    fuzzy_intersection_.push_back(std::move(vec));
+                }
+                worker.fuzzy.clear();
+            }
+            if (batch_count < m_sender) {
+                std::cout << "Receiver: 流式进度 " << batch_begin + batch_count << "/" << m_sender
+                          << ", 已匹配 " << matched_sender_indices_.size() << std::endl;
+            }
+        }
+        
+        size_t pool_peak = 0;
+        for (auto& worker : workers) {
+            pool_peak = std::max(pool_peak, worker.pool.alloc_byte_count());
+            online_comm_.merge(worker.comm);
+        }
+        
+        timer.stop();
+        online_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Receiver: 找到 " << matched_sender_indices_.size() 
+                  << " 个匹配" << std::endl;
+        std::cout << "Receiver: 在线阶段完成 - " << online_time_ << " 秒"
+                  << " (单线程内存池峰值 " << pool_peak / (1024.0 * 1024.0) << " MB)" << std::endl;
+        online_comm_.print("在线");
+    }
+    
+    // 一个信道上的一段查询 [begin, end)：先收每个查询的测试数（每个 ID 至少一个，至多为本方记录数），
+    // 再接收全部阈值测试帧（每帧的密文数由帧头给出），解密得到逐候选标志 e，按查询求 OR 后
+    // 只回一条按位打包的匹配位，最后把整段的输出传输合并为一轮
+    void processRange(OnlineWorker& worker, Channel& c, int begin, int end, bool report) {
+        if (begin == end) {
+            return;
+        }
+        MeteredChannel worker_io(c, worker.comm);
+        
+        std::vector<uint32_t> test_counts;
+        std::vector<size_t> test_offsets(1, 0);
+        worker_io.recv(test_counts);
+        if (test_counts.size() != static_cast<size_t>(end - begin)) {
+            throw std::runtime_error("Unexpected threshold test count list");
+        }
+        for (uint32_t count : test_counts) {
+            if (count < static_cast<uint32_t>(L_) || count > static_cast<uint64_t>(L_) * n_) {
+                throw std::runtime_error("Invalid threshold test count");
+            }
+            test_offsets.push_back(test_offsets.back() + count);
+        }
+        
+        size_t total = test_offsets.back();
+        std::vector<uint8_t> has_match(end - begin, 0);
+        size_t query = 0;
+        size_t next_report = 100;
+        for (size_t received = 0; received < total;) {
+            if (report && query >= next_report) {
+                std::cout << "Receiver: 进度 " << query << "/" << (end - begin) 
+                          << " (线程 0)" << std::endl;
+                next_report += 100;
+            }
+            worker_io.countReceived(worker.io->receiveBatch(worker_io.raw(), worker.tests));
+            if (worker.tests.empty() || received + worker.tests.size() > total) {
+                throw std::runtime_error("Unexpected threshold test frame size");
+            }
+            received = processTests(worker, received, test_offsets, query, has_match);
+        }
+        
+        uint64_t match_sent = c.getTotalDataSent();
+        PrivateEqualityTest::sendAnyOneBatch(has_match, c);
+        worker_io.countSent(c.getTotalDataSent() - match_sent);
+        
+        // 区间内全部输出传输合并为一轮
+        uint64_t sent = 0, received = 0;
+        std::vector<std::vector<uint8_t>> received_vectors =
+            ot_receiver_.receiveBatch(begin, has_match, d_, c, &sent, &received);
+        worker_io.countSent(sent);
+        worker_io.countReceived(received);
+        
+        for (int j = begin; j < end; ++j) {
+            if (has_match[j - begin]) {
+                worker.fuzzy.emplace_back(j, std::move(received_vectors[j - begin]));
+            }
+        }
+    }
+    
+    // 解密一帧阈值零测试密文（区间内第 offset 个候选起），把每个候选的标志 e 并入所属查询的
+    // has_match；query 为游标，test_offsets[query] ≤ 候选 < test_offsets[query + 1]。返回处理后的候选数
+    size_t processTests(OnlineWorker& worker, size_t offset, const std::vector<size_t>& test_offsets,
+                        size_t& query, std::vector<uint8_t>& has_match) {
+        for (const Ciphertext& test : worker.tests) {
+            while (test_offsets[query + 1] <= offset) {
+                ++query;
+            }
+            // 每个候选只有一个阈值零测试密文：存在零槽位即 HD ≤ δ
+            metrics::ScopedTimer timer(metrics::Stage::Decrypt);
+            worker.decryptor->decrypt(test, worker.plain);
+            worker.encoder->decode(worker.plain, worker.decoded, worker.pool);
+            if (PackedHammingEngine::anyZero(worker.decoded)) {
+                has_match[query] = 1;
+            }
+            ++offset;
+        }
+        return offset;
+    }
+    
+    // 先发送元素个数，非空时再发送内容
+    static void sendList(MeteredChannel& io, const std::vector<uint32_t>& list) {
+        uint32_t count = static_cast<uint32_t>(list.size());
+        io.send(count);
+        if (count > 0) {
+            io.send(list);
+        }
+    }
+    
+    // 热启动时没有计算 ID，第一次增删前补齐
+    void ensureIDs() {
+        if (ID_W_.size() != W_.size() * L_) {
+            ID_W_ = elsh_->computeIDBatchFlat(W_, pool_.get());
+        }
+    }
+    
+    void sendCiphertext(const Ciphertext& cipher, Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        io.countSent(cipher_io_->send(io.raw(), cipher));
+    }
+    
+    double offlineTime() const { return offline_time_; }
+    double onlineTime() const { return online_time_; }
+    const CommStats& offlineComm() const { return offline_comm_; }
+    const CommStats& onlineComm() const { return online_comm_; }
+    
+    // Receiver 得到的匹配查询下标（升序）与对应的 Sender 向量
+    const std::set<int>& matchedQueries() const { return matched_sender_indices_; }
+    const std::vector<std::vector<uint8_t>>& fuzzyIntersection() const { return fuzzy_intersection_; }
+    
+    void printStatistics() {
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "Receiver 协议统计" << std::endl;
+        std::cout << "========================================" << std::endl;
+        std::cout << "参数: n=" << n_ << ", d=" << d_ 
+                  << ", δ=" << delta_ << ", L=" << L_ << std::endl;
+        std::cout << "模糊交集大小: " << fuzzy_intersection_.size() << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "离线阶段: " << offline_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << offline_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << "  模切换节省: " << modswitch_saved_bytes_ / (1024.0 * 1024.0) << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "在线阶段: " << online_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << online_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "总计: " << (offline_time_ + online_time_) << " 秒" << std::endl;
+        std::cout << "  通信: " << (offline_comm_.getTotalMegabytes() + 
+                     online_comm_.getTotalMegabytes()) << " MB" << std::endl;
+        std::cout << "========================================" << std::endl;
+    }
+
+private:
+    static constexpr int MAX_SEGMENTS = 8;              // 基础段之外最多保留的 delta 段数
+    static constexpr double COMPACTION_RATIO = 0.1;     // delta 键数 / 基础段键数
+    
+    int n_, d_, delta_, L_;
+    BfvPlan plan_;
+    size_t slot_count_;
+    int records_per_cipher_;    // 每个密文打包的向量数
+    int num_ciphers_;           // 打包后的密文数
+    int window_batches_ = 8;    // 滑动窗口大小（批次）
+    int online_threads_ = 1;
+    
+    PRNG prng_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<ELSHFmap> elsh_;
+    
+    std::shared_ptr<SEALContext> context_;
+    parms_id_type input_parms_id_;      // 离线密文发送前切换到的层
+    uint64_t modswitch_saved_bytes_ = 0;
+    SecretKey secret_key_;
+    PublicKey public_key_;
+    std::string public_key_bytes_;      // 序列化的公钥与 Galois 密钥
+    std::string galois_key_bytes_;
+    std::unique_ptr<Encryptor> encryptor_;
+    std::unique_ptr<Decryptor> decryptor_;
+    std::unique_ptr<Evaluator> evaluator_;
+    std::unique_ptr<BatchEncoder> encoder_;
+    std::unique_ptr<KeyGenerator> keygen_;
+    std::unique_ptr<PackedHammingEngine> hamming_;
+    std::unique_ptr<CipherIO> cipher_io_;
+    BatchOTReceiver ot_receiver_;
+    
+    std::vector<std::vector<uint8_t>> W_;
+    std::vector<ELSHFmap::ID> ID_W_;        // n × L 个 ID，按槽位连续存放
+    IdIndex id_index_;                      // ID -> 共享该 ID 的槽位，编码 (ID, 序号) 键时使用
+    
+    SegmentedOkvs okvs_;
+    
+    // 增量更新状态：live_[slot] 为 0 表示记录已删除（槽位可复用），
+    // cipher_version_[c] 为密文 c 最后一次改动时的数据库版本
+    std::vector<uint8_t> live_;
+    std::vector<int> free_slots_;
+    std::vector<int> pending_slots_;        // 尚未编码进 delta 段的新增记录
+    std::set<int> dirty_ciphers_;
+    std::vector<uint64_t> cipher_version_;
+    uint64_t db_version_ = 0;
+    
+    OfflineCache cache_;
+    MappedFile cached_db_;      // 热启动时映射的打包密文库
+    
+    std::set<int> matched_sender_indices_;
+    std::vector<std::vector<uint8_t>> fuzzy_intersection_;
+    
+    double offline_time_ = 0.0;
+    double online_time_ = 0.0;
+    CommStats offline_comm_;
+    CommStats online_comm_;
+};
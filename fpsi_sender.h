@@ -0,0 +1,434 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <future>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <exception>
+
+// SEAL 库
+#include <seal/seal.h>
+
+// cryptoTools 库 - 确保正确的头文件顺序
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+// 网络库 - 必须在 Defines 之后
+#include "cryptoTools/Network/Channel.h"
+
+// 项目头文件
+#include "bit_vector.h"
+#include "dataset.h"
+#include "elsh.h"
+#include "metrics.h"
+#include "okvs_shard.h"
+#include "stream_pipeline.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace osuCrypto;
+using namespace seal;
+
+// 模拟协议的 Sender（fpsi_sender 与 fpsi_bench 共用）：离线接收 OKVS 并批量解码，在线发送掩码后的查询
+class FPSISender {
+public:
+    FPSISender(int m, int d, int delta, int L, int threads = 0)
+        : m_(m), d_(d), delta_(delta), L_(L) {
+        
+        pool_ = std::make_unique<ThreadPool>(threads);
+        
+        prng_.SetSeed(block(123456, 789012));
+        elsh_ = std::make_unique<ELSHFmap>(d, delta, L);
+    }
+    
+    void generateData() {
+        std::cout << "Sender: 生成 " << m_ << " 个 " << d_ << " 维向量..." << std::endl;
+        
+        dataset::generateRandom(Q_storage_, m_, d_, prng_);
+        Q_ = Q_storage_.view();
+        
+        std::cout << "Sender: 数据生成完成 (" 
+                  << Q_storage_.memoryBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+    
+    // 以 mmap 方式加载打包数据集文件（见 dataset.h），行数即 m
+    void loadData(const std::string& path) {
+        mapped_.open(path);
+        if (mapped_.dim() != d_) {
+            throw std::runtime_error("数据集维度与 d 不一致: " + path);
+        }
+        if (mapped_.rows() > static_cast<size_t>(INT32_MAX)) {
+            throw std::runtime_error("数据集行数过多: " + path);
+        }
+        m_ = static_cast<int>(mapped_.rows());
+        Q_ = mapped_.view();
+        
+        std::cout << "Sender: 已映射数据集 " << path << " (" << m_ << " 个向量)" << std::endl;
+    }
+    
+    // 加载 Receiver 生成的 E-LSH 参数文件，保证双方使用相同的子集
+    void loadELSHParams(const std::string& filename) {
+        if (!elsh_->loadParams(filename)) {
+            throw std::runtime_error("找不到 E-LSH 参数文件: " + filename);
+        }
+        std::cout << "Sender: 已加载 E-LSH 参数 " << filename << std::endl;
+    }
+    
+    // 流式模式下离线阶段只接收公钥与 OKVS，ID 计算和 OKVS 解码推迟到在线阶段按批执行
+    void setStreaming(const stream_pipeline::Options& options) {
+        stream_ = options;
+    }
+    
+    void runOffline(osuCrypto::Channel& chl) {
+        std::cout << "\n========== Sender: 离线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // Step 1: 计算 E-LSH ID
+        if (!stream_.enabled) {
+            std::cout << "Sender: 计算 E-LSH ID..." << std::endl;
+            ID_Q_.resize(Q_.rows * L_);
+            elsh_->computeIDBatch(Q_, ID_Q_.data(), *pool_);
+            
+            uint64_t id_count = ID_Q_.size();
+            std::cout << "Sender: 生成了 " << id_count << " 个 ID (平均每个向量 " 
+                      << (double)id_count / m_ << " 个 ID)" << std::endl;
+        }
+        
+        // Step 2: 接收公钥和 OKVS 编码
+        // Receiver 先发送公钥，再逐个分片流式发送 OKVS；
+        // SEAL 上下文在后台线程构建，与 OKVS 接收重叠
+        std::cout << "Sender: 等待接收 Receiver 的公钥和 OKVS 编码..." << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        std::string pk_str;
+        io.recv(pk_str);
+        
+        std::cout << "Sender: 公钥接收完成 (" 
+                  << pk_str.size() / (1024.0 * 1024.0) << " MB), 后台初始化 SEAL..." << std::endl;
+        
+        auto seal_ready = std::async(std::launch::async,
+                                     [this, pk = std::move(pk_str)]() { initializeSEAL(pk); });
+        
+        // 接收分片 OKVS：分片数 + 每个分片的头部与编码各一条消息
+        uint64_t okvs_bytes = okvs_.receive(io.raw());
+        io.countReceived(okvs_bytes, 1 + 2 * okvs_.numShards());
+        
+        std::cout << "Sender: OKVS 数据接收完成 (" << okvs_.numShards() << " 个分片, "
+                  << okvs_.totalSize() * sizeof(block) / (1024.0 * 1024.0) << " MB)" << std::endl;
+        
+        // Step 3: 一次性批量解码全部 m × L 个查询键（与 SEAL 初始化重叠）
+        if (!stream_.enabled) {
+            std::cout << "Sender: 批量解码 " << ID_Q_.size() << " 个 OKVS 键..." << std::endl;
+            decoded_.resize(ID_Q_.size());
+            decodeQueries(ID_Q_.data(), Q_.rows, decoded_.data());
+        }
+        
+        seal_ready.get();
+        std::cout << "Sender: SEAL 初始化完成" << std::endl;
+        
+        timer.stop();
+        offline_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Sender: 离线阶段完成" << std::endl;
+        std::cout << "  时间: " << offline_time_ << " 秒" << std::endl;
+        offline_comm_.print("离线");
+    }
+    
+    void runOnline(osuCrypto::Channel& chl) {
+        if (stream_.enabled) {
+            runOnlineStreaming(chl);
+            return;
+        }
+        
+        std::cout << "\n========== Sender: 在线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // 发送数据集大小和分块大小
+        MeteredChannel io(chl, online_comm_);
+        io.send(m_);
+        io.send(ONLINE_CHUNK_QUERIES);
+        int rate_s = L_;  // 每个向量的 ID 数量
+        
+        std::cout << "Sender: 处理 " << m_ << " 个查询向量..." << std::endl;
+        std::cout << "Sender: 每个向量有约 " << rate_s << " 个 ID" << std::endl;
+        
+        // 每 ONLINE_CHUNK_QUERIES 个查询的全部 u 向量（按位打包）与 ID 序号放在一块连续缓冲区，一次发送
+        const int words = Q_.words_per_row;
+        const size_t max_rows = static_cast<size_t>(ONLINE_CHUNK_QUERIES) * L_;
+        std::vector<uint64_t> u_buffer(max_rows * words + (max_rows + 1) / 2);
+        
+        int total_sent = 0;
+        int total_messages = 0;
+        
+        for (int chunk_begin = 0; chunk_begin < m_; chunk_begin += ONLINE_CHUNK_QUERIES) {
+            int chunk_end = std::min(chunk_begin + ONLINE_CHUNK_QUERIES, m_);
+            
+            if (chunk_begin % 256 == 0) {
+                std::cout << "Sender: 处理进度 " << chunk_begin << "/" << m_ << std::endl;
+            }
+            
+            // OKVS 解码值已在离线阶段批量算出，位于 decoded_[j * L + l]
+            size_t count = maskQueries(chunk_begin, chunk_end,
+                                       decoded_.data() + static_cast<size_t>(chunk_begin) * L_,
+                                       u_buffer.data());
+            total_sent += (chunk_end - chunk_begin) * L_;
+            io.send(u_buffer.data(), count);
+            total_messages++;
+        }
+        
+        std::cout << "Sender: 共发送 " << total_sent << " 个 u 向量 (" 
+                  << total_messages << " 条消息)" << std::endl;
+        
+        timer.stop();
+        online_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Sender: 在线阶段完成" << std::endl;
+        std::cout << "  时间: " << online_time_ << " 秒" << std::endl;
+        online_comm_.print("在线");
+    }
+    
+    // 流式在线阶段：后台线程按批计算 E-LSH ID 并解码 OKVS，主线程对已完成的批次生成掩码并发送。
+    // 两阶段之间循环使用 depth 个批次缓冲区，后台阶段最多领先 depth 批，
+    // 内存为 depth × batch_queries × L 个 ID 与解码值，与 m 无关
+    void runOnlineStreaming(osuCrypto::Channel& chl) {
+        std::cout << "\n========== Sender: 在线阶段开始（流式） ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // m = -1 表示流式：之后每条消息前先发送本条的查询数，查询数为 0 表示结束
+        MeteredChannel io(chl, online_comm_);
+        int stream_marker = -1;
+        io.send(stream_marker);
+        io.send(ONLINE_CHUNK_QUERIES);
+        
+        const size_t batch_queries = static_cast<size_t>(stream_.batch_queries);
+        std::cout << "Sender: 流式处理 " << Q_.rows << " 个查询向量, 每批 " << batch_queries
+                  << " 个, 缓冲 " << stream_.depth << " 批" << std::endl;
+        
+        BoundedQueue<std::unique_ptr<QueryBatch>> free_batches(stream_.depth);
+        BoundedQueue<std::unique_ptr<QueryBatch>> ready_batches(stream_.depth);
+        for (int i = 0; i < stream_.depth; ++i) {
+            free_batches.push(std::make_unique<QueryBatch>());
+        }
+        
+        std::exception_ptr producer_error;
+        std::thread producer([&]() {
+            try {
+                std::unique_ptr<QueryBatch> batch;
+                for (size_t begin = 0; begin < Q_.rows; begin += batch_queries) {
+                    if (!free_batches.pop(batch)) {
+                        break;
+                    }
+                    batch->begin = begin;
+                    batch->count = std::min(batch_queries, Q_.rows - begin);
+                    
+                    // 只映射并处理本批的行，数据集文件按需换页
+                    BitMatrixView rows{Q_.data + begin * Q_.words_per_row, batch->count,
+                                       Q_.d, Q_.words_per_row};
+                    batch->ids.resize(batch->count * L_);
+                    elsh_->computeIDBatch(rows, batch->ids.data(), *pool_);
+                    
+                    batch->decoded.resize(batch->ids.size());
+                    decodeQueries(batch->ids.data(), batch->count, batch->decoded.data());
+                    
+                    if (!ready_batches.push(std::move(batch))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                producer_error = std::current_exception();
+            }
+            ready_batches.close();
+        });
+        
+        const int words = Q_.words_per_row;
+        const size_t max_rows = static_cast<size_t>(ONLINE_CHUNK_QUERIES) * L_;
+        std::vector<uint64_t> u_buffer(max_rows * words + (max_rows + 1) / 2);
+        size_t total_sent = 0;
+        int total_messages = 0;
+        int batches_done = 0;
+        
+        try {
+            std::unique_ptr<QueryBatch> batch;
+            while (ready_batches.pop(batch)) {
+                size_t batch_end = batch->begin + batch->count;
+                for (size_t chunk_begin = batch->begin; chunk_begin < batch_end;
+                     chunk_begin += ONLINE_CHUNK_QUERIES) {
+                    size_t chunk_end = std::min(chunk_begin + ONLINE_CHUNK_QUERIES, batch_end);
+                    
+                    const block* decoded = batch->decoded.data() + (chunk_begin - batch->begin) * L_;
+                    size_t count = maskQueries(chunk_begin, chunk_end, decoded, u_buffer.data());
+                    int queries = static_cast<int>(chunk_end - chunk_begin);
+                    io.send(queries);
+                    io.send(u_buffer.data(), count);
+                    total_sent += static_cast<size_t>(queries) * L_;
+                    total_messages++;
+                }
+                
+                if (batches_done++ == 0) {
+                    std::cout << "Sender: 首批结果已发送 (" << timer.getElapsedSecondsSoFar()
+                              << " 秒)" << std::endl;
+                }
+                std::cout << "Sender: 流式进度 " << batch_end << "/" << Q_.rows << std::endl;
+                free_batches.push(std::move(batch));
+            }
+        } catch (...) {
+            free_batches.close();
+            ready_batches.close();
+            producer.join();
+            throw;
+        }
+        
+        producer.join();
+        if (producer_error) {
+            std::rethrow_exception(producer_error);
+        }
+        
+        int end_marker = 0;
+        io.send(end_marker);
+        
+        std::cout << "Sender: 共发送 " << total_sent << " 个 u 向量 (" 
+                  << total_messages << " 条消息, " << batches_done << " 批)" << std::endl;
+        
+        timer.stop();
+        online_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Sender: 在线阶段完成" << std::endl;
+        std::cout << "  时间: " << online_time_ << " 秒" << std::endl;
+        online_comm_.print("在线");
+    }
+    
+    double offlineTime() const { return offline_time_; }
+    double onlineTime() const { return online_time_; }
+    const CommStats& offlineComm() const { return offline_comm_; }
+    const CommStats& onlineComm() const { return online_comm_; }
+    
+    void printStatistics() {
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "Sender 统计信息" << std::endl;
+        std::cout << "========================================" << std::endl;
+        std::cout << "参数: m=" << m_ << ", d=" << d_ << ", δ=" << delta_ << ", L=" << L_ << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "离线阶段:" << std::endl;
+        std::cout << "  时间: " << offline_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << offline_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "在线阶段:" << std::endl;
+        std::cout << "  时间: " << online_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << online_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "总计:" << std::endl;
+        std::cout << "  时间: " << (offline_time_ + online_time_) << " 秒" << std::endl;
+        std::cout << "  通信: " << (offline_comm_.getTotalMegabytes() + online_comm_.getTotalMegabytes()) 
+                  << " MB" << std::endl;
+        std::cout << "========================================" << std::endl;
+        
+        utils::saveStats("fpsi_stats.txt", "Sender", offline_time_, online_time_,
+                        offline_comm_, online_comm_, m_, d_, delta_);
+    }
+
+private:
+    // 在线阶段每条消息包含的查询数
+    static constexpr int ONLINE_CHUNK_QUERIES = 64;
+    
+    // 流式模式中在两个阶段之间传递的一批查询
+    struct QueryBatch {
+        size_t begin = 0;                   // 批内第一个查询的全局下标
+        size_t count = 0;
+        std::vector<ELSHFmap::ID> ids;      // count × L 个 ID
+        std::vector<block> decoded;         // 与 ids 一一对应的 OKVS 解码值
+    };
+    
+    // 解码 count 个查询的 count × L 个 OKVS 键
+    void decodeQueries(const ELSHFmap::ID* ids, size_t count, block* out) {
+        std::vector<block> okvs_keys(count * L_);
+        pool_->parallelFor(count, 1024, [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                for (int l = 0; l < L_; ++l) {
+                    size_t idx = j * L_ + l;
+                    okvs_keys[idx] = ELSHFmap::okvsKey(ids[idx]);
+                }
+            }
+        });
+        okvs_.decodeBatch(okvs_keys.data(), okvs_keys.size(), out, pool_.get());
+    }
+    
+    // 为查询 [begin, end) 的每个 ID 生成 u = mask XOR q_j 并按位打包到 out，返回写入的字数。
+    // decoded 指向查询 begin 的 L 个 OKVS 解码值，mask 由对应的解码值扩展得到。
+    // 全部 u 之后是每个解码值的低 32 位（Receiver 的 ID 序号），两个一字
+    size_t maskQueries(size_t begin, size_t end, const block* decoded, uint64_t* out) {
+        metrics::ScopedTimer timer(metrics::Stage::Mask);
+        const int words = Q_.words_per_row;
+        const uint64_t tail = BitVector::tailMask(d_);
+        const size_t rows = (end - begin) * L_;
+        uint64_t* u = out;
+        uint64_t* tags = out + rows * words;
+        std::fill(tags, tags + (rows + 1) / 2, 0);
+        for (size_t r = 0; r < rows; ++r, ++decoded) {
+            const uint64_t* q = Q_.row(begin + r / L_).words;
+            utils::expandMask(*decoded, u, words);
+            for (int w = 0; w < words; ++w) {
+                u[w] ^= q[w];
+            }
+            u[words - 1] &= tail;  // 末字多余位清零
+            u += words;
+            tags[r / 2] |= (decoded->get<uint64_t>(0) & 0xffffffffULL) << (32 * (r % 2));
+        }
+        return rows * words + (rows + 1) / 2;
+    }
+    
+    // 创建 SEAL 上下文并加载 Receiver 的公钥
+    void initializeSEAL(const std::string& pk_str) {
+        EncryptionParameters parms(scheme_type::bfv);
+        size_t poly_modulus_degree = 8192;
+        parms.set_poly_modulus_degree(poly_modulus_degree);
+        parms.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+        parms.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, 20));
+        
+        context_ = std::make_shared<SEALContext>(parms);
+        
+        std::stringstream pk_stream(pk_str);
+        PublicKey public_key;
+        public_key.load(*context_, pk_stream);
+        
+        encryptor_ = std::make_unique<Encryptor>(*context_, public_key);
+    }
+    
+    int m_;
+    int d_;
+    int delta_;
+    int L_;
+    
+    PRNG prng_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<ELSHFmap> elsh_;
+    std::shared_ptr<SEALContext> context_;
+    std::unique_ptr<Encryptor> encryptor_;
+    
+    BitMatrix Q_storage_;               // generateData 生成的数据
+    MappedDataset mapped_;              // loadData 映射的数据集文件
+    BitMatrixView Q_;                   // 当前使用的数据（指向以上两者之一）
+    std::vector<ELSHFmap::ID> ID_Q_;    // m × L 个 ID，按行连续存放
+    ShardedOkvs okvs_;
+    std::vector<block> decoded_;        // m × L 个 OKVS 解码值，与 ID_Q_ 一一对应
+    stream_pipeline::Options stream_;
+    
+    double offline_time_ = 0.0;
+    double online_time_ = 0.0;
+    CommStats offline_comm_;
+    CommStats online_comm_;
+};
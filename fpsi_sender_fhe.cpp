@@ -0,0 +1,89 @@
+#include "fpsi_sender_fhe.h"
+
+#include "cryptoTools/Network/IOService.h"
+
+int main(int argc, char** argv) {
+    int m = 256;
+    int d = 128;
+    int delta = 10;
+    int L = 8;
+    compr_mode_type cipher_compression = compr_mode_type::none;    // 局域网上不压缩更快
+    int zero_pool_threads = 2;     // 离线生成 Enc(0) 池的后台线程数
+    int update_rounds = 0;         // 离线之后的增量同步轮数（与 Receiver 一致）
+    
+    std::string ip = "127.0.0.1";
+    int port = 12345;
+    
+    int online_threads = 1;
+    std::string cache_dir;
+    stream_pipeline::Options stream;
+    metrics::Options metrics_options;
+    try {
+        // --threads N：线程预算，即离线线程池大小与在线阶段并行信道数（可出现在任意位置）
+        online_threads = multi_channel::extractThreadsFlag(argc, argv, 1);
+        
+        // --cache DIR：离线状态缓存目录，与 Receiver 的缓存标识一致时跳过接收
+        cache_dir = OfflineCache::extractDirFlag(argc, argv);
+        
+        // --stream B：流式在线阶段，每批 B 个查询；--stream-depth K：最多预先解码 K 批
+        stream = stream_pipeline::extractFlags(argc, argv);
+        
+        // --metrics FILE：启用分阶段插桩，结束时写出 JSON（FILE 以 .prom 结尾时为 Prometheus 文本）
+        metrics_options = metrics::extractFlags(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [ip] [port] [data]"
+                  << " [--threads N] [--cache DIR] [--stream B] [--stream-depth K] [--metrics FILE]"
+                  << std::endl;
+        return 1;
+    }
+    
+    if (argc > 1) ip = argv[1];
+    if (argc > 2) port = std::atoi(argv[2]);
+    std::string data_path;    // 为空时随机生成数据，否则加载 fpsi_datagen 生成的文件
+    if (argc > 3) data_path = argv[3];
+    
+    std::cout << "========================================" << std::endl;
+    std::cout << "FPSI 协议 - Sender (修复版)" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "参数: m=" << m << ", d=" << d << ", δ=" << delta << ", L=" << L << std::endl;
+    std::cout << "连接: " << ip << ":" << port << ", 在线线程: " << online_threads << std::endl;
+    std::cout << "========================================" << std::endl;
+    
+    try {
+        FPSISenderFixed sender(m, d, delta, L, online_threads);
+        sender.setCipherCompression(cipher_compression);
+        sender.setCacheDir(cache_dir);
+        sender.setZeroPoolThreads(zero_pool_threads);
+        sender.setStreaming(stream);
+        if (data_path.empty()) {
+            sender.generateData();
+        } else {
+            sender.loadData(data_path);
+        }
+        
+        std::cout << "\nSender: 连接到 Receiver..." << std::endl;
+        
+        IOService ios;
+        Session session(ios, ip, (u32)port, SessionMode::Client);
+        Channel chl = session.addChannel();
+        
+        std::cout << "Sender: 连接成功!" << std::endl;
+        
+        sender.runOffline(chl);
+        for (int round = 0; round < update_rounds; ++round) {
+            sender.fetchUpdates(chl);
+        }
+        sender.runOnline(session, chl);
+        sender.printStatistics();
+        metrics::writeReport(metrics_options, "Sender");
+        
+        std::cout << "\n✓ Sender: 协议执行完成!" << std::endl;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
\ No newline at end of file
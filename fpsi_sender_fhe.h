@@ -0,0 +1,851 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#include <seal/seal.h>
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Network/Channel.h"
+#include "cryptoTools/Network/Session.h"
+
+#include "bfv_planner.h"
+#include "cipher_io.h"
+#include "dataset.h"
+#include "elsh.h"
+#include "he_hamming.h"
+#include "metrics.h"
+#include "multi_channel.h"
+#include "offline_cache.h"
+#include "okvs_shard.h"
+#include "ot_extension.h"
+#include "segmented_okvs.h"
+#include "stream_pipeline.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "secure_primitives.h"
+
+using namespace osuCrypto;
+using namespace seal;
+
+// FHE 协议的 Sender（fpsi_sender_fhe 与 fpsi_bench 共用）：离线接收 OKVS 与打包密文库，
+// 在线对每个候选做同态阈值测试，收到逐查询匹配位后经 OT 输出匹配的查询
+class FPSISenderFixed {
+    // 在线阶段每个线程 / 信道的私有状态
+    struct OnlineWorker {
+        PRNG prng;
+        std::unique_ptr<PackedHammingEngine> hamming;
+        std::unique_ptr<CipherIO> io;
+        CommStats comm;
+        std::set<int> matched;
+        uint64_t tests = 0;         // 发送的阈值测试 / 不匹配密文数
+    };
+
+    // OKVS 解码出的候选：向量位于 packed_vectors_[cipher] 的第 group 组，cipher = -1 表示无效
+    struct PackedRef {
+        int32_t cipher;
+        int32_t group;
+    };
+    
+    // 一批连续查询 [begin, begin + count) 的候选：第 i 个 (查询, ID) 对的候选为
+    // candidates[offsets[i] .. offsets[i + 1])，i 从批首起算
+    struct CandidateBatch {
+        size_t begin = 0;
+        size_t count = 0;
+        std::vector<PackedRef> candidates;
+        std::vector<uint32_t> offsets;      // count × L + 1 个前缀偏移
+    };
+
+public:
+    // threads 为本端的线程预算（<= 0 时使用全部硬件线程）：离线线程池与在线信道数都取这个值，
+    // 在线阶段每个信道一个线程，线程池此时空闲，两者不会叠加
+    FPSISenderFixed(int m, int d, int delta, int L, int threads = 0)
+        : m_(m), d_(d), delta_(delta), L_(L) {
+        
+        prng_.SetSeed(block(123456, 789012));
+        pool_ = std::make_unique<ThreadPool>(threads);
+        online_threads_ = pool_->size();
+        elsh_ = std::make_unique<ELSHFmap>(d, delta, L);
+    }
+    
+    // SEAL 参数由 Receiver 在离线阶段开始时发送的方案决定
+    void receivePlan(Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        uint64_t degree = 0;
+        io.recv(degree);
+        io.recv(plan_.plain_modulus_bits);
+        io.recv(plan_.input_level);
+        plan_.poly_modulus_degree = static_cast<size_t>(degree);
+    }
+    
+    void initializeSEAL() {
+        context_ = std::make_shared<SEALContext>(plan_.parameters());
+        if (!context_->parameters_set()) {
+            throw std::runtime_error("Invalid BFV parameters from Receiver");
+        }
+        evaluator_ = std::make_unique<Evaluator>(*context_);
+        encoder_ = std::make_unique<BatchEncoder>(*context_);
+        hamming_ = std::make_unique<PackedHammingEngine>(context_, d_);
+        hamming_->setLevels(bfv_planner::levelParmsId(*context_, plan_.input_level),
+                            context_->last_parms_id());
+        cipher_io_ = std::make_unique<CipherIO>(context_, compression_);
+        
+        slot_count_ = encoder_->slot_count();
+        
+        std::cout << "Sender: SEAL 参数初始化完成" << std::endl;
+        std::cout << "  Poly modulus degree: " << plan_.poly_modulus_degree
+                  << ", plain modulus: " << plan_.plain_modulus_bits << " bits" << std::endl;
+        std::cout << "  Slot count: " << slot_count_
+                  << ", 离线密文层: " << plan_.input_level << std::endl;
+    }
+    
+    // 离线状态缓存目录，为空时每次都完整接收
+    void setCacheDir(const std::string& dir) { cache_ = OfflineCache(dir); }
+    
+    // 缓存键：Receiver 的缓存标识（状态 + 公钥）与本端 SEAL 参数、密文层共同决定，
+    // 参数不变时缓存的密文库、OKVS 与密钥可以继续在同一上下文中使用
+    block cacheKey(const block& token) const {
+        std::stringstream parms_stream;
+        context_->key_context_data()->parms().save(parms_stream);
+        
+        ContentHasher hasher;
+        hasher.updateValue(token);
+        hasher.update(parms_stream.str());
+        hasher.updateValue(plan_.input_level);
+        hasher.updateValue(d_);
+        hasher.updateValue(static_cast<uint64_t>(hamming_->recordsPerCiphertext()));
+        return hasher.final();
+    }
+    
+    // 本端发送密文时使用的压缩方式（SEAL 上下文在离线阶段才创建，届时生效）
+    void setCipherCompression(compr_mode_type compression) {
+        compression_ = compression;
+        std::cout << "Sender: 密文压缩方式 = " << CipherIO::compressionName(compression) << std::endl;
+    }
+    
+    void generateData() {
+        std::cout << "Sender: 生成 " << m_ << " 个 " << d_ << " 维向量..." << std::endl;
+        
+        Q_.resize(m_);
+        for (int i = 0; i < m_; ++i) {
+            Q_[i] = utils::generateRandomBinaryVector(d_, prng_);
+        }
+        
+        std::cout << "Sender: 数据生成完成" << std::endl;
+    }
+    
+    // 加载 fpsi_datagen 生成的数据集文件，行数即查询数 m
+    void loadData(const std::string& path) {
+        Q_ = dataset::readBytes(path, d_);
+        m_ = static_cast<int>(Q_.size());
+        
+        std::cout << "Sender: 已加载数据集 " << path << " (" << m_ << " 个向量)" << std::endl;
+    }
+    
+    // 流式模式下离线阶段不计算查询 ID、不解码候选，在线阶段按批计算并解码，
+    // 每批的阈值测试、匹配位与输出传输在下一批开始之前完成；Enc(0) 池也只按批补充
+    void setStreaming(const stream_pipeline::Options& options) {
+        stream_ = options;
+    }
+    
+    void runOffline(Channel& chl) {
+        std::cout << "\n========== Sender: 离线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        receivePlan(chl);
+        initializeSEAL();
+        
+        if (!stream_.enabled) {
+            std::cout << "Sender: 计算 E-LSH ID..." << std::endl;
+            ID_Q_ = elsh_->computeIDBatchFlat(Q_, pool_.get());
+            std::cout << "Sender: 生成了 " << ID_Q_.size() << " 个 ID" << std::endl;
+        }
+        
+        // Receiver 先发送缓存标识，全零表示对方未启用缓存
+        MeteredChannel io(chl, offline_comm_);
+        block token;
+        io.recv(token);
+        
+        bool has_token = token != block(0, 0);
+        block key = cacheKey(token);
+        bool warm = has_token && cache_.open(key);
+        io.send(static_cast<uint8_t>(warm ? 1 : 0));
+        
+        bool store = !warm && has_token && cache_.enabled();
+        if (store) {
+            cache_.begin();
+        }
+        
+        if (warm) {
+            loadCachedState();
+        } else {
+            receiveOKVS(chl, store);
+            receiveEncryptedVectorsBatched(chl, store);
+            receivePublicKey(chl, store);
+        }
+        
+        if (store) {
+            cache_.commit(key);
+            std::cout << "Sender: 离线状态已写入缓存 " << cache_.dir() << std::endl;
+        }
+        
+        decodeQueryIndices();
+        prepareOnlineConstants();
+        setupOT(chl);
+        
+        zero_pool_->wait();
+        std::cout << "Sender: 预计算 Enc(0) 池 " << zero_pool_->available() << " 个" << std::endl;
+        
+        timer.stop();
+        offline_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Sender: 离线阶段完成 - " << offline_time_ << " 秒" << std::endl;
+        offline_comm_.print("离线");
+    }
+    
+    // 为在线阶段的 m 次输出传输预先生成 OT 扩展相关性
+    void setupOT(Channel& chl) {
+        std::cout << "Sender: 生成 " << m_ << " 个 OT 扩展..." << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        io.send(m_);
+        
+        uint64_t sent = chl.getTotalDataSent();
+        uint64_t received = chl.getTotalDataRecv();
+        ot_sender_.setup(m_, chl, prng_);
+        io.countSent(chl.getTotalDataSent() - sent);
+        io.countReceived(chl.getTotalDataRecv() - received);
+    }
+    
+    // 热启动：OKVS、打包密文库与密钥全部从缓存读回，不再经过网络
+    void loadCachedState() {
+        std::cout << "Sender: 命中离线缓存 " << cache_.dir() << "，跳过 OKVS、密文与密钥接收" << std::endl;
+        
+        MappedFile file;
+        cache_.map("okvs", file);
+        ShardedOkvs base;
+        base.loadFlat(file.data(), file.size());
+        okvs_.setBase(std::move(base));
+        
+        cache_.map("packed_db", file);
+        packed_vectors_.clear();
+        const uint8_t* p = file.data();
+        const uint8_t* end = p + file.size();
+        while (p != end) {
+            uint64_t size;
+            if (static_cast<size_t>(end - p) < sizeof(uint64_t)) {
+                throw std::runtime_error("Truncated cached ciphertext database");
+            }
+            std::memcpy(&size, p, sizeof(uint64_t));
+            p += sizeof(uint64_t);
+            if (size > static_cast<uint64_t>(end - p)) {
+                throw std::runtime_error("Truncated cached ciphertext database");
+            }
+            cipher_io_->loadBatch(p, size, packed_vectors_);
+            p += size;
+        }
+        std::cout << "Sender: 从缓存加载了 " << packed_vectors_.size() << " 个打包密文" << std::endl;
+        
+        MappedFile pk_file, gk_file;
+        cache_.map("public_key", pk_file);
+        cache_.map("galois_keys", gk_file);
+        installKeys(pk_file, gk_file);
+    }
+    
+    void receiveOKVS(Channel& chl, bool store) {
+        std::cout << "Sender: 接收 OKVS..." << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        ShardedOkvs base;
+        io.countReceived(base.receive(io.raw()));
+        
+        std::cout << "Sender: OKVS 参数 - size=" << base.totalSize()
+                  << ", n_items=" << base.numItems() << ", " << base.numShards() << " 个分片" << std::endl;
+        
+        if (store) {
+            OfflineCache::Writer writer = cache_.create("okvs");
+            base.writeFlat([&](const void* data, size_t size) { writer.write(data, size); });
+            writer.close();
+        }
+        
+        okvs_.setBase(std::move(base));
+    }
+    
+    // 向 Receiver 报告本地已有的 (OKVS 代数, 段数, 数据库版本)，只拉取之后的变化：
+    // 新增的 OKVS 段、删除标记和改动过的密文，然后重新解码查询下标
+    void fetchUpdates(Channel& chl) {
+        std::cout << "\n========== Sender: 增量同步 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        CommStats comm;
+        MeteredChannel io(chl, comm);
+        
+        io.send(okvs_.generation());
+        io.send(static_cast<uint32_t>(okvs_.numSegments()));
+        io.send(db_version_);
+        
+        io.countReceived(okvs_.receiveUpdate(io.raw()));
+        
+        int num_ciphers;
+        io.recv(num_ciphers);
+        packed_vectors_.resize(num_ciphers);
+        
+        std::vector<uint32_t> tombstones;
+        receiveList(io, tombstones);
+        tombstones_.clear();
+        for (size_t k = 0; k + 1 < tombstones.size(); k += 2) {
+            tombstones_.push_back(packRef(tombstones[k], tombstones[k + 1]));
+        }
+        std::sort(tombstones_.begin(), tombstones_.end());
+        
+        std::vector<uint32_t> changed;
+        receiveList(io, changed);
+        
+        std::vector<Ciphertext> batch_ciphers;
+        size_t loaded = 0;
+        while (loaded < changed.size()) {
+            batch_ciphers.clear();
+            io.countReceived(cipher_io_->receiveBatch(io.raw(), batch_ciphers));
+            if (batch_ciphers.empty() || loaded + batch_ciphers.size() > changed.size()) {
+                throw std::runtime_error("Unexpected ciphertext count in update");
+            }
+            for (auto& cipher : batch_ciphers) {
+                if (changed[loaded] >= packed_vectors_.size()) {
+                    throw std::runtime_error("Updated ciphertext index out of range");
+                }
+                hamming_->toNTT(cipher);
+                packed_vectors_[changed[loaded++]] = std::move(cipher);
+            }
+        }
+        
+        io.recv(db_version_);
+        
+        decodeQueryIndices();
+        
+        timer.stop();
+        std::cout << "Sender: 同步到版本 " << db_version_ << " - OKVS 第 " << okvs_.generation()
+                  << " 代 " << okvs_.numSegments() << " 段, 更新 " << changed.size() << " 个密文, "
+                  << tombstones_.size() << " 个删除标记 (" << timer.getElapsedSeconds() << " 秒)"
+                  << std::endl;
+        comm.print("增量同步");
+        offline_comm_.merge(comm);
+    }
+    
+    // 与 sendList 对应：先收元素个数，非空时再收内容
+    static void receiveList(MeteredChannel& io, std::vector<uint32_t>& list) {
+        uint32_t count = 0;
+        io.recv(count);
+        list.clear();
+        if (count > 0) {
+            io.recv(list);
+            if (list.size() != count) {
+                throw std::runtime_error("Unexpected list length in update");
+            }
+        }
+    }
+    
+    static uint64_t packRef(uint32_t cipher, uint32_t group) {
+        return (static_cast<uint64_t>(cipher) << 32) | group;
+    }
+    
+    // 打包密文一次性转为 NTT 形式，常量掩码已在 setKeys 时编码为 NTT 明文，
+    // 在线阶段各线程只读共享
+    void prepareOnlineConstants() {
+        pool_->parallelFor(packed_vectors_.size(), 16, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                hamming_->toNTT(packed_vectors_[k]);
+            }
+        });
+    }
+    
+    // 非流式模式下离线解码全部 m 个查询的候选；流式模式推迟到在线阶段按批解码
+    void decodeQueryIndices() {
+        if (stream_.enabled) {
+            return;
+        }
+        decodeCandidates(ID_Q_.data(), 0, m_, all_candidates_);
+        reserveZeros(all_candidates_.candidates.size());
+    }
+    
+    // 对一批查询的全部 (查询, ID) 对批量解码出候选记录 (密文下标, 组号)。共享一个 ID 的 c 条记录
+    // 编码在 (ID, 0..c-1) 键下，序号 0 的值同时带着 c：先解码全部序号 0，再一次解码其余序号。
+    // 没有段的校验标签吻合、越界或落在已删除槽位的候选被丢弃，没有候选的 ID 保留一个
+    // cipher = -1 的占位（在线阶段发送不匹配密文），所以每个 ID 至少一个测试
+    void decodeCandidates(const ELSHFmap::ID* ids, size_t begin, size_t count, CandidateBatch& batch) {
+        std::vector<block> keys(count * L_);
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            keys[idx] = ELSHFmap::okvsKey(ids[idx]);
+        }
+        
+        std::vector<block> decoded(keys.size());
+        std::vector<uint8_t> found(keys.size());
+        okvs_.decodeBatch(keys.data(), keys.size(), decoded.data(), found.data(), pool_.get());
+        
+        // ID 的候选数放在值的低 64 位的高 32 位，不能超过 Receiver 的记录总数
+        uint64_t max_group = hamming_->recordsPerCiphertext();
+        uint64_t max_count = packed_vectors_.size() * max_group;
+        std::vector<uint32_t> counts(keys.size(), 0);
+        std::vector<block> extra_keys;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            uint64_t bucket_size = decoded[i].get<uint64_t>(0) >> 32;
+            if (!found[i] || bucket_size == 0 || bucket_size > max_count) {
+                continue;
+            }
+            counts[i] = static_cast<uint32_t>(bucket_size);
+            for (uint32_t t = 1; t < counts[i]; ++t) {
+                extra_keys.push_back(ELSHFmap::okvsKey(ids[i], t));
+            }
+        }
+        
+        std::vector<block> extra_decoded(extra_keys.size());
+        std::vector<uint8_t> extra_found(extra_keys.size());
+        okvs_.decodeBatch(extra_keys.data(), extra_keys.size(), extra_decoded.data(), extra_found.data(),
+                          pool_.get());
+        
+        batch.begin = begin;
+        batch.count = count;
+        std::vector<PackedRef>& candidates = batch.candidates;
+        candidates.clear();
+        batch.offsets.assign(1, 0);
+        size_t next_extra = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            size_t first = candidates.size();
+            for (uint32_t t = 0; t < counts[i]; ++t) {
+                const block& value = t == 0 ? decoded[i] : extra_decoded[next_extra];
+                bool ok = t == 0 || extra_found[next_extra];
+                next_extra += t > 0;
+                
+                uint64_t cipher = value.get<uint64_t>(0) & 0xffffffffULL;
+                uint64_t group = value.get<uint64_t>(1) & 0xffffffffULL;
+                if (ok && cipher < packed_vectors_.size() && group < max_group &&
+                    !std::binary_search(tombstones_.begin(), tombstones_.end(), packRef(cipher, group))) {
+                    candidates.push_back({static_cast<int32_t>(cipher), static_cast<int32_t>(group)});
+                }
+            }
+            if (candidates.size() == first) {
+                candidates.push_back({-1, 0});
+            }
+            batch.offsets.push_back(static_cast<uint32_t>(candidates.size()));
+        }
+        
+        if (!stream_.enabled) {
+            std::cout << "Sender: 批量解码了 " << keys.size() + extra_keys.size() << " 个 OKVS 键, "
+                      << candidates.size() << " 个候选" << std::endl;
+        }
+    }
+    
+    // 每个候选消耗一个 Enc(0)：累计需要的数量超过已安排生成的数量时在后台补充
+    void reserveZeros(size_t total) {
+        if (total > zero_pool_target_) {
+            zero_pool_->startFill(total - zero_pool_target_, zero_pool_threads_);
+            zero_pool_target_ = total;
+        }
+    }
+    
+    void receiveEncryptedVectorsBatched(Channel& chl, bool store) {
+        std::cout << "Sender: 分批接收加密向量..." << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        int num_ciphers;
+        io.recv(num_ciphers);
+        
+        packed_vectors_.resize(num_ciphers);
+        
+        std::cout << "Sender: Receiver 打包密文数: " << num_ciphers << std::endl;
+        
+        const int BATCH_SIZE = 16;
+        int num_batches = (num_ciphers + BATCH_SIZE - 1) / BATCH_SIZE;
+        
+        // 收到的帧原样写入缓存：[u64 帧长][帧]...
+        std::unique_ptr<OfflineCache::Writer> db_writer;
+        if (store) {
+            db_writer = std::make_unique<OfflineCache::Writer>(cache_.create("packed_db"));
+        }
+        
+        for (int batch = 0; batch < num_batches; ++batch) {
+            int batch_start = batch * BATCH_SIZE;
+            int batch_end = std::min(batch_start + BATCH_SIZE, num_ciphers);
+            
+            std::cout << "Sender: 接收批次 " << (batch + 1) << "/" << num_batches << std::endl;
+            
+            io.countReceived(cipher_io_->receiveBatch(
+                io.raw(), packed_vectors_.data() + batch_start, batch_end - batch_start));
+            
+            if (db_writer) {
+                const std::vector<uint8_t>& frame = cipher_io_->lastFrame();
+                db_writer->writeValue(static_cast<uint64_t>(frame.size()));
+                db_writer->write(frame.data(), frame.size());
+            }
+            
+            // 返回一个信用，Receiver 据此推进发送窗口
+            io.send(static_cast<uint32_t>(batch));
+        }
+        
+        if (db_writer) {
+            db_writer->close();
+        }
+        
+        std::cout << "Sender: 接收了 " << num_ciphers << " 个打包密文" << std::endl;
+    }
+    
+    void receivePublicKey(Channel& chl, bool store) {
+        std::cout << "Sender: 接收公钥..." << std::endl;
+        
+        MeteredChannel io(chl, offline_comm_);
+        std::string pk_str;
+        io.recv(pk_str);
+        
+        std::string gk_str;
+        io.recv(gk_str);
+        
+        if (store) {
+            cache_.put("public_key", pk_str);
+            cache_.put("galois_keys", gk_str);
+        }
+        
+        installKeys(reinterpret_cast<const seal_byte*>(pk_str.data()), pk_str.size(),
+                    reinterpret_cast<const seal_byte*>(gk_str.data()), gk_str.size());
+    }
+    
+    void installKeys(const MappedFile& pk, const MappedFile& gk) {
+        installKeys(reinterpret_cast<const seal_byte*>(pk.data()), pk.size(),
+                    reinterpret_cast<const seal_byte*>(gk.data()), gk.size());
+    }
+    
+    void installKeys(const seal_byte* pk, size_t pk_size, const seal_byte* gk, size_t gk_size) {
+        public_key_.load(*context_, pk, pk_size);
+        encryptor_ = std::make_unique<Encryptor>(*context_, public_key_);
+        
+        auto galois_keys = std::make_shared<GaloisKeys>();
+        galois_keys->load(*context_, gk, gk_size);
+        galois_keys_ = galois_keys;
+        
+        hamming_->setKeys(public_key_, galois_keys_);
+        
+        std::cout << "Sender: 公钥和 Galois 密钥加载完成" << std::endl;
+        
+        // 在线阶段每个候选需要一个 Enc(0)，在离线的剩余步骤中后台生成
+        zero_pool_ = std::make_shared<EncryptedZeroPool>(context_, public_key_,
+                                                         hamming_->inputParmsId());
+        // 流式模式先准备首批的量，其余随各批解码补充
+        size_t first_queries = stream_.enabled ? std::min<size_t>(m_, stream_.batch_queries) : m_;
+        zero_pool_target_ = first_queries * L_;
+        zero_pool_->startFill(zero_pool_target_, zero_pool_threads_);
+        hamming_->setZeroPool(zero_pool_);
+    }
+    
+    // 离线生成 Enc(0) 池的后台线程数
+    void setZeroPoolThreads(int threads) { zero_pool_threads_ = std::max(threads, 1); }
+    
+    void runOnline(Session& session, Channel& chl) {
+        std::cout << "\n========== Sender: 在线阶段开始 ==========" << std::endl;
+        
+        Timer timer;
+        timer.start();
+        
+        // 查询数之后发送每批的查询数：非流式时整个查询集为一批
+        int batch_queries = stream_.enabled ? std::max(1, std::min(stream_.batch_queries, m_)) : m_;
+        MeteredChannel io(chl, online_comm_);
+        io.send(m_);
+        io.send(batch_queries);
+        
+        // 每个线程一个信道，每批查询按连续区间划分；open 在主信道上交换一次线程数
+        std::vector<Channel> channels = multi_channel::open(session, chl, online_threads_);
+        int num_threads = static_cast<int>(channels.size());
+        io.countSent(sizeof(uint32_t));
+        io.countReceived(sizeof(uint32_t));
+        
+        std::cout << "Sender: 处理 " << m_ << " 个查询 (" << num_threads << " 个信道";
+        if (stream_.enabled) {
+            std::cout << ", 流式每批 " << batch_queries << " 个, 缓冲 " << stream_.depth << " 批";
+        }
+        std::cout << ")..." << std::endl;
+        
+        // 每个线程独立的 PRNG、同态引擎（Evaluator / Encryptor）、收发缓冲与统计
+        std::vector<OnlineWorker> workers(num_threads);
+        for (auto& worker : workers) {
+            worker.prng.SetSeed(prng_.get<block>());
+            worker.hamming = std::make_unique<PackedHammingEngine>(context_, d_);
+            worker.hamming->setLevels(hamming_->inputParmsId(), hamming_->outputParmsId());
+            worker.hamming->setConstants(hamming_->constants());
+            worker.hamming->setKeys(public_key_, galois_keys_);
+            worker.hamming->setZeroPool(zero_pool_);
+            worker.io = std::make_unique<CipherIO>(context_, cipher_io_->compression());
+        }
+        
+        auto serveBatch = [&](const CandidateBatch& batch) {
+            multi_channel::run(channels, [&](int t, Channel& c) {
+                int begin, end;
+                multi_channel::splitRange(static_cast<int>(batch.count), num_threads, t, begin, end);
+                serveRange(workers[t], c, batch, static_cast<int>(batch.begin) + begin,
+                           static_cast<int>(batch.begin) + end);
+            });
+        };
+        
+        if (stream_.enabled) {
+            runStreamingBatches(batch_queries, timer, serveBatch);
+        } else {
+            serveBatch(all_candidates_);
+        }
+        
+        size_t pool_peak = 0;
+        uint64_t tests = 0;
+        for (const auto& worker : workers) {
+            pool_peak = std::max(pool_peak, worker.hamming->memoryPoolBytes());
+            online_comm_.merge(worker.comm);
+            matched_queries_.insert(worker.matched.begin(), worker.matched.end());
+            tests += worker.tests;
+        }
+        modswitch_saved_bytes_ = tests * outputSavingPerCipher();
+        
+        timer.stop();
+        online_time_ = timer.getElapsedSeconds();
+        
+        std::cout << "Sender: 在线阶段完成 - " << online_time_ << " 秒"
+                  << " (Enc(0) 池未命中 " << zero_pool_->misses() << " 次, 单线程内存池峰值 "
+                  << pool_peak / (1024.0 * 1024.0) << " MB)" << std::endl;
+        std::cout << "Sender: 模切换节省 " << modswitch_saved_bytes_ / (1024.0 * 1024.0)
+                  << " MB (" << tests << " 个测试密文)" << std::endl;
+        online_comm_.print("在线");
+    }
+    
+    // 一个信道上的一段查询 [begin, end)（位于 batch 内）：先发每个查询的测试数，之后全部阈值测试
+    // 每 TEST_FRAME_TESTS 个一帧连续发出不等回应；Receiver 解密完整段后只回一条按位打包的
+    // 逐查询匹配位，再把整段的输出传输合并为一轮
+    void serveRange(OnlineWorker& worker, Channel& c, const CandidateBatch& batch, int begin, int end) {
+        if (begin == end) {
+            return;
+        }
+        MeteredChannel worker_io(c, worker.comm);
+        auto offset = [&](int j) { return batch.offsets[static_cast<size_t>(j - batch.begin) * L_]; };
+        
+        std::vector<uint32_t> test_counts(end - begin);
+        for (int j = begin; j < end; ++j) {
+            test_counts[j - begin] = offset(j + 1) - offset(j);
+        }
+        worker_io.send(test_counts);
+        
+        std::vector<Ciphertext> tests;
+        size_t end_test = offset(end);
+        int query = begin;
+        int next_report = 100;
+        for (size_t frame_begin = offset(begin); frame_begin < end_test; frame_begin += TEST_FRAME_TESTS) {
+            size_t frame_end = std::min(frame_begin + TEST_FRAME_TESTS, end_test);
+            tests.resize(frame_end - frame_begin);
+            for (size_t k = frame_begin; k < frame_end; ++k) {
+                while (offset(query + 1) <= k) {
+                    ++query;
+                }
+                processCandidate(query, batch.candidates[k], worker, tests[k - frame_begin]);
+            }
+            worker_io.countSent(worker.io->sendBatch(worker_io.raw(), tests));
+            
+            if (!stream_.enabled && begin == 0 && query - begin >= next_report) {
+                std::cout << "Sender: 进度 " << (query - begin) << "/" << (end - begin)
+                          << " (线程 0)" << std::endl;
+                next_report += 100;
+            }
+        }
+        
+        uint64_t match_received = c.getTotalDataRecv();
+        std::vector<uint8_t> has_match = PrivateEqualityTest::receiveAnyOneBatch(end - begin, c);
+        worker_io.countReceived(c.getTotalDataRecv() - match_received);
+        
+        // 匹配时 Receiver 选到 q_j，否则得到全零
+        std::vector<std::vector<uint8_t>> null_msgs(end - begin, std::vector<uint8_t>(d_, 0));
+        std::vector<std::vector<uint8_t>> query_msgs(Q_.begin() + begin, Q_.begin() + end);
+        uint64_t sent = 0, received = 0;
+        ot_sender_.sendBatch(begin, null_msgs, query_msgs, d_, c, &sent, &received);
+        worker_io.countSent(sent);
+        worker_io.countReceived(received);
+        
+        for (int j = begin; j < end; ++j) {
+            if (has_match[j - begin]) {
+                worker.matched.insert(j);
+            }
+        }
+    }
+    
+    // 流式在线阶段：后台线程按批计算 E-LSH ID、解码候选并补充 Enc(0) 池，主线程逐批完成
+    // 阈值测试、匹配位与输出传输。两阶段之间循环使用 depth 个批次缓冲区，候选与 Enc(0)
+    // 只保留约 depth + 1 批，与 m 无关。后台阶段使用线程池，在线信道各用自己的线程
+    void runStreamingBatches(int batch_queries, Timer& timer,
+                             const std::function<void(const CandidateBatch&)>& serveBatch) {
+        BoundedQueue<std::unique_ptr<CandidateBatch>> free_batches(stream_.depth);
+        BoundedQueue<std::unique_ptr<CandidateBatch>> ready_batches(stream_.depth);
+        for (int i = 0; i < stream_.depth; ++i) {
+            free_batches.push(std::make_unique<CandidateBatch>());
+        }
+        
+        std::exception_ptr producer_error;
+        std::thread producer([&]() {
+            try {
+                std::unique_ptr<CandidateBatch> batch;
+                size_t reserved = 0;
+                for (int begin = 0; begin < m_; begin += batch_queries) {
+                    if (!free_batches.pop(batch)) {
+                        break;
+                    }
+                    int count = std::min(batch_queries, m_ - begin);
+                    BitMatrix rows(count, d_);
+                    for (int i = 0; i < count; ++i) {
+                        rows.setRow(i, Q_[begin + i]);
+                    }
+                    std::vector<ELSHFmap::ID> ids = elsh_->computeIDBatchFlat(rows, *pool_);
+                    decodeCandidates(ids.data(), begin, count, *batch);
+                    
+                    reserved += batch->candidates.size();
+                    reserveZeros(reserved);
+                    if (!ready_batches.push(std::move(batch))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                producer_error = std::current_exception();
+            }
+            ready_batches.close();
+        });
+        
+        int batches_done = 0;
+        try {
+            std::unique_ptr<CandidateBatch> batch;
+            while (ready_batches.pop(batch)) {
+                serveBatch(*batch);
+                
+                if (batches_done++ == 0) {
+                    std::cout << "Sender: 首批结果已完成 (" << timer.getElapsedSecondsSoFar()
+                              << " 秒)" << std::endl;
+                }
+                std::cout << "Sender: 流式进度 " << batch->begin + batch->count << "/" << m_ << std::endl;
+                free_batches.push(std::move(batch));
+            }
+        } catch (...) {
+            free_batches.close();
+            ready_batches.close();
+            producer.join();
+            throw;
+        }
+        
+        producer.join();
+        if (producer_error) {
+            std::rethrow_exception(producer_error);
+        }
+    }
+    
+    // 一个测试密文在输出层比在输入层少的字节数（未压缩）
+    uint64_t outputSavingPerCipher() const {
+        Ciphertext probe;
+        encryptor_->encrypt_zero(hamming_->inputParmsId(), probe);
+        size_t full = probe.save_size(compr_mode_type::none);
+        if (hamming_->outputParmsId() != hamming_->inputParmsId()) {
+            evaluator_->mod_switch_to_inplace(probe, hamming_->outputParmsId());
+        }
+        return full - probe.save_size(compr_mode_type::none);
+    }
+    
+    // 为查询 j 的一个候选生成阈值零测试密文
+    void processCandidate(int j, const PackedRef& ref, OnlineWorker& worker, Ciphertext& test) {
+        // 下标无效说明这个 ID 不在 Receiver 的数据集中，发送不可区分的不匹配密文
+        test = ref.cipher < 0
+            ? worker.hamming->nonMatch(worker.prng)
+            : worker.hamming->thresholdTest(packed_vectors_[ref.cipher], Q_[j], delta_,
+                                            worker.prng, ref.group);
+        ++worker.tests;
+    }
+    
+    void receiveCiphertext(Ciphertext& cipher, Channel& chl) {
+        MeteredChannel io(chl, offline_comm_);
+        io.countReceived(cipher_io_->receive(io.raw(), cipher));
+    }
+    
+    double offlineTime() const { return offline_time_; }
+    double onlineTime() const { return online_time_; }
+    const CommStats& offlineComm() const { return offline_comm_; }
+    const CommStats& onlineComm() const { return online_comm_; }
+    
+    void printStatistics() {
+        std::cout << "\n========================================" << std::endl;
+        std::cout << "Sender 协议统计" << std::endl;
+        std::cout << "========================================" << std::endl;
+        std::cout << "参数: m=" << m_ << ", d=" << d_ 
+                  << ", δ=" << delta_ << ", L=" << L_ << std::endl;
+        std::cout << "匹配查询数: " << matched_queries_.size() << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "离线阶段: " << offline_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << offline_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "在线阶段: " << online_time_ << " 秒" << std::endl;
+        std::cout << "  通信: " << online_comm_.getTotalMegabytes() << " MB" << std::endl;
+        std::cout << "  模切换节省: " << modswitch_saved_bytes_ / (1024.0 * 1024.0) << " MB" << std::endl;
+        std::cout << std::endl;
+        
+        std::cout << "总计: " << (offline_time_ + online_time_) << " 秒" << std::endl;
+        std::cout << "  通信: " << (offline_comm_.getTotalMegabytes() + 
+                     online_comm_.getTotalMegabytes()) << " MB" << std::endl;
+        std::cout << "========================================" << std::endl;
+    }
+
+private:
+    // 在线阶段每帧包含的阈值测试密文数，限制单帧内存
+    static constexpr size_t TEST_FRAME_TESTS = 64;
+    
+    int m_, d_, delta_, L_;
+    BfvPlan plan_;
+    compr_mode_type compression_ = compr_mode_type::none;
+    size_t slot_count_;
+    
+    PRNG prng_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<ELSHFmap> elsh_;
+    
+    std::shared_ptr<SEALContext> context_;
+    std::unique_ptr<Encryptor> encryptor_;
+    std::unique_ptr<Evaluator> evaluator_;
+    std::unique_ptr<BatchEncoder> encoder_;
+    std::unique_ptr<PackedHammingEngine> hamming_;
+    std::unique_ptr<CipherIO> cipher_io_;
+    BatchOTSender ot_sender_;
+    PublicKey public_key_;
+    std::shared_ptr<const GaloisKeys> galois_keys_;
+    std::shared_ptr<EncryptedZeroPool> zero_pool_;
+    int zero_pool_threads_ = 2;
+    size_t zero_pool_target_ = 0;          // 已安排生成的 Enc(0) 总数
+    
+    int online_threads_ = 1;
+    
+    std::vector<std::vector<uint8_t>> Q_;
+    std::vector<ELSHFmap::ID> ID_Q_;        // m × L 个 ID，按查询连续存放
+    
+    SegmentedOkvs okvs_;                    // Receiver 的基础段与增量同步得到的 delta 段
+    std::vector<uint64_t> tombstones_;      // 已删除槽位 packRef(cipher, group)，有序
+    uint64_t db_version_ = 0;               // 已同步到的 Receiver 数据库版本
+    OfflineCache cache_;
+    
+    CandidateBatch all_candidates_;         // 非流式模式下全部 m 个查询的候选
+    stream_pipeline::Options stream_;
+    
+    std::vector<Ciphertext> packed_vectors_;
+    
+    std::set<int> matched_queries_;
+    uint64_t modswitch_saved_bytes_ = 0;
+    
+    double offline_time_ = 0.0;
+    double online_time_ = 0.0;
+    CommStats offline_comm_;
+    CommStats online_comm_;
+};
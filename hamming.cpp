@@ -0,0 +1,393 @@
+#include "hamming.h"
+#include "fixed_shape.h"
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FPSI_X86 1
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define FPSI_NEON 1
+#endif
+
+namespace utils {
+
+namespace {
+
+// 单行内核：popcount(a ^ b)
+using RowKernel = uint32_t (*)(const uint64_t*, const uint64_t*, int);
+
+// 批量内核：query 对连续存放的 n 行逐行计算距离
+using BatchKernel = void (*)(const uint64_t*, const uint64_t*, size_t, int, uint32_t*);
+
+// 按字数选择固定形状批量内核，不支持的字数返回 nullptr
+using FixedSelector = BatchKernel (*)(int);
+
+struct KernelTable {
+    const char* name;
+    RowKernel row;
+    BatchKernel batch;
+    FixedSelector fixed = nullptr;
+
+    BatchKernel batchFor(int words) const {
+        BatchKernel k = fixed ? fixed(words) : nullptr;
+        return k ? k : batch;
+    }
+};
+
+// ---------- 标量实现 ----------
+
+inline uint32_t rowScalar(const uint64_t* a, const uint64_t* b, int words) {
+    uint32_t dist = 0;
+    for (int w = 0; w < words; ++w) {
+        dist += std::popcount(a[w] ^ b[w]);
+    }
+    return dist;
+}
+
+void batchScalar(const uint64_t* q, const uint64_t* rows, size_t n, int words,
+                 uint32_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rowScalar(q, rows + i * words, words);
+    }
+}
+
+// 固定字数（d = 128/256/512/1024）：查询放进定长数组，每行的 popcount 在编译期展开
+template<int W>
+struct BatchScalarFixed {
+    static void run(const uint64_t* q, const uint64_t* rows, size_t n, int, uint32_t* out) {
+        std::array<uint64_t, W> query;
+        std::copy(q, q + W, query.begin());
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = fixed_shape::hammingDistance<W>(query.data(), rows + i * W);
+        }
+    }
+};
+
+BatchKernel fixedScalar(int words) {
+    return fixed_shape::selectWords<BatchScalarFixed>(words);
+}
+
+#ifdef FPSI_X86
+
+// ---------- AVX2 实现（查表法 popcount） ----------
+
+__attribute__((target("avx2")))
+inline __m256i popcount256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                  _mm256_shuffle_epi8(lookup, hi));
+
+    // 每 8 字节求和，得到 4 个 64 位计数
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2,popcnt")))
+uint32_t rowAvx2(const uint64_t* a, const uint64_t* b, int words) {
+    __m256i acc = _mm256_setzero_si256();
+    int w = 0;
+
+    for (; w + 4 <= words; w += 4) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w));
+        acc = _mm256_add_epi64(acc, popcount256(_mm256_xor_si256(va, vb)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    uint64_t dist = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; w < words; ++w) {
+        dist += _mm_popcnt_u64(a[w] ^ b[w]);
+    }
+
+    return static_cast<uint32_t>(dist);
+}
+
+__attribute__((target("avx2,popcnt")))
+void batchAvx2(const uint64_t* q, const uint64_t* rows, size_t n, int words,
+               uint32_t* out) {
+    if (words < 4) {
+        // d <= 192 时一行不足一个 256 位寄存器，硬件 popcnt 更快
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t* r = rows + i * words;
+            uint64_t dist = 0;
+            for (int w = 0; w < words; ++w) {
+                dist += _mm_popcnt_u64(q[w] ^ r[w]);
+            }
+            out[i] = static_cast<uint32_t>(dist);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rowAvx2(q, rows + i * words, words);
+    }
+}
+
+// 固定字数：W <= 4 时逐字硬件 popcnt；W >= 8 时查询常驻 W / 4 个寄存器
+template<int W>
+struct BatchAvx2Fixed {
+    __attribute__((target("avx2,popcnt")))
+    static void run(const uint64_t* q, const uint64_t* rows, size_t n, int, uint32_t* out) {
+        if constexpr (W <= 4) {
+            std::array<uint64_t, W> query;
+            std::copy(q, q + W, query.begin());
+            for (size_t i = 0; i < n; ++i) {
+                const uint64_t* r = rows + i * W;
+                uint64_t dist = 0;
+                for (int w = 0; w < W; ++w) {
+                    dist += _mm_popcnt_u64(query[w] ^ r[w]);
+                }
+                out[i] = static_cast<uint32_t>(dist);
+            }
+        } else {
+            constexpr int R = W / 4;
+            __m256i vq[R];
+            for (int k = 0; k < R; ++k) {
+                vq[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 4 * k));
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const uint64_t* r = rows + i * W;
+                __m256i acc = _mm256_setzero_si256();
+                for (int k = 0; k < R; ++k) {
+                    __m256i vr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + 4 * k));
+                    acc = _mm256_add_epi64(acc, popcount256(_mm256_xor_si256(vq[k], vr)));
+                }
+                uint64_t lanes[4];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+                out[i] = static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+            }
+        }
+    }
+};
+
+BatchKernel fixedAvx2(int words) {
+    return fixed_shape::selectWords<BatchAvx2Fixed>(words);
+}
+
+// ---------- AVX-512 VPOPCNTDQ 实现 ----------
+
+__attribute__((target("avx512f")))
+inline uint64_t reduceAdd512(__m512i v) {
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+uint32_t rowAvx512(const uint64_t* a, const uint64_t* b, int words) {
+    __m512i acc = _mm512_setzero_si512();
+    int w = 0;
+
+    for (; w + 8 <= words; w += 8) {
+        __m512i va = _mm512_loadu_si512(a + w);
+        __m512i vb = _mm512_loadu_si512(b + w);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(va, vb)));
+    }
+
+    if (w < words) {
+        __mmask8 tail = static_cast<__mmask8>((1u << (words - w)) - 1);
+        __m512i va = _mm512_maskz_loadu_epi64(tail, a + w);
+        __m512i vb = _mm512_maskz_loadu_epi64(tail, b + w);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(va, vb)));
+    }
+
+    return static_cast<uint32_t>(reduceAdd512(acc));
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+void batchAvx512(const uint64_t* q, const uint64_t* rows, size_t n, int words,
+                 uint32_t* out) {
+    if (words <= 8) {
+        // 查询只加载一次，每行一次掩码加载
+        __mmask8 tail = static_cast<__mmask8>((1u << words) - 1);
+        __m512i vq = _mm512_maskz_loadu_epi64(tail, q);
+
+        for (size_t i = 0; i < n; ++i) {
+            __m512i vr = _mm512_maskz_loadu_epi64(tail, rows + i * words);
+            __m512i cnt = _mm512_popcnt_epi64(_mm512_xor_si512(vq, vr));
+            out[i] = static_cast<uint32_t>(reduceAdd512(cnt));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rowAvx512(q, rows + i * words, words);
+    }
+}
+
+// 固定字数：W >= 8 时查询常驻 W / 8 个寄存器，无需掩码加载；W < 8 时通用版本已是单次掩码加载
+template<int W>
+struct BatchAvx512Fixed {
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static void run(const uint64_t* q, const uint64_t* rows, size_t n, int words, uint32_t* out) {
+        if constexpr (W < 8) {
+            batchAvx512(q, rows, n, words, out);
+        } else {
+            constexpr int R = W / 8;
+            __m512i vq[R];
+            for (int k = 0; k < R; ++k) {
+                vq[k] = _mm512_loadu_si512(q + 8 * k);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const uint64_t* r = rows + i * W;
+                __m512i acc = _mm512_setzero_si512();
+                for (int k = 0; k < R; ++k) {
+                    __m512i vr = _mm512_loadu_si512(r + 8 * k);
+                    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(vq[k], vr)));
+                }
+                out[i] = static_cast<uint32_t>(reduceAdd512(acc));
+            }
+        }
+    }
+};
+
+BatchKernel fixedAvx512(int words) {
+    return fixed_shape::selectWords<BatchAvx512Fixed>(words);
+}
+
+#endif // FPSI_X86
+
+#ifdef FPSI_NEON
+
+// ---------- NEON 实现 ----------
+
+uint32_t rowNeon(const uint64_t* a, const uint64_t* b, int words) {
+    uint64x2_t acc = vdupq_n_u64(0);
+    int w = 0;
+
+    for (; w + 2 <= words; w += 2) {
+        uint8x16_t x = veorq_u8(vreinterpretq_u8_u64(vld1q_u64(a + w)),
+                                vreinterpretq_u8_u64(vld1q_u64(b + w)));
+        acc = vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(vcntq_u8(x))));
+    }
+
+    uint64_t dist = vaddvq_u64(acc);
+    for (; w < words; ++w) {
+        dist += std::popcount(a[w] ^ b[w]);
+    }
+
+    return static_cast<uint32_t>(dist);
+}
+
+void batchNeon(const uint64_t* q, const uint64_t* rows, size_t n, int words,
+               uint32_t* out) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = rowNeon(q, rows + i * words, words);
+    }
+}
+
+#endif // FPSI_NEON
+
+const KernelTable kScalar{"scalar", rowScalar, batchScalar, fixedScalar};
+
+KernelTable selectKernel() {
+    const char* forced = std::getenv("FPSI_HAMMING_KERNEL");
+    std::string want = forced ? forced : "";
+
+    if (want == "scalar") {
+        return kScalar;
+    }
+
+#ifdef FPSI_X86
+    __builtin_cpu_init();
+    bool has_avx512 = __builtin_cpu_supports("avx512f") &&
+                      __builtin_cpu_supports("avx512vpopcntdq");
+    bool has_avx2 = __builtin_cpu_supports("avx2") &&
+                    __builtin_cpu_supports("popcnt");
+
+    if (has_avx512 && (want.empty() || want == "avx512")) {
+        return {"avx512-vpopcntdq", rowAvx512, batchAvx512, fixedAvx512};
+    }
+    if (has_avx2 && (want.empty() || want == "avx2" || want == "avx512")) {
+        return {"avx2", rowAvx2, batchAvx2, fixedAvx2};
+    }
+#endif
+
+#ifdef FPSI_NEON
+    return {"neon", rowNeon, batchNeon};
+#endif
+
+    return kScalar;
+}
+
+const KernelTable& kernel() {
+    static const KernelTable table = selectKernel();
+    return table;
+}
+
+} // namespace
+
+uint32_t hammingDistanceWords(const uint64_t* a, const uint64_t* b, int words) {
+    return kernel().row(a, b, words);
+}
+
+void hammingDistanceBatch(const BitView& query,
+                          const BitMatrixView& rows,
+                          uint32_t* distances) {
+    kernel().batchFor(rows.words_per_row)(query.words, rows.data, rows.rows, rows.words_per_row,
+                                          distances);
+}
+
+std::vector<uint32_t> hammingDistanceBatch(const BitView& query,
+                                           const BitMatrixView& rows) {
+    std::vector<uint32_t> distances(rows.rows);
+    hammingDistanceBatch(query, rows, distances.data());
+    return distances;
+}
+
+size_t hammingThresholdBatch(const BitView& query,
+                             const BitMatrixView& rows,
+                             int delta,
+                             uint64_t* bitmap) {
+    const int words = rows.words_per_row;
+    const BatchKernel batch = kernel().batchFor(words);
+    size_t hits = 0;
+
+    // 每次处理 64 行，距离放在栈上，直接组装一个位图字
+    uint32_t dist[64];
+    uint32_t limit = static_cast<uint32_t>(std::max(delta, -1) + 1);
+    for (size_t base = 0; base < rows.rows; base += 64) {
+        size_t count = std::min<size_t>(64, rows.rows - base);
+        batch(query.words, rows.data + base * words, count, words, dist);
+
+        uint64_t bits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bits |= static_cast<uint64_t>(dist[i] < limit) << i;
+        }
+
+        bitmap[base / 64] = bits;
+        hits += std::popcount(bits);
+    }
+
+    return hits;
+}
+
+std::vector<uint64_t> hammingThresholdBatch(const BitView& query,
+                                            const BitMatrixView& rows,
+                                            int delta) {
+    std::vector<uint64_t> bitmap((rows.rows + 63) / 64, 0);
+    hammingThresholdBatch(query, rows, delta, bitmap.data());
+    return bitmap;
+}
+
+const char* hammingKernelName() {
+    return kernel().name;
+}
+
+} // namespace utils
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "bit_vector.h"
+
+// Hamming 距离计算内核（XOR + popcount）
+// 运行时根据 CPU 特性选择 AVX-512 VPOPCNTDQ / AVX2 / NEON / 标量实现，
+// 可通过环境变量 FPSI_HAMMING_KERNEL=scalar|avx2|avx512|neon 强制指定。
+namespace utils {
+
+    // 计算 popcount(a ^ b)，a 和 b 各有 words 个 64 位字
+    uint32_t hammingDistanceWords(const uint64_t* a, const uint64_t* b, int words);
+
+    // 一个查询对多行：distances[i] = HD(query, rows.row(i))
+    void hammingDistanceBatch(const BitView& query,
+                              const BitMatrixView& rows,
+                              uint32_t* distances);
+
+    std::vector<uint32_t> hammingDistanceBatch(const BitView& query,
+                                               const BitMatrixView& rows);
+
+    // 一个查询对多行的阈值位图：第 i 位为 1 当且仅当 HD(query, rows.row(i)) <= delta
+    // bitmap 需要有 (rows.rows + 63) / 64 个字，返回命中的行数
+    size_t hammingThresholdBatch(const BitView& query,
+                                 const BitMatrixView& rows,
+                                 int delta,
+                                 uint64_t* bitmap);
+
+    std::vector<uint64_t> hammingThresholdBatch(const BitView& query,
+                                                const BitMatrixView& rows,
+                                                int delta);
+
+    // 当前选中的内核名称（用于日志和基准测试）
+    const char* hammingKernelName();
+}
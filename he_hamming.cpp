@@ -0,0 +1,303 @@
+#include "he_hamming.h"
+#include "metrics.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+PackedHammingEngine::PackedHammingEngine(std::shared_ptr<SEALContext> context, int d)
+    : context_(context), pool_(MemoryPoolHandle::New()), d_(d), block_(blockSize(d)) {
+
+    evaluator_ = std::make_unique<Evaluator>(*context_);
+    encoder_ = std::make_unique<BatchEncoder>(*context_);
+    slot_count_ = encoder_->slot_count();
+    plain_modulus_ = context_->first_context_data()->parms().plain_modulus().value();
+    input_parms_id_ = context_->first_parms_id();
+    output_parms_id_ = context_->first_parms_id();
+
+    // rotate_rows 只在每行 slot_count/2 个槽位内循环移位，块不能跨行
+    if (static_cast<size_t>(block_) > slot_count_ / 2) {
+        throw std::runtime_error("Vector dimension exceeds BFV row size");
+    }
+
+    // 临时密文 / 明文的数据分配在本引擎的内存池中，用完后留给下一次比较复用
+    scratch_.rotated = Ciphertext(pool_);
+    scratch_.zero = Ciphertext(pool_);
+    scratch_.scale = Plaintext(pool_);
+    scratch_.offset = Plaintext(pool_);
+}
+
+std::shared_ptr<const HammingConstants> PackedHammingEngine::buildConstants() const {
+    auto constants = std::make_shared<HammingConstants>();
+    constants->parms_id = input_parms_id_;
+
+    // 非目标组在 XOR 后已为 0，因此所有组共用一个块首掩码
+    std::vector<uint64_t> mask(slot_count_, 0);
+    for (size_t i = 0; i < slot_count_; i += block_) {
+        mask[i] = 1;
+    }
+    encoder_->encode(mask, constants->leading_mask_ntt);
+    evaluator_->transform_to_ntt_inplace(constants->leading_mask_ntt, input_parms_id_);
+    return constants;
+}
+
+void PackedHammingEngine::setLevels(parms_id_type input_parms_id, parms_id_type output_parms_id) {
+    auto input = context_->get_context_data(input_parms_id);
+    auto output = context_->get_context_data(output_parms_id);
+    if (!input || !output || output->chain_index() > input->chain_index()) {
+        throw std::runtime_error("Invalid ciphertext levels for PackedHammingEngine");
+    }
+
+    input_parms_id_ = input_parms_id;
+    output_parms_id_ = output_parms_id;
+    if (constants_ && constants_->parms_id != input_parms_id_) {
+        constants_ = buildConstants();
+    }
+}
+
+int PackedHammingEngine::blockSize(int d) {
+    int block = 1;
+    while (block < d) {
+        block <<= 1;
+    }
+    return block;
+}
+
+std::vector<int> PackedHammingEngine::galoisSteps(int d) {
+    std::vector<int> steps;
+    for (int s = 1; s < blockSize(d); s <<= 1) {
+        steps.push_back(s);
+        steps.push_back(-s);
+    }
+    return steps;
+}
+
+void PackedHammingEngine::encodeVectors(const std::vector<std::vector<uint8_t>>& vectors,
+                                        size_t begin, size_t count,
+                                        Plaintext& destination) const {
+    if (count > static_cast<size_t>(recordsPerCiphertext())) {
+        throw std::runtime_error("Too many vectors for one ciphertext");
+    }
+
+    std::vector<uint64_t> slots(slot_count_, 0);
+    for (size_t g = 0; g < count; ++g) {
+        const auto& bits = vectors[begin + g];
+        uint64_t* block_slots = slots.data() + g * block_;
+        for (int k = 0; k < d_; ++k) {
+            block_slots[k] = bits[k] & 1;
+        }
+    }
+    encoder_->encode(slots, destination);
+}
+
+void PackedHammingEngine::setKeys(const PublicKey& public_key,
+                                  std::shared_ptr<const GaloisKeys> galois_keys) {
+    encryptor_ = std::make_unique<Encryptor>(*context_, public_key);
+    galois_keys_ = std::move(galois_keys);
+    if (!constants_) {
+        constants_ = buildConstants();
+    }
+}
+
+void PackedHammingEngine::toNTT(Ciphertext& enc_w) const {
+    if (!enc_w.is_ntt_form()) {
+        // BFV 只能在普通形式下切换模数
+        if (enc_w.parms_id() != input_parms_id_) {
+            evaluator_->mod_switch_to_inplace(enc_w, input_parms_id_);
+        }
+        evaluator_->transform_to_ntt_inplace(enc_w);
+    }
+}
+
+void PackedHammingEngine::blockSumReplicate(Ciphertext& ct) const {
+    Ciphertext& rotated = scratch_.rotated;
+
+    // 左移累加：槽位 i 得到 [i, i+D) 的和，块首槽位即为全块之和。
+    // D 整除行长，块不会跨行
+    for (int s = 1; s < block_; s <<= 1) {
+        evaluator_->rotate_rows(ct, s, *galois_keys_, rotated, pool_);
+        evaluator_->add_inplace(ct, rotated);
+    }
+
+    // 只保留块首槽位（NTT 域逐点相乘，掩码已预先转换），再右移累加复制到整个块
+    evaluator_->transform_to_ntt_inplace(ct);
+    evaluator_->multiply_plain_inplace(ct, constants_->leading_mask_ntt, pool_);
+    evaluator_->transform_from_ntt_inplace(ct);
+    for (int s = 1; s < block_; s <<= 1) {
+        evaluator_->rotate_rows(ct, -s, *galois_keys_, rotated, pool_);
+        evaluator_->add_inplace(ct, rotated);
+    }
+}
+
+const PackedHammingEngine::QueryPlain& PackedHammingEngine::queryPlain(
+        const std::vector<uint8_t>& q, int group, bool ntt) const {
+    if (q.size() < static_cast<size_t>(d_)) {
+        throw std::runtime_error("Query shorter than vector dimension");
+    }
+    if (!std::equal(q.begin(), q.begin() + d_, scratch_.query.begin(), scratch_.query.end())) {
+        scratch_.query.assign(q.begin(), q.begin() + d_);
+        scratch_.query_plain_count = 0;
+    }
+
+    auto& plains = scratch_.query_plains;
+    for (size_t i = 0; i < scratch_.query_plain_count; ++i) {
+        if (plains[i].group == group && plains[i].ntt == ntt) {
+            return plains[i];
+        }
+    }
+
+    if (scratch_.query_plain_count == plains.size()) {
+        plains.push_back({0, false, Plaintext(pool_), Plaintext(pool_)});
+    }
+    QueryPlain& plain = plains[scratch_.query_plain_count++];
+    plain.group = group;
+    plain.ntt = ntt;
+
+    // w XOR q = w·(1 - 2q) + q，目标组所有槽位一次完成；其余组乘 0 清零
+    size_t base = static_cast<size_t>(group) * block_;
+    std::vector<uint64_t>& flip = scratch_.flip_slots;
+    std::vector<uint64_t>& bias = scratch_.bias_slots;
+    flip.assign(slot_count_, 0);
+    bias.assign(slot_count_, 0);
+    for (int k = 0; k < d_; ++k) {
+        flip[base + k] = (q[k] & 1) ? plain_modulus_ - 1 : 1;
+        bias[base + k] = q[k] & 1;
+    }
+    encoder_->encode(flip, plain.flip);
+    encoder_->encode(bias, plain.bias);
+    if (ntt) {
+        evaluator_->transform_to_ntt_inplace(plain.flip, input_parms_id_, pool_);
+    }
+    return plain;
+}
+
+Ciphertext PackedHammingEngine::hammingDistance(const Ciphertext& enc_w,
+                                                const std::vector<uint8_t>& q,
+                                                int group) const {
+    if (!encryptor_) {
+        throw std::runtime_error("PackedHammingEngine keys not set");
+    }
+    if (group < 0 || group >= recordsPerCiphertext()) {
+        throw std::runtime_error("Invalid packed group index");
+    }
+    if (enc_w.parms_id() != input_parms_id_) {
+        throw std::runtime_error("Packed ciphertext is not at the engine input level");
+    }
+
+    const QueryPlain& plain = queryPlain(q, group, enc_w.is_ntt_form());
+    Ciphertext result(pool_);
+    evaluator_->multiply_plain(enc_w, plain.flip, result, pool_);
+    if (result.is_ntt_form()) {
+        evaluator_->transform_from_ntt_inplace(result);
+    }
+    evaluator_->add_plain_inplace(result, plain.bias, pool_);
+
+    blockSumReplicate(result);
+    return result;
+}
+
+Ciphertext PackedHammingEngine::thresholdTest(const Ciphertext& enc_w,
+                                              const std::vector<uint8_t>& q,
+                                              int delta, PRNG& prng, int group) const {
+    if (delta < 0) {
+        return nonMatch(prng);
+    }
+    if (delta + 1 > block_) {
+        throw std::runtime_error("Threshold exceeds packed block size");
+    }
+
+    metrics::ScopedTimer timer(metrics::Stage::Evaluate);
+    Ciphertext result = hammingDistance(enc_w, q, group);
+
+    // δ+1 个测试槽位在目标块内随机放置（部分 Fisher-Yates），避免位置泄露 HD
+    std::vector<int>& positions = scratch_.positions;
+    positions.resize(block_);
+    std::iota(positions.begin(), positions.end(), group * block_);
+    for (int t = 0; t <= delta; ++t) {
+        int pick = t + static_cast<int>(prng.get<uint64_t>() % (block_ - t));
+        std::swap(positions[t], positions[pick]);
+    }
+
+    std::vector<uint64_t>& scale = scratch_.flip_slots;
+    std::vector<uint64_t>& offset = scratch_.bias_slots;
+    scale.assign(slot_count_, 0);
+    offset.resize(slot_count_);
+    for (size_t i = 0; i < slot_count_; ++i) {
+        offset[i] = randomNonZero(prng);
+    }
+    for (int t = 0; t <= delta; ++t) {
+        uint64_t r = randomNonZero(prng);
+        scale[positions[t]] = r;
+        offset[positions[t]] = (plain_modulus_ - (static_cast<uint64_t>(t) * r) % plain_modulus_)
+                               % plain_modulus_;
+    }
+
+    Plaintext& scale_plain = scratch_.scale;
+    Plaintext& offset_plain = scratch_.offset;
+    encoder_->encode(scale, scale_plain);
+    encoder_->encode(offset, offset_plain);
+
+    // 测试槽位：r_t·HD - r_t·t = r_t·(HD - t)；其余槽位：0·HD + 随机非零值
+    evaluator_->multiply_plain_inplace(result, scale_plain, pool_);
+    evaluator_->add_plain_inplace(result, offset_plain, pool_);
+
+    rerandomize(result);
+    toOutputLevel(result);
+    return result;
+}
+
+Ciphertext PackedHammingEngine::nonMatch(PRNG& prng) const {
+    if (!encryptor_) {
+        throw std::runtime_error("PackedHammingEngine keys not set");
+    }
+
+    metrics::ScopedTimer timer(metrics::Stage::Evaluate);
+    std::vector<uint64_t>& slots = scratch_.bias_slots;
+    slots.resize(slot_count_);
+    for (size_t i = 0; i < slot_count_; ++i) {
+        slots[i] = randomNonZero(prng);
+    }
+
+    Plaintext& plain = scratch_.offset;
+    encoder_->encode(slots, plain);
+
+    // Enc(0) + m 与新鲜加密 Enc(m) 同分布；先落到输入层，再与 thresholdTest 一样切换到输出层
+    Ciphertext result(pool_);
+    if (zero_pool_) {
+        zero_pool_->take(result);
+        if (result.parms_id() != input_parms_id_) {
+            evaluator_->mod_switch_to_inplace(result, input_parms_id_, pool_);
+        }
+    } else {
+        encryptor_->encrypt_zero(input_parms_id_, result, pool_);
+    }
+    evaluator_->add_plain_inplace(result, plain, pool_);
+    toOutputLevel(result);
+    return result;
+}
+
+bool PackedHammingEngine::anyZero(const std::vector<uint64_t>& slots) {
+    return std::find(slots.begin(), slots.end(), 0) != slots.end();
+}
+
+void PackedHammingEngine::rerandomize(Ciphertext& ct) const {
+    Ciphertext& zero = scratch_.zero;
+    if (zero_pool_) {
+        zero_pool_->take(zero);
+        if (zero.parms_id() != ct.parms_id()) {
+            evaluator_->mod_switch_to_inplace(zero, ct.parms_id(), pool_);
+        }
+    } else {
+        encryptor_->encrypt_zero(ct.parms_id(), zero, pool_);
+    }
+    evaluator_->add_inplace(ct, zero);
+}
+
+void PackedHammingEngine::toOutputLevel(Ciphertext& ct) const {
+    if (ct.parms_id() != output_parms_id_) {
+        evaluator_->mod_switch_to_inplace(ct, output_parms_id_, pool_);
+    }
+}
+
+uint64_t PackedHammingEngine::randomNonZero(PRNG& prng) const {
+    return 1 + prng.get<uint64_t>() % (plain_modulus_ - 1);
+}
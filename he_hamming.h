@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <seal/seal.h>
+#include "cryptoTools/Crypto/PRNG.h"
+#include "zero_pool.h"
+
+using namespace seal;
+using namespace osuCrypto;
+
+// 在线阶段反复使用的常量明文，预先编码并转换为 NTT 形式。
+// 构建后只读，可被多个引擎（每个在线线程一个）共享
+struct HammingConstants {
+    parms_id_type parms_id;        // 明文所在的层，与输入密文的层一致
+    Plaintext leading_mask_ntt;    // 每组块首槽位为 1，其余为 0
+};
+
+// 基于 BatchEncoder 槽位打包的同态 Hamming 距离引擎。
+// 向量的 d 个比特放在一个长度为 D（不小于 d 的 2 的幂）的槽位块中，
+// 每次比较只产生一个密文：
+//   1. XOR：a + b - 2ab，b 为明文时即 a·(1-2b) + b，只需明文运算
+//   2. 块内求和：rotate_rows 左移 1, 2, ..., D/2 累加，块首槽位得到 HD
+//   3. 复制：保留块首槽位后右移累加，使 HD 充满整个块
+//   4. 阈值零测试：在块内随机选取 δ+1 个槽位放置 r_t·(HD - t)，其余槽位为随机非零值，
+//      Receiver 解密后只能得知是否存在零槽位，即 HD ≤ δ
+// 一个密文可以打包 ⌊slots/D⌋ 个向量，第 g 个向量（组）占用槽位 [g·D, (g+1)·D)。
+// 比较时只有目标组参与，其余组在 XOR 步骤中被清零。
+// 每个引擎持有独立的 SEAL 内存池和可复用的临时对象，因此同一引擎不能被多个线程
+// 同时用于比较（toNTT 除外）；并行时每个线程各用一个引擎。
+// 输入密文在 setLevels 指定的输入层上计算，比较结果切换到输出层后返回（通常为最后一层），
+// 发送的密文只保留最少的模数。
+class PackedHammingEngine {
+public:
+    PackedHammingEngine(std::shared_ptr<SEALContext> context, int d);
+
+    // 需要的 Galois 旋转步长（Receiver 据此生成 Galois 密钥）
+    static std::vector<int> galoisSteps(int d);
+
+    // 不小于 d 的 2 的幂
+    static int blockSize(int d);
+
+    int dim() const { return d_; }
+    int blockSize() const { return block_; }
+    size_t slotCount() const { return slot_count_; }
+
+    // 输入密文参与计算的层与比较结果返回的层，默认都是 first_parms_id。
+    // 输出层不能高于输入层；常量明文已按其他层构建时重新构建
+    void setLevels(parms_id_type input_parms_id, parms_id_type output_parms_id);
+    parms_id_type inputParmsId() const { return input_parms_id_; }
+    parms_id_type outputParmsId() const { return output_parms_id_; }
+
+    // 本引擎内存池当前分配的字节数（池只增不减，即高水位）
+    size_t memoryPoolBytes() const { return pool_.alloc_byte_count(); }
+
+    // 每个密文最多容纳的向量数
+    int recordsPerCiphertext() const { return static_cast<int>(slot_count_ / block_); }
+
+    // Receiver：把 vectors[begin, begin+count) 依次编码到第 0..count-1 组，其余槽位为 0
+    void encodeVectors(const std::vector<std::vector<uint8_t>>& vectors,
+                       size_t begin, size_t count, Plaintext& destination) const;
+
+    // Sender：设置公钥（用于重随机化）和 Receiver 的 Galois 密钥。
+    // Galois 密钥较大，多个引擎（如每个在线线程一个）可以共享同一份
+    void setKeys(const PublicKey& public_key, std::shared_ptr<const GaloisKeys> galois_keys);
+
+    // Sender：常量明文缓存。setKeys 时若尚未设置则自动构建，
+    // 其他引擎可通过 setConstants 共享同一份
+    std::shared_ptr<const HammingConstants> constants() const { return constants_; }
+    void setConstants(std::shared_ptr<const HammingConstants> constants) { constants_ = std::move(constants); }
+
+    // Sender：把离线收到的打包密文切换到输入层（更高层的密文）并转为 NTT 形式，
+    // 此后每次比较省去一次密文 NTT
+    void toNTT(Ciphertext& enc_w) const;
+
+    // Sender：重随机化和 nonMatch 所需的 Enc(0) 从预计算池中取出（可多个引擎共享）
+    void setZeroPool(std::shared_ptr<EncryptedZeroPool> zero_pool) { zero_pool_ = std::move(zero_pool); }
+
+    // Sender：计算 Enc(HD(w_g, q))，HD 复制到第 group 组的全部 D 个槽位，其余槽位为 0。
+    // enc_w 必须位于输入层，可以是普通形式或 toNTT 之后的形式，结果为输入层上的普通形式。
+    // q 的 XOR 明文按组偏移缓存，连续比较同一查询的多个候选时只编码 / NTT 一次
+    Ciphertext hammingDistance(const Ciphertext& enc_w, const std::vector<uint8_t>& q,
+                               int group = 0) const;
+
+    // Sender：比较第 group 组的向量与 q，返回输出层上的阈值零测试密文
+    Ciphertext thresholdTest(const Ciphertext& enc_w, const std::vector<uint8_t>& q,
+                             int delta, PRNG& prng, int group = 0) const;
+
+    // Sender：与 thresholdTest 输出不可区分的“不匹配”密文（用于无效的 OKVS 解码结果）
+    Ciphertext nonMatch(PRNG& prng) const;
+
+    // Receiver：解密后的槽位中是否存在 0
+    static bool anyZero(const std::vector<uint64_t>& slots);
+
+private:
+    // 块内求和并复制到整个块
+    void blockSumReplicate(Ciphertext& ct) const;
+
+    // 加上一个新鲜的 Enc(0)（优先取自预计算池），隐藏运算带来的噪声特征
+    void rerandomize(Ciphertext& ct) const;
+
+    // 切换到输出层
+    void toOutputLevel(Ciphertext& ct) const;
+
+    std::shared_ptr<const HammingConstants> buildConstants() const;
+
+    // [1, p) 内的随机数
+    uint64_t randomNonZero(PRNG& prng) const;
+
+    std::shared_ptr<SEALContext> context_;
+    MemoryPoolHandle pool_;
+    std::unique_ptr<Evaluator> evaluator_;
+    std::unique_ptr<BatchEncoder> encoder_;
+    std::unique_ptr<Encryptor> encryptor_;
+    std::shared_ptr<const GaloisKeys> galois_keys_;
+    std::shared_ptr<EncryptedZeroPool> zero_pool_;
+    std::shared_ptr<const HammingConstants> constants_;
+
+    // 当前查询在某个组偏移上的 XOR 明文（flip 已按需转为 NTT 形式）
+    struct QueryPlain {
+        int group;
+        bool ntt;
+        Plaintext flip, bias;
+    };
+
+    // 取得当前查询在 group 上的 XOR 明文；查询变化时清空缓存，同一查询的后续候选直接复用
+    const QueryPlain& queryPlain(const std::vector<uint8_t>& q, int group, bool ntt) const;
+
+    // 每次比较复用的临时对象
+    struct Scratch {
+        Ciphertext rotated;
+        Ciphertext zero;
+        Plaintext scale, offset;
+        std::vector<uint64_t> flip_slots, bias_slots;
+        std::vector<int> positions;
+        std::vector<uint8_t> query;          // 缓存所属的查询
+        std::vector<QueryPlain> query_plains; // 前 query_plain_count 项有效，其余保留分配供复用
+        size_t query_plain_count = 0;
+    };
+    mutable Scratch scratch_;
+
+    parms_id_type input_parms_id_;
+    parms_id_type output_parms_id_;
+
+    int d_;
+    int block_;
+    size_t slot_count_;
+    uint64_t plain_modulus_;
+};
@@ -0,0 +1,95 @@
+#include "id_index.h"
+#include <stdexcept>
+
+void IdIndex::rehash(size_t capacity) {
+    std::vector<Slot> old = std::move(slots_);
+    slots_.assign(capacity, Slot{EMPTY_KEY, 0, 0});
+    mask_ = capacity - 1;
+
+    for (const Slot& slot : old) {
+        if (slot.key == EMPTY_KEY) {
+            continue;
+        }
+        size_t pos = probeStart(slot.key);
+        while (slots_[pos].key != EMPTY_KEY) {
+            pos = (pos + 1) & mask_;
+        }
+        slots_[pos] = slot;
+    }
+}
+
+IdIndex::Slot& IdIndex::findOrInsert(ELSHFmap::ID key) {
+    if ((num_keys_ + 1) * 2 > slots_.size()) {
+        rehash(slots_.empty() ? 64 : slots_.size() * 2);
+    }
+
+    size_t pos = probeStart(key);
+    while (slots_[pos].key != EMPTY_KEY) {
+        if (slots_[pos].key == key) {
+            return slots_[pos];
+        }
+        pos = (pos + 1) & mask_;
+    }
+
+    ++num_keys_;
+    slots_[pos] = Slot{key, 0, 0};
+    return slots_[pos];
+}
+
+void IdIndex::build(const ELSHFmap::ID* ids, size_t n, int L) {
+    size_t total = n * static_cast<size_t>(L);
+    if (n > UINT32_MAX || total > UINT32_MAX) {
+        throw std::runtime_error("IdIndex supports at most 2^32 entries");
+    }
+
+    slots_.clear();
+    values_.clear();
+    num_keys_ = 0;
+    mask_ = 0;
+
+    // 第一遍：统计每个 ID 的向量数
+    for (size_t idx = 0; idx < total; ++idx) {
+        if (ids[idx] == EMPTY_KEY) {
+            throw std::runtime_error("Reserved E-LSH ID value");
+        }
+        ++findOrInsert(ids[idx]).count;
+    }
+
+    // 前缀和得到每个 ID 在值数组中的起点
+    uint32_t offset = 0;
+    for (Slot& slot : slots_) {
+        if (slot.key != EMPTY_KEY) {
+            slot.offset = offset;
+            offset += slot.count;
+            slot.count = 0;
+        }
+    }
+
+    // 第二遍：按向量下标顺序写入，区间内天然升序
+    values_.resize(total);
+    for (size_t i = 0; i < n; ++i) {
+        for (int l = 0; l < L; ++l) {
+            Slot& slot = findOrInsert(ids[i * L + l]);
+            values_[slot.offset + slot.count++] = static_cast<uint32_t>(i);
+        }
+    }
+}
+
+IdIndex::Span IdIndex::find(ELSHFmap::ID id) const {
+    if (slots_.empty()) {
+        return Span{};
+    }
+
+    size_t pos = probeStart(id);
+    while (slots_[pos].key != EMPTY_KEY) {
+        if (slots_[pos].key == id) {
+            return Span{values_.data() + slots_[pos].offset, slots_[pos].count};
+        }
+        pos = (pos + 1) & mask_;
+    }
+    return Span{};
+}
+
+size_t IdIndex::memoryBytes() const {
+    return slots_.size() * sizeof(Slot) + values_.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "elsh.h"
+
+// E-LSH ID → 向量下标的一对多索引（开放寻址 + 连续值数组）。
+// 共享同一 ID 的全部向量下标按升序连续存放，查找返回一个区间；
+// 两遍构建：先统计每个 ID 的向量数，再按前缀和写入值数组。
+class IdIndex {
+public:
+    // 查找结果：values[0..size) 为候选向量下标
+    struct Span {
+        const uint32_t* values = nullptr;
+        uint32_t size = 0;
+
+        const uint32_t* begin() const { return values; }
+        const uint32_t* end() const { return values + size; }
+        bool empty() const { return size == 0; }
+    };
+
+    // ids 为 n × L 的扁平数组，第 i 个向量的 ID 位于 ids[i*L, (i+1)*L)
+    void build(const ELSHFmap::ID* ids, size_t n, int L);
+
+    Span find(ELSHFmap::ID id) const;
+
+    size_t numKeys() const { return num_keys_; }
+    size_t numValues() const { return values_.size(); }
+    size_t memoryBytes() const;
+
+private:
+    struct Slot {
+        ELSHFmap::ID key;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    static constexpr ELSHFmap::ID EMPTY_KEY = ~0ULL;
+
+    // 查找 key 所在槽位，不存在时插入（负载超过 1/2 时扩容）
+    Slot& findOrInsert(ELSHFmap::ID key);
+    void rehash(size_t capacity);
+
+    size_t probeStart(ELSHFmap::ID key) const {
+        return static_cast<size_t>(ELSHFmap::idKey(key)) & mask_;
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> values_;
+    size_t mask_ = 0;
+    size_t num_keys_ = 0;
+};
@@ -0,0 +1,181 @@
+#include "link_emulator.h"
+#include "stream_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 在链路上传输的一个数据块，空块表示发送方已关闭
+struct Chunk {
+    Clock::time_point arrival;
+    std::vector<uint8_t> data;
+};
+
+constexpr size_t CHUNK_BYTES = 64 * 1024;
+constexpr size_t QUEUE_CHUNKS = 256;    // 链路上最多滞留 16 MB，超出时读端阻塞形成背压
+
+void setNoDelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+}
+
+LinkEmulator::LinkEmulator(int listen_port, int target_port, double latency_ms, double bandwidth_mbps)
+    : listen_port_(listen_port), target_port_(target_port),
+      latency_ms_(std::max(latency_ms, 0.0)), bandwidth_mbps_(std::max(bandwidth_mbps, 0.0)) {}
+
+LinkEmulator::~LinkEmulator() {
+    stop();
+}
+
+void LinkEmulator::start() {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("LinkEmulator: socket failed");
+    }
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(listen_port_));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 16) != 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        throw std::runtime_error("LinkEmulator: cannot listen on port " + std::to_string(listen_port_));
+    }
+
+    acceptor_ = std::thread([this]() { acceptLoop(); });
+}
+
+void LinkEmulator::stop() {
+    if (stopping_.exchange(true)) {
+        return;
+    }
+    if (listen_fd_ >= 0) {
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        ::close(listen_fd_);
+    }
+    if (acceptor_.joinable()) {
+        acceptor_.join();
+    }
+
+    std::vector<std::thread> relays;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : sockets_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        relays.swap(relays_);
+    }
+    for (auto& relay : relays) {
+        relay.join();
+    }
+    for (int fd : sockets_) {
+        ::close(fd);
+    }
+    sockets_.clear();
+}
+
+void LinkEmulator::acceptLoop() {
+    while (!stopping_) {
+        int client = ::accept(listen_fd_, nullptr, nullptr);
+        if (client < 0) {
+            return;
+        }
+
+        int server = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(target_port_));
+        if (server < 0 || ::connect(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(client);
+            if (server >= 0) {
+                ::close(server);
+            }
+            continue;
+        }
+        setNoDelay(client);
+        setNoDelay(server);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        sockets_.push_back(client);
+        sockets_.push_back(server);
+        relays_.emplace_back([this, client, server]() { relay(client, server); });
+        relays_.emplace_back([this, client, server]() { relay(server, client); });
+    }
+}
+
+void LinkEmulator::relay(int from, int to) {
+    const auto latency = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(latency_ms_));
+    const double bytes_per_second = bandwidth_mbps_ * 1e6 / 8.0;
+
+    // 读端给每个数据块打上到达时间，写端按时间放行；两者之间的有界队列即链路缓冲
+    BoundedQueue<Chunk> link(QUEUE_CHUNKS);
+    std::thread writer([&]() {
+        Chunk chunk;
+        while (link.pop(chunk)) {
+            if (chunk.data.empty()) {
+                break;
+            }
+            std::this_thread::sleep_until(chunk.arrival);
+            if (!writeAll(to, chunk.data.data(), chunk.data.size())) {
+                break;
+            }
+            bytes_relayed_ += chunk.data.size();
+        }
+        ::shutdown(to, SHUT_WR);
+        link.close();
+    });
+
+    Clock::time_point link_free = Clock::now();
+    std::vector<uint8_t> buffer(CHUNK_BYTES);
+    while (true) {
+        ssize_t received = ::recv(from, buffer.data(), buffer.size(), 0);
+        if (received <= 0) {
+            break;
+        }
+
+        Clock::time_point now = Clock::now();
+        Clock::time_point departure = std::max(now, link_free);
+        if (bytes_per_second > 0) {
+            departure += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(received / bytes_per_second));
+        }
+        link_free = departure;
+
+        Chunk chunk{departure + latency, std::vector<uint8_t>(buffer.begin(), buffer.begin() + received)};
+        if (!link.push(std::move(chunk))) {
+            break;
+        }
+    }
+
+    link.push(Chunk{Clock::now(), {}});
+    writer.join();
+}
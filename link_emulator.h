@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 本机 TCP 中继，用于在进程内模拟广域网链路：监听 listen_port，把每个连接转发到
+// 127.0.0.1:target_port。每个方向独立建模为一条单向链路：
+// 数据块按带宽依次占用链路（发送时间 = 字节数 / 带宽），离开链路后再经过固定的单向时延到达。
+// latency_ms 与 bandwidth_mbps 为 0 时对应的约束不生效
+class LinkEmulator {
+public:
+    LinkEmulator(int listen_port, int target_port, double latency_ms, double bandwidth_mbps);
+    ~LinkEmulator();
+
+    LinkEmulator(const LinkEmulator&) = delete;
+    LinkEmulator& operator=(const LinkEmulator&) = delete;
+
+    // 开始监听；端口不可用时抛出 std::runtime_error
+    void start();
+
+    // 停止接受新连接并等待全部转发线程结束
+    void stop();
+
+    // 经过中继的总字节数（两个方向之和）
+    uint64_t bytesRelayed() const { return bytes_relayed_.load(); }
+
+private:
+    void acceptLoop();
+    void relay(int from, int to);
+
+    int listen_port_;
+    int target_port_;
+    double latency_ms_;
+    double bandwidth_mbps_;
+
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> bytes_relayed_{0};
+    std::thread acceptor_;
+    std::mutex mutex_;                  // 保护 relays_ 与 sockets_
+    std::vector<std::thread> relays_;
+    std::vector<int> sockets_;
+};
@@ -0,0 +1,397 @@
+#include "metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace metrics {
+
+namespace {
+
+// 每个计数器只由所属线程写入，load + store 即可，不需要原子读改写；
+// 其他线程（snapshot）只做 relaxed 读取
+inline void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline uint64_t read(const std::atomic<uint64_t>& counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+struct StageCounters {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+};
+
+struct ThreadCounters {
+    int index = 0;
+    StageCounters stages[STAGE_COUNT];
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> messages_sent{0};
+    std::atomic<uint64_t> messages_received{0};
+};
+
+std::atomic<bool> g_enabled{false};
+
+// 线程退出后计数器仍保留在注册表中，snapshot 继续包含其记录
+std::mutex g_registry_mutex;
+std::vector<std::shared_ptr<ThreadCounters>> g_registry;
+
+ThreadCounters& local() {
+    thread_local std::shared_ptr<ThreadCounters> counters = []() {
+        auto created = std::make_shared<ThreadCounters>();
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        created->index = static_cast<int>(g_registry.size());
+        g_registry.push_back(created);
+        return created;
+    }();
+    return *counters;
+}
+
+int bucketOf(uint64_t ns) {
+    int b = ns == 0 ? 0 : static_cast<int>(std::bit_width(ns)) - 1;
+    return std::min(b, HISTOGRAM_BUCKETS - 1);
+}
+
+ThreadSummary summarize(const ThreadCounters& counters) {
+    ThreadSummary summary;
+    summary.thread = counters.index;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageCounters& in = counters.stages[s];
+        StageSummary& out = summary.stages[s];
+        out.count = read(in.count);
+        out.total_ns = read(in.total_ns);
+        out.max_ns = read(in.max_ns);
+        for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            out.buckets[b] = read(in.buckets[b]);
+        }
+    }
+    summary.channel.bytes_sent = read(counters.bytes_sent);
+    summary.channel.bytes_received = read(counters.bytes_received);
+    summary.channel.messages_sent = read(counters.messages_sent);
+    summary.channel.messages_received = read(counters.messages_received);
+    return summary;
+}
+
+void writeStages(std::ostream& out, const ThreadSummary& summary, bool histograms) {
+    out << "{";
+    bool first = true;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageSummary& stage = summary.stages[s];
+        if (stage.count == 0) {
+            continue;
+        }
+        out << (first ? "" : ",") << "\"" << stageName(static_cast<Stage>(s)) << "\":{"
+            << "\"calls\":" << stage.count
+            << ",\"seconds\":" << stage.seconds()
+            << ",\"max_seconds\":" << stage.max_ns / 1e9;
+        if (histograms) {
+            out << ",\"p50_seconds\":" << stage.quantileNs(0.5) / 1e9
+                << ",\"p99_seconds\":" << stage.quantileNs(0.99) / 1e9
+                << ",\"histogram_log2_ns\":[";
+            int last = HISTOGRAM_BUCKETS - 1;
+            while (last > 0 && stage.buckets[last] == 0) {
+                --last;
+            }
+            for (int b = 0; b <= last; ++b) {
+                out << (b ? "," : "") << stage.buckets[b];
+            }
+            out << "]";
+        }
+        out << "}";
+        first = false;
+    }
+    out << "}";
+}
+
+void writeChannel(std::ostream& out, const ChannelSummary& channel) {
+    out << "{\"bytes_sent\":" << channel.bytes_sent
+        << ",\"bytes_received\":" << channel.bytes_received
+        << ",\"messages_sent\":" << channel.messages_sent
+        << ",\"messages_received\":" << channel.messages_received << "}";
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::ELSH:        return "elsh";
+        case Stage::OkvsEncode:  return "okvs_encode";
+        case Stage::OkvsDecode:  return "okvs_decode";
+        case Stage::Encrypt:     return "encrypt";
+        case Stage::Evaluate:    return "evaluate";
+        case Stage::Decrypt:     return "decrypt";
+        case Stage::Serialize:   return "serialize";
+        case Stage::Deserialize: return "deserialize";
+        case Stage::Mask:        return "mask";
+        case Stage::NetworkSend: return "network_send";
+        case Stage::NetworkWait: return "network_wait";
+        default:                 return "unknown";
+    }
+}
+
+uint64_t StageSummary::quantileNs(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * static_cast<double>(count));
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen > target) {
+            return b + 1 < HISTOGRAM_BUCKETS ? std::min(uint64_t(1) << (b + 1), max_ns) : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+void StageSummary::merge(const StageSummary& other) {
+    count += other.count;
+    total_ns += other.total_ns;
+    max_ns = std::max(max_ns, other.max_ns);
+    for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+        buckets[b] += other.buckets[b];
+    }
+}
+
+void ChannelSummary::merge(const ChannelSummary& other) {
+    bytes_sent += other.bytes_sent;
+    bytes_received += other.bytes_received;
+    messages_sent += other.messages_sent;
+    messages_received += other.messages_received;
+}
+
+bool ThreadSummary::empty() const {
+    for (const auto& stage : stages) {
+        if (stage.count != 0) {
+            return false;
+        }
+    }
+    return channel.messages_sent == 0 && channel.messages_received == 0;
+}
+
+void ThreadSummary::merge(const ThreadSummary& other) {
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        stages[s].merge(other.stages[s]);
+    }
+    channel.merge(other.channel);
+}
+
+std::string Snapshot::toJson(const std::string& role) const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "{\"role\":\"" << role << "\",\"stages\":";
+    writeStages(out, total, true);
+    out << ",\"channel\":";
+    writeChannel(out, total.channel);
+    out << ",\"threads\":[";
+    for (size_t t = 0; t < threads.size(); ++t) {
+        out << (t ? "," : "") << "{\"thread\":" << threads[t].thread << ",\"stages\":";
+        writeStages(out, threads[t], false);
+        out << ",\"channel\":";
+        writeChannel(out, threads[t].channel);
+        out << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+std::string Snapshot::toPrometheus(const std::string& role) const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    std::string role_label = "role=\"" + role + "\"";
+
+    out << "# HELP fpsi_stage_seconds_total Time spent in each instrumented stage.\n"
+        << "# TYPE fpsi_stage_seconds_total counter\n";
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        out << "fpsi_stage_seconds_total{" << role_label << ",stage=\""
+            << stageName(static_cast<Stage>(s)) << "\"} " << total.stages[s].seconds() << "\n";
+    }
+
+    out << "# HELP fpsi_stage_latency_seconds Latency of a single stage invocation.\n"
+        << "# TYPE fpsi_stage_latency_seconds histogram\n";
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageSummary& stage = total.stages[s];
+        std::string labels = role_label + ",stage=\"" + stageName(static_cast<Stage>(s)) + "\"";
+        uint64_t cumulative = 0;
+        for (int b = 0; b + 1 < HISTOGRAM_BUCKETS; ++b) {
+            cumulative += stage.buckets[b];
+            out << "fpsi_stage_latency_seconds_bucket{" << labels << ",le=\""
+                << static_cast<double>(uint64_t(1) << (b + 1)) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << "fpsi_stage_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << stage.count << "\n"
+            << "fpsi_stage_latency_seconds_sum{" << labels << "} " << stage.seconds() << "\n"
+            << "fpsi_stage_latency_seconds_count{" << labels << "} " << stage.count << "\n";
+    }
+
+    out << "# HELP fpsi_channel_bytes_total Bytes transferred over metered channels.\n"
+        << "# TYPE fpsi_channel_bytes_total counter\n"
+        << "fpsi_channel_bytes_total{" << role_label << ",direction=\"sent\"} "
+        << total.channel.bytes_sent << "\n"
+        << "fpsi_channel_bytes_total{" << role_label << ",direction=\"received\"} "
+        << total.channel.bytes_received << "\n"
+        << "# HELP fpsi_channel_messages_total Messages transferred over metered channels.\n"
+        << "# TYPE fpsi_channel_messages_total counter\n"
+        << "fpsi_channel_messages_total{" << role_label << ",direction=\"sent\"} "
+        << total.channel.messages_sent << "\n"
+        << "fpsi_channel_messages_total{" << role_label << ",direction=\"received\"} "
+        << total.channel.messages_received << "\n";
+
+    out << "# HELP fpsi_thread_stage_seconds_total Time spent in each stage per thread.\n"
+        << "# TYPE fpsi_thread_stage_seconds_total counter\n";
+    for (const auto& thread : threads) {
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            if (thread.stages[s].count == 0) {
+                continue;
+            }
+            out << "fpsi_thread_stage_seconds_total{" << role_label << ",thread=\"" << thread.thread
+                << "\",stage=\"" << stageName(static_cast<Stage>(s)) << "\"} "
+                << thread.stages[s].seconds() << "\n";
+        }
+    }
+    return out.str();
+}
+
+bool enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool on) {
+    g_enabled.store(on, std::memory_order_relaxed);
+}
+
+void record(Stage stage, uint64_t ns) {
+    StageCounters& counters = local().stages[static_cast<int>(stage)];
+    bump(counters.count, 1);
+    bump(counters.total_ns, ns);
+    if (ns > read(counters.max_ns)) {
+        counters.max_ns.store(ns, std::memory_order_relaxed);
+    }
+    bump(counters.buckets[bucketOf(ns)], 1);
+}
+
+void countSent(uint64_t bytes, uint64_t messages) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadCounters& counters = local();
+    bump(counters.bytes_sent, bytes);
+    bump(counters.messages_sent, messages);
+}
+
+void countReceived(uint64_t bytes, uint64_t messages) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadCounters& counters = local();
+    bump(counters.bytes_received, bytes);
+    bump(counters.messages_received, messages);
+}
+
+Snapshot snapshot() {
+    std::vector<std::shared_ptr<ThreadCounters>> registry;
+    {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        registry = g_registry;
+    }
+
+    Snapshot result;
+    for (const auto& counters : registry) {
+        ThreadSummary summary = summarize(*counters);
+        if (summary.empty()) {
+            continue;
+        }
+        result.total.merge(summary);
+        result.threads.push_back(std::move(summary));
+    }
+    return result;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    for (const auto& counters : g_registry) {
+        for (auto& stage : counters->stages) {
+            stage.count.store(0, std::memory_order_relaxed);
+            stage.total_ns.store(0, std::memory_order_relaxed);
+            stage.max_ns.store(0, std::memory_order_relaxed);
+            for (auto& bucket : stage.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        counters->bytes_sent.store(0, std::memory_order_relaxed);
+        counters->bytes_received.store(0, std::memory_order_relaxed);
+        counters->messages_sent.store(0, std::memory_order_relaxed);
+        counters->messages_received.store(0, std::memory_order_relaxed);
+    }
+}
+
+Options extractFlags(int& argc, char** argv) {
+    Options options;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--metrics") == 0) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("--metrics requires a file path");
+            }
+            options.enabled = true;
+            options.path = argv[++i];
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    if (options.enabled) {
+        setEnabled(true);
+    }
+    return options;
+}
+
+void writeReport(const Options& options, const std::string& role, bool summary) {
+    if (!options.enabled) {
+        return;
+    }
+
+    Snapshot snap = snapshot();
+    std::ofstream file(options.path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot open metrics file: " + options.path);
+    }
+    file << (endsWith(options.path, ".prom") ? snap.toPrometheus(role) : snap.toJson(role));
+    if (!summary) {
+        return;
+    }
+
+    std::cout << "\n" << role << " 各阶段耗时（所有线程合计）:" << std::endl;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const StageSummary& stage = snap.total.stages[s];
+        if (stage.count == 0) {
+            continue;
+        }
+        std::cout << "  " << std::left << std::setw(14) << stageName(static_cast<Stage>(s))
+                  << std::right << std::setw(10) << stage.seconds() << " 秒, "
+                  << stage.count << " 次, p99 <= " << stage.quantileNs(0.99) / 1e6 << " ms"
+                  << std::endl;
+    }
+    std::cout << "  信道: 发送 " << snap.total.channel.messages_sent << " 条消息 / "
+              << snap.total.channel.bytes_sent << " B, 接收 "
+              << snap.total.channel.messages_received << " 条消息 / "
+              << snap.total.channel.bytes_received << " B" << std::endl;
+    std::cout << "插桩数据已写入 " << options.path << " (" << snap.threads.size() << " 个线程)"
+              << std::endl;
+}
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "cryptoTools/Network/Channel.h"
+#include "utils.h"
+
+// 热路径插桩：按阶段计时（每线程的调用数、总时间和 log2 延迟直方图）以及信道的字节 / 消息计数。
+// 每个线程只写自己的计数器，不加锁；snapshot 合并所有线程，可导出为 JSON 或 Prometheus 文本。
+// 未启用时 ScopedTimer 只读一次全局开关，不取时钟
+namespace metrics {
+    enum class Stage : int {
+        ELSH,
+        OkvsEncode,
+        OkvsDecode,
+        Encrypt,
+        Evaluate,
+        Decrypt,
+        Serialize,
+        Deserialize,
+        Mask,
+        NetworkSend,    // 阻塞在 send 上的时间
+        NetworkWait,    // 阻塞在 recv 上等待对端的时间
+        Count
+    };
+
+    constexpr int STAGE_COUNT = static_cast<int>(Stage::Count);
+
+    // 第 b 桶为 [2^b, 2^(b+1)) ns，最后一桶不设上界（约 34 秒以上）
+    constexpr int HISTOGRAM_BUCKETS = 36;
+
+    const char* stageName(Stage stage);
+
+    struct StageSummary {
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+        std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+
+        double seconds() const { return total_ns / 1e9; }
+        // 分位数所在桶的上界（ns），只精确到 2 倍
+        uint64_t quantileNs(double q) const;
+        void merge(const StageSummary& other);
+    };
+
+    struct ChannelSummary {
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_received = 0;
+        uint64_t messages_sent = 0;
+        uint64_t messages_received = 0;
+
+        void merge(const ChannelSummary& other);
+    };
+
+    struct ThreadSummary {
+        int thread = -1;    // 线程注册顺序，-1 表示合计
+        std::array<StageSummary, STAGE_COUNT> stages{};
+        ChannelSummary channel;
+
+        bool empty() const;
+        void merge(const ThreadSummary& other);
+    };
+
+    struct Snapshot {
+        ThreadSummary total;
+        std::vector<ThreadSummary> threads;     // 只包含有记录的线程
+
+        std::string toJson(const std::string& role) const;
+        std::string toPrometheus(const std::string& role) const;
+    };
+
+    bool enabled();
+    void setEnabled(bool on);
+
+    // 记录当前线程的一次阶段耗时 / 一次信道传输
+    void record(Stage stage, uint64_t ns);
+    void countSent(uint64_t bytes, uint64_t messages = 1);
+    void countReceived(uint64_t bytes, uint64_t messages = 1);
+
+    // 合并所有线程（包括已退出的线程）；计数期间也可以调用，结果是近似的一致快照
+    Snapshot snapshot();
+
+    // 清零所有计数器，只应在没有其他线程记录时调用
+    void reset();
+
+    // RAII 阶段计时器
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Stage stage) : stage_(stage), active_(enabled()) {
+            if (active_) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ScopedTimer() {
+            if (active_) {
+                auto elapsed = std::chrono::steady_clock::now() - start_;
+                record(stage_, static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Stage stage_;
+        bool active_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    struct Options {
+        bool enabled = false;
+        std::string path;           // 以 .prom 结尾时输出 Prometheus 文本，否则输出 JSON
+    };
+
+    // 从命令行中取出 "--metrics FILE"（会从 argv 中移除），出现即启用插桩
+    Options extractFlags(int& argc, char** argv);
+
+    // 把当前快照写入 options.path，summary 为 true 时在标准输出打印各阶段耗时摘要；未启用时什么也不做
+    void writeReport(const Options& options, const std::string& role, bool summary = true);
+}
+
+// 计数信道：包装 osuCrypto::Channel，每次收发自动计入 CommStats 与当前线程的信道计数，
+// send / recv 的阻塞时间分别计入 NetworkSend / NetworkWait 阶段。
+// 需要原始信道的模块（OKVS、CipherIO、OT 等）通过 raw() 调用，并把返回的字节数交给 countSent / countReceived
+class MeteredChannel {
+public:
+    MeteredChannel(osuCrypto::Channel& chl, CommStats& comm) : chl_(chl), comm_(comm) {}
+
+    template<typename T>
+    void send(const T& value) {
+        metrics::ScopedTimer timer(metrics::Stage::NetworkSend);
+        chl_.send(value);
+        countSent(payloadBytes(value));
+    }
+
+    template<typename T>
+    void send(const T* data, size_t count) {
+        metrics::ScopedTimer timer(metrics::Stage::NetworkSend);
+        chl_.send(data, count);
+        countSent(count * sizeof(T));
+    }
+
+    // 不拷贝的异步发送，data 在发送完成前必须保持有效
+    template<typename T>
+    void asyncSend(const T* data, size_t count) {
+        chl_.asyncSend(data, count);
+        countSent(count * sizeof(T));
+    }
+
+    // 移交所有权的异步发送（容器）
+    template<typename T>
+    void asyncSend(T&& value) {
+        uint64_t bytes = payloadBytes(value);
+        chl_.asyncSend(std::forward<T>(value));
+        countSent(bytes);
+    }
+
+    template<typename T>
+    void recv(T& value) {
+        metrics::ScopedTimer timer(metrics::Stage::NetworkWait);
+        chl_.recv(value);
+        countReceived(payloadBytes(value));
+    }
+
+    template<typename T>
+    void recv(T* data, size_t count) {
+        metrics::ScopedTimer timer(metrics::Stage::NetworkWait);
+        chl_.recv(data, count);
+        countReceived(count * sizeof(T));
+    }
+
+    // 记入经 raw() 完成的传输；模块调用内部的多条消息按 messages 条计
+    void countSent(uint64_t bytes, uint64_t messages = 1) {
+        comm_.addSent(bytes);
+        metrics::countSent(bytes, messages);
+    }
+
+    void countReceived(uint64_t bytes, uint64_t messages = 1) {
+        comm_.addReceived(bytes);
+        metrics::countReceived(bytes, messages);
+    }
+
+    osuCrypto::Channel& raw() { return chl_; }
+    CommStats& comm() { return comm_; }
+
+private:
+    // 连续容器按元素总大小计，其余按对象大小计
+    template<typename T>
+    static uint64_t payloadBytes(const T& value) {
+        using U = std::remove_cv_t<std::remove_reference_t<T>>;
+        if constexpr (requires { value.data(); value.size(); }) {
+            return static_cast<uint64_t>(value.size()) * sizeof(*value.data());
+        } else {
+            static_assert(std::is_trivially_copyable_v<U>, "unsupported channel payload");
+            return sizeof(U);
+        }
+    }
+
+    osuCrypto::Channel& chl_;
+    CommStats& comm_;
+};
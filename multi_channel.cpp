@@ -0,0 +1,85 @@
+#include "multi_channel.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace multi_channel {
+
+int extractThreadsFlag(int& argc, char** argv, int default_threads) {
+    int threads = default_threads;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("--threads requires a value");
+            }
+            threads = std::atoi(argv[++i]);
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    return std::max(threads, 1);
+}
+
+std::vector<Channel> open(Session& session, Channel& control, int requested) {
+    uint32_t mine = static_cast<uint32_t>(std::max(requested, 1));
+    uint32_t peer = 0;
+    control.send(mine);
+    control.recv(peer);
+
+    int count = static_cast<int>(std::max<uint32_t>(std::min(mine, peer), 1));
+
+    std::vector<Channel> channels;
+    channels.reserve(count);
+    channels.push_back(control);
+    for (int t = 1; t < count; ++t) {
+        std::string name = "online_" + std::to_string(t);
+        channels.push_back(session.addChannel(name, name));
+    }
+    return channels;
+}
+
+void run(std::vector<Channel>& channels, const std::function<void(int, Channel&)>& fn) {
+    std::vector<std::exception_ptr> errors(channels.size());
+    std::vector<std::thread> threads;
+
+    // 第 0 个信道在调用线程上执行
+    for (size_t t = 1; t < channels.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            try {
+                fn(static_cast<int>(t), channels[t]);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+
+    try {
+        fn(0, channels[0]);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void splitRange(int total, int parts, int t, int& begin, int& end) {
+    int base = total / parts;
+    int extra = total % parts;
+    begin = t * base + std::min(t, extra);
+    end = begin + base + (t < extra ? 1 : 0);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include "cryptoTools/Network/Channel.h"
+#include "cryptoTools/Network/Session.h"
+
+using namespace osuCrypto;
+
+// 多信道在线阶段的辅助函数
+namespace multi_channel {
+    // 从命令行中取出 "--threads N"（会从 argv 中移除，剩余参数保持原有位置含义）。
+    // 未指定时返回 default_threads
+    int extractThreadsFlag(int& argc, char** argv, int default_threads = 1);
+
+    // 双方在 control 信道上交换各自请求的线程数，取较小者，
+    // 再在同一 Session 上打开其余信道。返回的第 0 个信道即 control
+    std::vector<Channel> open(Session& session, Channel& control, int requested);
+
+    // 每个信道一个线程并发执行 fn(t, channels[t])，任一线程的异常在全部结束后重新抛出
+    void run(std::vector<Channel>& channels, const std::function<void(int, Channel&)>& fn);
+
+    // 第 t 个线程负责的查询区间 [begin, end)，各区间连续且大小相差不超过 1
+    void splitRange(int total, int parts, int t, int& begin, int& end);
+}
@@ -0,0 +1,269 @@
+#include "offline_cache.h"
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'F', 'P', 'S', 'I', 'C', 'A', 'C', 'H'};
+const char* MANIFEST_NAME = "manifest";
+const size_t HASH_CHUNK = 1 << 20;
+
+block hashBytes(const uint8_t* data, size_t size) {
+    ContentHasher hasher;
+    hasher.update(data, size);
+    return hasher.final();
+}
+
+template<typename T>
+bool readValue(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template<typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+}
+
+block ContentHasher::final() {
+    block digest(0, 0);
+    oracle_.Final(digest);
+    return digest;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open cache file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat cache file: " + path);
+    }
+
+    length_ = static_cast<size_t>(st.st_size);
+    if (length_ == 0) {
+        ::close(fd);
+        return;
+    }
+
+    base_ = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        length_ = 0;
+        throw std::runtime_error("mmap failed for cache file: " + path);
+    }
+    madvise(base_, length_, MADV_SEQUENTIAL);
+}
+
+void MappedFile::close() {
+    if (base_) {
+        munmap(base_, length_);
+    }
+    base_ = nullptr;
+    length_ = 0;
+}
+
+OfflineCache::Writer::Writer(OfflineCache& cache, const std::string& name)
+    : cache_(cache), name_(name),
+      out_(cache.stagingPath(name), std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("Cannot create cache file: " + cache.stagingPath(name));
+    }
+}
+
+void OfflineCache::Writer::write(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error("Failed to write cache file: " + cache_.stagingPath(name_));
+    }
+    hasher_.update(data, size);
+    size_ += size;
+}
+
+void OfflineCache::Writer::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Failed to write cache file: " + cache_.stagingPath(name_));
+    }
+    std::filesystem::rename(cache_.stagingPath(name_), cache_.path(name_));
+    cache_.record(name_, size_, hasher_.final());
+}
+
+OfflineCache::OfflineCache(std::string dir) : dir_(std::move(dir)) {}
+
+std::string OfflineCache::extractDirFlag(int& argc, char** argv) {
+    std::string dir;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--cache") == 0) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("--cache requires a directory");
+            }
+            dir = argv[++i];
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    return dir;
+}
+
+std::string OfflineCache::path(const std::string& name) const {
+    return dir_ + "/" + name;
+}
+
+std::string OfflineCache::stagingPath(const std::string& name) const {
+    return path(name) + ".tmp";
+}
+
+bool OfflineCache::open(const block& state) {
+    entries_.clear();
+    if (!enabled()) {
+        return false;
+    }
+
+    std::ifstream in(path(MANIFEST_NAME), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t version = 0, count = 0;
+    block stored(0, 0);
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        !readValue(in, version) || version != VERSION ||
+        !readValue(in, count) || !readValue(in, stored) || stored != state) {
+        return false;
+    }
+
+    std::vector<Entry> entries(count);
+    for (auto& entry : entries) {
+        uint32_t name_len = 0;
+        if (!readValue(in, name_len) || name_len > 4096) {
+            return false;
+        }
+        entry.name.resize(name_len);
+        if (!in.read(entry.name.data(), name_len) ||
+            !readValue(in, entry.size) || !readValue(in, entry.hash)) {
+            return false;
+        }
+    }
+
+    entries_ = std::move(entries);
+    return true;
+}
+
+void OfflineCache::map(const std::string& name, MappedFile& file) const {
+    const Entry* entry = find(name);
+    if (!entry) {
+        throw std::runtime_error("Cache entry missing: " + name);
+    }
+
+    file.open(path(name));
+    if (file.size() != entry->size || hashBytes(file.data(), file.size()) != entry->hash) {
+        file.close();
+        throw std::runtime_error("Cache entry corrupted: " + name);
+    }
+}
+
+void OfflineCache::begin() {
+    entries_.clear();
+    std::filesystem::create_directories(dir_);
+    std::filesystem::remove(path(MANIFEST_NAME));
+}
+
+void OfflineCache::put(const std::string& name, const void* data, size_t size) {
+    Writer writer = create(name);
+    writer.write(data, size);
+    writer.close();
+}
+
+void OfflineCache::adopt(const std::string& name) {
+    std::string staging = stagingPath(name);
+    std::ifstream in(staging, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open cache file: " + staging);
+    }
+
+    ContentHasher hasher;
+    std::vector<char> chunk(HASH_CHUNK);
+    uint64_t size = 0;
+    while (in) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        size_t got = static_cast<size_t>(in.gcount());
+        hasher.update(chunk.data(), got);
+        size += got;
+    }
+    in.close();
+
+    std::filesystem::rename(staging, path(name));
+    record(name, size, hasher.final());
+}
+
+void OfflineCache::commit(const block& state) {
+    std::string staging = stagingPath(MANIFEST_NAME);
+    {
+        std::ofstream out(staging, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot create cache manifest: " + staging);
+        }
+
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, static_cast<uint32_t>(entries_.size()));
+        writeValue(out, state);
+        for (const auto& entry : entries_) {
+            writeValue(out, static_cast<uint32_t>(entry.name.size()));
+            out.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+            writeValue(out, entry.size);
+            writeValue(out, entry.hash);
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write cache manifest: " + staging);
+        }
+    }
+    std::filesystem::rename(staging, path(MANIFEST_NAME));
+}
+
+void OfflineCache::record(const std::string& name, uint64_t size, const block& hash) {
+    for (auto& entry : entries_) {
+        if (entry.name == name) {
+            entry.size = size;
+            entry.hash = hash;
+            return;
+        }
+    }
+    entries_.push_back({name, size, hash});
+}
+
+const OfflineCache::Entry* OfflineCache::find(const std::string& name) const {
+    for (const auto& entry : entries_) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
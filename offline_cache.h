@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/RandomOracle.h"
+
+using namespace osuCrypto;
+
+// 增量内容哈希（Blake2，128 位）
+class ContentHasher {
+public:
+    ContentHasher() : oracle_(sizeof(block)) {}
+
+    void update(const void* data, size_t size) {
+        oracle_.Update(static_cast<const uint8_t*>(data), size);
+    }
+    void update(const std::string& bytes) { update(bytes.data(), bytes.size()); }
+
+    template<typename T>
+    void updateValue(const T& value) { update(&value, sizeof(T)); }
+
+    block final();
+
+private:
+    RandomOracle oracle_;
+};
+
+// 只读内存映射的缓存产物
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    void open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(base_); }
+    size_t size() const { return length_; }
+
+private:
+    void* base_ = nullptr;
+    size_t length_ = 0;
+};
+
+// 离线状态缓存目录（小端）：
+//   <dir>/manifest   ["FPSICACH"][u32 version][u32 entries][block state]
+//                    每个产物一项：[u32 name_len][name][u64 size][block content_hash]
+//   <dir>/<name>     产物本身（密钥、OKVS 编码、打包密文库、E-LSH 参数等）
+// state 由调用方对参数和数据求哈希得到。manifest 最后写入且先写临时文件再 rename，
+// 写入中途退出时目录里没有有效的 manifest；读取产物时重新计算内容哈希并与 manifest 比对。
+class OfflineCache {
+public:
+    static constexpr uint32_t VERSION = 3;
+
+    // 流式写入一个产物，边写边累计内容哈希；close() 后产物登记到缓存
+    class Writer {
+    public:
+        void write(const void* data, size_t size);
+
+        template<typename T>
+        void writeValue(const T& value) { write(&value, sizeof(T)); }
+
+        void close();
+
+    private:
+        friend class OfflineCache;
+        Writer(OfflineCache& cache, const std::string& name);
+
+        OfflineCache& cache_;
+        std::string name_;
+        std::ofstream out_;
+        ContentHasher hasher_;
+        uint64_t size_ = 0;
+        bool closed_ = false;
+    };
+
+    // dir 为空表示不使用缓存
+    explicit OfflineCache(std::string dir = "");
+
+    // 从命令行中取出 "--cache DIR"（会从 argv 中移除），未指定时返回空串
+    static std::string extractDirFlag(int& argc, char** argv);
+
+    bool enabled() const { return !dir_.empty(); }
+    const std::string& dir() const { return dir_; }
+
+    // 产物文件路径（只应在 map 校验通过后按路径读取）
+    std::string path(const std::string& name) const;
+
+    // 读取 manifest：版本与 state 均一致时返回 true，之后可以读取产物
+    bool open(const block& state);
+
+    // 映射产物并校验大小与内容哈希，不一致或产物不存在时抛出异常
+    void map(const std::string& name, MappedFile& file) const;
+
+    // 开始重建缓存：删除旧的 manifest，已登记的产物清空
+    void begin();
+
+    // 一次性写入一个产物
+    void put(const std::string& name, const void* data, size_t size);
+    void put(const std::string& name, const std::string& bytes) {
+        put(name, bytes.data(), bytes.size());
+    }
+    Writer create(const std::string& name) { return Writer(*this, name); }
+
+    // 由外部代码写在 stagingPath(name) 的产物：计算内容哈希后登记
+    std::string stagingPath(const std::string& name) const;
+    void adopt(const std::string& name);
+
+    // 全部产物写完后写入 manifest，缓存生效
+    void commit(const block& state);
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t size = 0;
+        block hash = block(0, 0);
+    };
+
+    void record(const std::string& name, uint64_t size, const block& hash);
+    const Entry* find(const std::string& name) const;
+
+    std::string dir_;
+    std::vector<Entry> entries_;
+};
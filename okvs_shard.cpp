@@ -0,0 +1,454 @@
+#include "okvs_shard.h"
+#include "band_okvs.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace band_okvs;
+
+int ShardedOkvs::bandLength(size_t n) {
+    if (n <= (1 << 14)) return 339;
+    else if (n <= (1 << 16)) return 350;
+    else if (n <= (1 << 18)) return 366;
+    else if (n <= (1 << 20)) return 377;
+    else if (n <= (1 << 22)) return 396;
+    else if (n <= (1 << 24)) return 413;
+    else throw std::runtime_error("No valid band length for OKVS");
+}
+
+int ShardedOkvs::chooseShardCount(size_t total_items, int threads) {
+    size_t by_size = (total_items + MAX_SHARD_ITEMS - 1) / MAX_SHARD_ITEMS;
+    size_t by_threads = std::min<size_t>(std::max(threads, 1),
+                                         total_items / MIN_SHARD_ITEMS);
+    return static_cast<int>(std::max<size_t>({by_size, by_threads, 1}));
+}
+
+int ShardedOkvs::shardOf(const block& key, int num_shards) {
+    if (num_shards <= 1) {
+        return 0;
+    }
+
+    // 混合两个 64 位半部分（splitmix64 终结函数），再用乘法映射到 [0, num_shards)
+    uint64_t z = key.get<uint64_t>(0) ^ (key.get<uint64_t>(1) * 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+
+    return static_cast<int>((static_cast<unsigned __int128>(z) * num_shards) >> 64);
+}
+
+void ShardedOkvs::partition(const block* keys, const block* values, size_t n,
+                            int num_shards) {
+    // 两遍划分：先统计每个分片的键数，再按前缀和把键值散列到连续区间
+    std::vector<int> shard_of(n);
+    staged_offsets_.assign(num_shards + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        shard_of[i] = shardOf(keys[i], num_shards);
+        ++staged_offsets_[shard_of[i] + 1];
+    }
+    for (int s = 0; s < num_shards; ++s) {
+        staged_offsets_[s + 1] += staged_offsets_[s];
+    }
+
+    staged_keys_.resize(n);
+    staged_values_.resize(n);
+    std::vector<size_t> cursor(staged_offsets_.begin(), staged_offsets_.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        size_t pos = cursor[shard_of[i]]++;
+        staged_keys_[pos] = keys[i];
+        staged_values_[pos] = values[i];
+    }
+
+    shards_.assign(num_shards, OkvsShard());
+}
+
+void ShardedOkvs::encodeShard(int s, block seed) {
+    size_t begin = staged_offsets_[s];
+    size_t count = staged_offsets_[s + 1] - begin;
+    if (count > MAX_SHARD_ITEMS) {
+        throw std::runtime_error("OKVS shard too large");
+    }
+
+    encodeInto(shards_[s], staged_keys_.data() + begin, staged_values_.data() + begin,
+               count, seed, s);
+}
+
+OkvsShard ShardedOkvs::encodeSingle(const block* keys, const block* values, size_t n,
+                                    block seed) {
+    OkvsShard shard;
+    encodeInto(shard, keys, values, n, seed, 0);
+    return shard;
+}
+
+void ShardedOkvs::encodeInto(OkvsShard& shard, const block* keys, const block* values,
+                             size_t count, block seed, int s) {
+    metrics::ScopedTimer timer(metrics::Stage::OkvsEncode);
+    shard.n_items = static_cast<int>(count);
+    shard.band_length = bandLength(count);
+    shard.m = std::max(static_cast<int>((1 + EPSILON) * count), shard.band_length);
+
+    if (count == 0) {
+        shard.seed = seed;
+        shard.encoding.assign(shard.m, block(0, 0));
+        return;
+    }
+
+    // band OKVS 以很小的概率编码失败，换种子重试
+    const int kMaxAttempts = 4;
+    for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+        shard.seed = seed ^ block(static_cast<uint64_t>(s), static_cast<uint64_t>(attempt));
+
+        BandOkvs okvs;
+        okvs.Init(shard.n_items, shard.m, shard.band_length, shard.seed);
+        shard.encoding.resize(okvs.Size());
+
+        if (okvs.Encode(keys, values, shard.encoding.data())) {
+            return;
+        }
+    }
+
+    throw std::runtime_error("OKVS encoding failed for shard " + std::to_string(s));
+}
+
+void ShardedOkvs::encode(const block* keys, const block* values, size_t n,
+                         int num_shards, block seed, ThreadPool* pool) {
+    if (num_shards <= 0) {
+        num_shards = chooseShardCount(n, pool ? pool->size() : 1);
+    }
+
+    partition(keys, values, n, num_shards);
+
+    if (pool) {
+        pool->parallelFor(num_shards, 1, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s) {
+                encodeShard(static_cast<int>(s), seed);
+            }
+        });
+    } else {
+        for (int s = 0; s < num_shards; ++s) {
+            encodeShard(s, seed);
+        }
+    }
+
+    staged_keys_ = {};
+    staged_values_ = {};
+}
+
+uint64_t ShardedOkvs::encodeAndSend(const block* keys, const block* values, size_t n,
+                                    int num_shards, block seed, ThreadPool& pool,
+                                    Channel& chl) {
+    if (num_shards <= 0) {
+        num_shards = chooseShardCount(n, pool.size());
+    }
+
+    partition(keys, values, n, num_shards);
+
+    // 线程池没有工作线程时 submit 的任务无人执行，退化为在发送循环中逐片编码
+    bool inline_encode = pool.size() <= 1;
+    std::vector<std::future<void>> pending;
+    if (!inline_encode) {
+        pending.reserve(num_shards);
+        for (int s = 0; s < num_shards; ++s) {
+            pending.push_back(pool.submit([this, s, seed]() { encodeShard(s, seed); }));
+        }
+    }
+
+    chl.asyncSend(std::vector<uint32_t>{static_cast<uint32_t>(num_shards)});
+    uint64_t bytes = sizeof(uint32_t);
+
+    // 按分片顺序发送：分片 s 发送时，后续分片仍在其他线程上编码。
+    // 编码结果保存在 shards_ 中，异步发送期间保持有效
+    try {
+        for (int s = 0; s < num_shards; ++s) {
+            if (inline_encode) {
+                encodeShard(s, seed);
+            } else {
+                pending[s].get();
+            }
+
+            const OkvsShard& shard = shards_[s];
+            chl.asyncSend(packHeader(shard));
+            chl.asyncSend(shard.encoding.data(), shard.encoding.size());
+            bytes += HEADER_BYTES + shard.encoding.size() * sizeof(block);
+        }
+    } catch (...) {
+        // 其余分片的编码任务仍在读 staged_keys_ / staged_values_ 和写 shards_，
+        // 必须等它们全部结束后才能让异常离开本函数
+        for (auto& task : pending) {
+            if (task.valid()) {
+                task.wait();
+            }
+        }
+        throw;
+    }
+
+    staged_keys_ = {};
+    staged_values_ = {};
+    return bytes;
+}
+
+size_t ShardedOkvs::dropDuplicateKeys(std::vector<block>& keys, std::vector<block>& values) {
+    // 按 (键, 原下标) 排序，每组相同的键中只有下标最小的保留
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [&](size_t a, size_t b) {
+        uint64_t ha = keys[a].get<uint64_t>(1), hb = keys[b].get<uint64_t>(1);
+        if (ha != hb) {
+            return ha < hb;
+        }
+        uint64_t la = keys[a].get<uint64_t>(0), lb = keys[b].get<uint64_t>(0);
+        return la != lb ? la < lb : a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<uint8_t> keep(keys.size(), 0);
+    for (size_t r = 0; r < order.size(); ++r) {
+        keep[order[r]] = r == 0 || keys[order[r]] != keys[order[r - 1]];
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keep[i]) {
+            keys[kept] = keys[i];
+            values[kept] = values[i];
+            ++kept;
+        }
+    }
+    keys.resize(kept);
+    values.resize(kept);
+    return kept;
+}
+
+block ShardedOkvs::decode(const block& key) const {
+    block value(0, 0);
+    decodeRange(shards_[shardOf(key, numShards())], &key, 1, &value);
+    return value;
+}
+
+void ShardedOkvs::decodeRange(const OkvsShard& shard, const block* keys, size_t count,
+                              block* out) {
+    if (count == 0) {
+        return;
+    }
+
+    metrics::ScopedTimer timer(metrics::Stage::OkvsDecode);
+    BandOkvs okvs;
+    okvs.Init(static_cast<int>(count), shard.m, shard.band_length, shard.seed);
+    okvs.Decode(keys, shard.encoding.data(), out);
+}
+
+void ShardedOkvs::decodeShardBatch(const OkvsShard& shard, const block* keys, size_t n,
+                                   block* out, ThreadPool* pool) {
+    auto run = [&](size_t begin, size_t end) {
+        decodeRange(shard, keys + begin, end - begin, out + begin);
+    };
+
+    if (pool) {
+        pool->parallelFor(n, DECODE_CHUNK, run);
+    } else {
+        for (size_t begin = 0; begin < n; begin += DECODE_CHUNK) {
+            run(begin, std::min(begin + DECODE_CHUNK, n));
+        }
+    }
+}
+
+void ShardedOkvs::decodeBatch(const block* keys, size_t n, block* out,
+                              ThreadPool* pool) const {
+    int num_shards = numShards();
+    if (num_shards == 0) {
+        throw std::runtime_error("OKVS not initialized");
+    }
+    if (num_shards == 1) {
+        decodeShardBatch(shards_[0], keys, n, out, pool);
+        return;
+    }
+
+    // 与编码相同的两遍划分，把键按分片聚成连续区间
+    std::vector<int> shard_of(n);
+    std::vector<size_t> offsets(num_shards + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        shard_of[i] = shardOf(keys[i], num_shards);
+        ++offsets[shard_of[i] + 1];
+    }
+    for (int s = 0; s < num_shards; ++s) {
+        offsets[s + 1] += offsets[s];
+    }
+
+    std::vector<block> grouped_keys(n);
+    std::vector<size_t> origin(n);
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        size_t pos = cursor[shard_of[i]]++;
+        grouped_keys[pos] = keys[i];
+        origin[pos] = i;
+    }
+
+    // 任务为 (分片, 区间)，每个任务不跨分片
+    struct Task {
+        int shard;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Task> tasks;
+    for (int s = 0; s < num_shards; ++s) {
+        for (size_t begin = offsets[s]; begin < offsets[s + 1]; begin += DECODE_CHUNK) {
+            tasks.push_back({s, begin, std::min(begin + DECODE_CHUNK, offsets[s + 1])});
+        }
+    }
+
+    std::vector<block> grouped_out(n);
+    auto run = [&](size_t t_begin, size_t t_end) {
+        for (size_t t = t_begin; t < t_end; ++t) {
+            const Task& task = tasks[t];
+            decodeRange(shards_[task.shard], grouped_keys.data() + task.begin,
+                        task.end - task.begin, grouped_out.data() + task.begin);
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(tasks.size(), 1, run);
+    } else {
+        run(0, tasks.size());
+    }
+
+    for (size_t pos = 0; pos < n; ++pos) {
+        out[origin[pos]] = grouped_out[pos];
+    }
+}
+
+size_t ShardedOkvs::totalSize() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.encoding.size();
+    }
+    return total;
+}
+
+size_t ShardedOkvs::numItems() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.n_items;
+    }
+    return total;
+}
+
+std::vector<uint8_t> ShardedOkvs::packHeader(const OkvsShard& shard) {
+    std::vector<uint8_t> header(HEADER_BYTES);
+    uint64_t size = shard.encoding.size();
+
+    uint8_t* p = header.data();
+    std::memcpy(p, &shard.n_items, sizeof(int));        p += sizeof(int);
+    std::memcpy(p, &shard.m, sizeof(int));              p += sizeof(int);
+    std::memcpy(p, &shard.band_length, sizeof(int));    p += sizeof(int);
+    std::memcpy(p, &shard.seed, sizeof(block));         p += sizeof(block);
+    std::memcpy(p, &size, sizeof(uint64_t));
+
+    return header;
+}
+
+void ShardedOkvs::unpackHeader(const std::vector<uint8_t>& header, OkvsShard& shard,
+                               uint64_t& size) {
+    if (header.size() != HEADER_BYTES) {
+        throw std::runtime_error("Invalid OKVS shard header");
+    }
+
+    const uint8_t* p = header.data();
+    std::memcpy(&shard.n_items, p, sizeof(int));        p += sizeof(int);
+    std::memcpy(&shard.m, p, sizeof(int));              p += sizeof(int);
+    std::memcpy(&shard.band_length, p, sizeof(int));    p += sizeof(int);
+    std::memcpy(&shard.seed, p, sizeof(block));         p += sizeof(block);
+    std::memcpy(&size, p, sizeof(uint64_t));
+}
+
+void ShardedOkvs::writeFlat(const std::function<void(const void*, size_t)>& write) const {
+    uint32_t num_shards = static_cast<uint32_t>(shards_.size());
+    write(&num_shards, sizeof(uint32_t));
+    for (const auto& shard : shards_) {
+        std::vector<uint8_t> header = packHeader(shard);
+        write(header.data(), header.size());
+        write(shard.encoding.data(), shard.encoding.size() * sizeof(block));
+    }
+}
+
+void ShardedOkvs::loadFlat(const uint8_t* data, size_t size) {
+    uint32_t num_shards = 0;
+    if (size < sizeof(uint32_t)) {
+        throw std::runtime_error("Truncated sharded OKVS");
+    }
+    std::memcpy(&num_shards, data, sizeof(uint32_t));
+    size_t offset = sizeof(uint32_t);
+
+    shards_.assign(num_shards, OkvsShard());
+    for (uint32_t s = 0; s < num_shards; ++s) {
+        if (size - offset < HEADER_BYTES) {
+            throw std::runtime_error("Truncated sharded OKVS");
+        }
+        uint64_t count = 0;
+        unpackHeader(std::vector<uint8_t>(data + offset, data + offset + HEADER_BYTES),
+                     shards_[s], count);
+        offset += HEADER_BYTES;
+        if (count > (size - offset) / sizeof(block)) {
+            throw std::runtime_error("Truncated sharded OKVS");
+        }
+        shards_[s].encoding.resize(count);
+        std::memcpy(shards_[s].encoding.data(), data + offset, count * sizeof(block));
+        offset += count * sizeof(block);
+    }
+    if (offset != size) {
+        throw std::runtime_error("Sharded OKVS size mismatch");
+    }
+}
+
+uint64_t ShardedOkvs::send(Channel& chl) const {
+    uint32_t num_shards = static_cast<uint32_t>(shards_.size());
+    chl.send(num_shards);
+    uint64_t bytes = sizeof(uint32_t);
+
+    for (const auto& shard : shards_) {
+        bytes += sendShard(chl, shard);
+    }
+
+    return bytes;
+}
+
+uint64_t ShardedOkvs::sendShard(Channel& chl, const OkvsShard& shard) {
+    metrics::ScopedTimer timer(metrics::Stage::NetworkSend);
+    chl.send(packHeader(shard));
+    chl.send(shard.encoding.data(), shard.encoding.size());
+    return HEADER_BYTES + shard.encoding.size() * sizeof(block);
+}
+
+uint64_t ShardedOkvs::receiveShard(Channel& chl, OkvsShard& shard) {
+    metrics::ScopedTimer timer(metrics::Stage::NetworkWait);
+    std::vector<uint8_t> header;
+    uint64_t size = 0;
+
+    chl.recv(header);
+    unpackHeader(header, shard, size);
+
+    shard.encoding.resize(size);
+    chl.recv(shard.encoding.data(), size);
+    return HEADER_BYTES + size * sizeof(block);
+}
+
+uint64_t ShardedOkvs::receive(Channel& chl, const std::function<void(int)>& on_shard) {
+    uint32_t num_shards = 0;
+    chl.recv(num_shards);
+    uint64_t bytes = sizeof(uint32_t);
+
+    shards_.assign(num_shards, OkvsShard());
+    for (uint32_t s = 0; s < num_shards; ++s) {
+        bytes += receiveShard(chl, shards_[s]);
+
+        if (on_shard) {
+            on_shard(static_cast<int>(s));
+        }
+    }
+
+    return bytes;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "cryptoTools/Common/Defines.h"
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Network/Channel.h"
+#include "thread_pool.h"
+
+using namespace osuCrypto;
+
+// 单个 band OKVS 分片
+struct OkvsShard {
+    int n_items = 0;            // 编码的键值对数量
+    int m = 0;                  // 编码长度（block 个数）
+    int band_length = 0;        // band 宽度
+    block seed = block(0, 0);   // 哈希种子
+    std::vector<block> encoding;
+};
+
+// 分片 OKVS：键按哈希划分到 K 个相互独立的 band OKVS 中。
+// 每个分片不超过 MAX_SHARD_ITEMS 个键，因此不受 band 宽度表 2^24 上限的限制；
+// 分片之间可以并行编码，解码时只需访问键所在的分片。
+class ShardedOkvs {
+public:
+    static constexpr size_t MAX_SHARD_ITEMS = 1 << 20;
+    static constexpr size_t MIN_SHARD_ITEMS = 1 << 14;
+    static constexpr double EPSILON = 0.05;
+
+    // 根据键数量选择 band 宽度；超过 2^24 时抛出异常
+    static int bandLength(size_t n);
+
+    // 自动选择分片数：保证单分片不超过 MAX_SHARD_ITEMS，
+    // 数据量足够时分片数不少于线程数以便并行编码
+    static int chooseShardCount(size_t total_items, int threads);
+
+    // 键所在的分片（双方必须使用同一函数）
+    static int shardOf(const block& key, int num_shards);
+
+    // band OKVS 不能编码重复的键：相同的键只保留第一次出现的键值对（其余保持原有顺序），返回剩余个数
+    static size_t dropDuplicateKeys(std::vector<block>& keys, std::vector<block>& values);
+
+    // 编码 n 个键值对；num_shards <= 0 时自动选择。任一分片重试后仍失败则抛出异常
+    void encode(const block* keys, const block* values, size_t n,
+                int num_shards, block seed, ThreadPool* pool = nullptr);
+
+    // 编码为单个不分片的 band OKVS（不受 MAX_SHARD_ITEMS 限制），重试后仍失败则抛出异常
+    static OkvsShard encodeSingle(const block* keys, const block* values, size_t n, block seed);
+
+    // 流水线版本：各分片在线程池上并行编码，每编码完一个分片就异步发送，
+    // 编码与传输相互重叠。返回发送的字节数
+    uint64_t encodeAndSend(const block* keys, const block* values, size_t n,
+                           int num_shards, block seed, ThreadPool& pool, Channel& chl);
+
+    // 解码单个键（只访问该键所在的分片）
+    block decode(const block& key) const;
+
+    // 批量解码 n 个键：按分片分组后以 DECODE_CHUNK 个键为单位整批调用 band 解码，
+    // pool 非空时各块并行。out[i] 为 keys[i] 的解码值
+    void decodeBatch(const block* keys, size_t n, block* out, ThreadPool* pool = nullptr) const;
+
+    // 在单个分片上批量解码（供未分片的 OKVS 使用）
+    static void decodeShardBatch(const OkvsShard& shard, const block* keys, size_t n,
+                                 block* out, ThreadPool* pool = nullptr);
+
+    static constexpr size_t DECODE_CHUNK = 1 << 14;
+
+    int numShards() const { return static_cast<int>(shards_.size()); }
+    const OkvsShard& shard(int s) const { return shards_[s]; }
+
+    // 所有分片编码的键值对总数
+    size_t numItems() const;
+
+    // 所有分片编码的 block 总数
+    size_t totalSize() const;
+
+    // 依次发送分片数量以及每个分片的参数和编码，返回发送的字节数
+    uint64_t send(Channel& chl) const;
+
+    // 接收全部分片，返回接收的字节数。
+    // on_shard 在每个分片接收完成后立即以分片下标调用，可用于边收边处理
+    uint64_t receive(Channel& chl, const std::function<void(int)>& on_shard = nullptr);
+
+    // 收发单个分片（参数头 + 编码），返回字节数
+    static uint64_t sendShard(Channel& chl, const OkvsShard& shard);
+    static uint64_t receiveShard(Channel& chl, OkvsShard& shard);
+
+    // 平坦存储格式：[u32 分片数][分片头 0][encoding 0]...，分片头与 send 使用的相同。
+    // 供离线缓存写入文件，之后可以从 mmap 的内存直接读回；
+    // writeFlat 依次把各段字节交给 write，避免另外拷贝一份编码
+    void writeFlat(const std::function<void(const void*, size_t)>& write) const;
+    void loadFlat(const uint8_t* data, size_t size);
+
+private:
+    // 按分片划分键值对，结果暂存在 staged_* 中
+    void partition(const block* keys, const block* values, size_t n, int num_shards);
+
+    // 对同一分片内连续的 count 个键做一次 band 解码
+    static void decodeRange(const OkvsShard& shard, const block* keys, size_t count, block* out);
+
+    // 编码第 s 个分片（可在不同线程上并发调用不同的 s）
+    void encodeShard(int s, block seed);
+
+    // 把 count 个键值对编码进 shard，失败时换种子重试；s 只用于区分种子与错误信息
+    static void encodeInto(OkvsShard& shard, const block* keys, const block* values,
+                           size_t count, block seed, int s);
+
+    // 分片参数头：n_items, m, band_length, seed, encoding size
+    static std::vector<uint8_t> packHeader(const OkvsShard& shard);
+    static void unpackHeader(const std::vector<uint8_t>& header, OkvsShard& shard, uint64_t& size);
+    static constexpr size_t HEADER_BYTES = sizeof(int) * 3 + sizeof(block) + sizeof(uint64_t);
+
+    std::vector<OkvsShard> shards_;
+
+    std::vector<block> staged_keys_;
+    std::vector<block> staged_values_;
+    std::vector<size_t> staged_offsets_;
+};
@@ -0,0 +1,157 @@
+#include "ot_extension.h"
+#include <stdexcept>
+#include "cryptoTools/Common/BitVector.h"
+#include "libOTe/TwoChooseOne/Iknp/IknpOtExtSender.h"
+#include "libOTe/TwoChooseOne/Iknp/IknpOtExtReceiver.h"
+#include "coproto/coproto.h"
+
+namespace {
+
+// 在 cryptoTools Channel 上驱动 coproto 协议。双方每轮各发一帧 [done][缓冲的出站数据]，
+// 再接收对方一帧；两端在同一轮看到双方都已完成时一起退出。
+template<typename Proto>
+void runOverChannel(Proto&& proto, coproto::BufferingSocket& sock, Channel& chl) {
+    auto task = std::move(proto) | macoro::make_eager();
+
+    while (true) {
+        uint8_t done = task.is_ready() ? 1 : 0;
+        auto out = sock.getOutbound();
+
+        std::vector<uint8_t> frame(1, done);
+        if (out) {
+            frame.insert(frame.end(), out->begin(), out->end());
+        }
+        chl.asyncSend(std::move(frame));
+
+        std::vector<uint8_t> in;
+        chl.recv(in);
+        if (in.empty()) {
+            throw std::runtime_error("Empty OT extension frame");
+        }
+        if (in.size() > 1) {
+            sock.processInbound(std::span<uint8_t>(in.data() + 1, in.size() - 1));
+        }
+        if (done && in[0]) {
+            break;
+        }
+    }
+
+    // 重新抛出协议内部的异常
+    macoro::sync_wait(std::move(task));
+}
+
+// 由随机 OT 密钥扩展出 msg_bytes 字节的一次性密钥流，与 dst 异或
+void xorPad(block key, const uint8_t* src, size_t msg_bytes, uint8_t* dst) {
+    std::vector<uint8_t> pad(msg_bytes);
+    PRNG expand(key);
+    expand.get(pad.data(), msg_bytes);
+    for (size_t i = 0; i < msg_bytes; ++i) {
+        dst[i] = src[i] ^ pad[i];
+    }
+}
+
+uint8_t getBit(const std::vector<uint8_t>& bytes, size_t i) {
+    return (bytes[i >> 3] >> (i & 7)) & 1;
+}
+
+}
+
+void BatchOTSender::setup(size_t count, Channel& chl, PRNG& prng) {
+    keys_.assign(count, {});
+    if (count == 0) {
+        return;
+    }
+
+    osuCrypto::IknpOtExtSender sender;
+    coproto::BufferingSocket sock;
+    runOverChannel(sender.genBaseOts(prng, sock), sock, chl);
+    runOverChannel(sender.send(keys_, prng, sock), sock, chl);
+}
+
+void BatchOTSender::sendBatch(size_t offset,
+                              const std::vector<std::vector<uint8_t>>& msgs0,
+                              const std::vector<std::vector<uint8_t>>& msgs1,
+                              size_t msg_bytes, Channel& chl,
+                              uint64_t* bytes_sent,
+                              uint64_t* bytes_received) const {
+    size_t count = msgs0.size();
+    if (msgs1.size() != count) {
+        throw std::runtime_error("OT message count mismatch");
+    }
+    if (offset + count > keys_.size()) {
+        throw std::runtime_error("Not enough precomputed OTs");
+    }
+
+    // Receiver 的纠正比特 d_i = b_i ⊕ c_i
+    std::vector<uint8_t> corrections((count + 7) / 8);
+    chl.recv(corrections.data(), corrections.size());
+
+    // 对每个传输：y0 = m0 ⊕ H(k_{d}), y1 = m1 ⊕ H(k_{1⊕d})
+    std::vector<uint8_t> payload(count * 2 * msg_bytes);
+    for (size_t i = 0; i < count; ++i) {
+        if (msgs0[i].size() != msg_bytes || msgs1[i].size() != msg_bytes) {
+            throw std::runtime_error("OT message length mismatch");
+        }
+        uint8_t d = getBit(corrections, i);
+        const auto& keys = keys_[offset + i];
+        uint8_t* y = payload.data() + i * 2 * msg_bytes;
+        xorPad(keys[d], msgs0[i].data(), msg_bytes, y);
+        xorPad(keys[d ^ 1], msgs1[i].data(), msg_bytes, y + msg_bytes);
+    }
+    chl.send(payload.data(), payload.size());
+
+    if (bytes_sent) *bytes_sent += payload.size();
+    if (bytes_received) *bytes_received += corrections.size();
+}
+
+void BatchOTReceiver::setup(size_t count, Channel& chl, PRNG& prng) {
+    keys_.assign(count, block(0, 0));
+    choices_.assign(count, 0);
+    if (count == 0) {
+        return;
+    }
+
+    osuCrypto::BitVector choices(count);
+    choices.randomize(prng);
+
+    osuCrypto::IknpOtExtReceiver receiver;
+    coproto::BufferingSocket sock;
+    runOverChannel(receiver.genBaseOts(prng, sock), sock, chl);
+    runOverChannel(receiver.receive(choices, keys_, prng, sock), sock, chl);
+
+    for (size_t i = 0; i < count; ++i) {
+        choices_[i] = choices[i] ? 1 : 0;
+    }
+}
+
+std::vector<std::vector<uint8_t>> BatchOTReceiver::receiveBatch(size_t offset,
+                                                                const std::vector<uint8_t>& choices,
+                                                                size_t msg_bytes, Channel& chl,
+                                                                uint64_t* bytes_sent,
+                                                                uint64_t* bytes_received) const {
+    size_t count = choices.size();
+    if (offset + count > keys_.size()) {
+        throw std::runtime_error("Not enough precomputed OTs");
+    }
+
+    std::vector<uint8_t> corrections((count + 7) / 8, 0);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t d = (choices[i] & 1) ^ choices_[offset + i];
+        corrections[i >> 3] |= static_cast<uint8_t>(d << (i & 7));
+    }
+    chl.send(corrections.data(), corrections.size());
+
+    std::vector<uint8_t> payload(count * 2 * msg_bytes);
+    chl.recv(payload.data(), payload.size());
+
+    // y_b ⊕ H(k_c) = m_b
+    std::vector<std::vector<uint8_t>> result(count, std::vector<uint8_t>(msg_bytes));
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* y = payload.data() + (i * 2 + (choices[i] & 1)) * msg_bytes;
+        xorPad(keys_[offset + i], y, msg_bytes, result[i].data());
+    }
+
+    if (bytes_sent) *bytes_sent += corrections.size();
+    if (bytes_received) *bytes_received += payload.size();
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Network/Channel.h"
+
+using namespace osuCrypto;
+
+// 基于 libOTe IKNP 扩展的批量 1-out-of-2 OT。
+// 离线阶段：基础 OT 只运行一次，再一次性扩展出 count 个随机 OT 相关性；
+// 在线阶段：用 Beaver 去随机化，Receiver 发送一条打包的纠正比特消息，
+// Sender 回一条包含全部 (y0, y1) 的消息，任意数量的传输都只需一轮往返。
+// 在线消息为定长 msg_bytes 字节，多个线程可以在各自信道上使用互不重叠的区间。
+
+class BatchOTSender {
+public:
+    // 离线：生成 count 个随机 OT (k0, k1)
+    void setup(size_t count, Channel& chl, PRNG& prng);
+
+    size_t size() const { return keys_.size(); }
+
+    // 在线：发送第 [offset, offset + msgs0.size()) 个传输，msgs0/msgs1 为每个传输的两条消息；
+    // bytes_sent / bytes_received 为可选的通信量统计
+    void sendBatch(size_t offset,
+                   const std::vector<std::vector<uint8_t>>& msgs0,
+                   const std::vector<std::vector<uint8_t>>& msgs1,
+                   size_t msg_bytes, Channel& chl,
+                   uint64_t* bytes_sent = nullptr,
+                   uint64_t* bytes_received = nullptr) const;
+
+private:
+    std::vector<std::array<block, 2>> keys_;
+};
+
+class BatchOTReceiver {
+public:
+    // 离线：生成 count 个随机 OT (c, k_c)，c 为随机选择比特
+    void setup(size_t count, Channel& chl, PRNG& prng);
+
+    size_t size() const { return keys_.size(); }
+
+    // 在线：以 choices[i] 为选择比特接收第 offset + i 个传输，
+    // 返回选中的消息；bytes_sent / bytes_received 为可选的通信量统计
+    std::vector<std::vector<uint8_t>> receiveBatch(size_t offset,
+                                                   const std::vector<uint8_t>& choices,
+                                                   size_t msg_bytes, Channel& chl,
+                                                   uint64_t* bytes_sent = nullptr,
+                                                   uint64_t* bytes_received = nullptr) const;
+
+private:
+    std::vector<uint8_t> choices_;
+    std::vector<block> keys_;
+};
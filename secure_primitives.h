@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
 #include <seal/seal.h>
 #include "cryptoTools/Common/block.h"
 #include "cryptoTools/Crypto/PRNG.h"
@@ -55,13 +58,14 @@ public:
 // ============================================
 // FHE 阈值比较协议
 // ============================================
+// 协议的在线阶段使用 he_hamming.h 中的 HEHamming；本类（含批量接口）目前只由 fpsi_bench 的微基准调用
 class FHEThresholdComparison {
 public:
     FHEThresholdComparison(
         std::shared_ptr<SEALContext> context,
         const PublicKey& public_key,
         const SecretKey& secret_key
-    ) : context_(context) {
+    ) : context_(context), pool_(MemoryPoolHandle::New()) {
         encryptor_ = std::make_unique<Encryptor>(*context, public_key);
         decryptor_ = std::make_unique<Decryptor>(*context, secret_key);
         evaluator_ = std::make_unique<Evaluator>(*context);
@@ -75,10 +79,12 @@ public:
     ) {
         encrypted_shares.resize(shares_a.size());
         
+        Plaintext plain(pool_);
+        std::vector<uint64_t> slot(1);
         for (size_t i = 0; i < shares_a.size(); ++i) {
-            Plaintext plain;
-            encoder_->encode(std::vector<uint64_t>{shares_a[i]}, plain);
-            encryptor_->encrypt(plain, encrypted_shares[i]);
+            slot[0] = shares_a[i];
+            encoder_->encode(slot, plain);
+            encryptor_->encrypt(plain, encrypted_shares[i], pool_);
         }
     }
     
@@ -92,17 +98,19 @@ public:
         // 生成随机掩码
         random_mask = prng.get<uint64_t>() % 1000;
         
-        Ciphertext result;
+        Ciphertext result(pool_);
         bool first = true;
         
+        Plaintext plain_b(pool_);
+        Ciphertext diff(pool_);
+        std::vector<uint64_t> slot(1);
         for (size_t i = 0; i < shares_b.size(); ++i) {
             // 计算 a_i - b_i （同态）
-            Plaintext plain_b;
-            encoder_->encode(std::vector<uint64_t>{shares_b[i]}, plain_b);
+            slot[0] = shares_b[i];
+            encoder_->encode(slot, plain_b);
             
-            Ciphertext diff;
             evaluator_->negate(encrypted_a[i], diff);
-            evaluator_->add_plain_inplace(diff, plain_b);
+            evaluator_->add_plain_inplace(diff, plain_b, pool_);
             
             // 累加
             if (first) {
@@ -114,13 +122,150 @@ public:
         }
         
         // 加随机掩码
-        Plaintext plain_mask;
-        encoder_->encode(std::vector<uint64_t>{random_mask}, plain_mask);
-        evaluator_->add_plain_inplace(result, plain_mask);
+        slot[0] = random_mask;
+        encoder_->encode(slot, plain_b);
+        evaluator_->add_plain_inplace(result, plain_b, pool_);
         
         return result;
     }
     
+    // ---------- 批量版本：多个比较打包在同一密文的槽位中 ----------
+    // 第 c 个比较占据长度为 B（≥ 份额数的 2 的幂）的槽位块 [c·B, (c+1)·B)，
+    // B 整除行长 slots/2，因此块不会跨行，旋转求和后块首槽位即该比较的和。
+    
+    // 本实例内存池当前分配的字节数（高水位）
+    size_t memoryPoolBytes() const { return pool_.alloc_byte_count(); }
+    
+    // 每个比较占用的槽位块长度
+    static size_t blockSize(size_t shares_per_comparison) {
+        size_t block = 1;
+        while (block < shares_per_comparison) {
+            block <<= 1;
+        }
+        return block;
+    }
+    
+    // 块内旋转求和所需的 Galois 步长（Receiver 只需生成这些密钥）
+    static std::vector<int> galoisSteps(size_t shares_per_comparison) {
+        std::vector<int> steps;
+        for (size_t step = blockSize(shares_per_comparison) / 2; step >= 1; step >>= 1) {
+            steps.push_back(static_cast<int>(step));
+        }
+        return steps;
+    }
+    
+    // 单个密文可容纳的比较数
+    size_t comparisonsPerCiphertext(size_t shares_per_comparison) const {
+        return encoder_->slot_count() / blockSize(shares_per_comparison);
+    }
+    
+    // Sender 端进行旋转求和前需要设置 Galois 密钥
+    void setGaloisKeys(std::shared_ptr<const GaloisKeys> galois_keys) {
+        galois_keys_ = std::move(galois_keys);
+    }
+    
+    // Receiver端：把全部比较的 share_a 打包加密，
+    // 密文数为 ⌈比较数 / comparisonsPerCiphertext⌉ 而与份额数无关
+    void encryptReceiverSharesBatch(
+        const std::vector<std::vector<uint8_t>>& shares_a,
+        std::vector<Ciphertext>& encrypted_batches
+    ) {
+        std::vector<std::vector<uint64_t>> slots;
+        packShares(shares_a, slots);
+        
+        encrypted_batches.resize(slots.size());
+        Plaintext plain(pool_);
+        for (size_t k = 0; k < slots.size(); ++k) {
+            encoder_->encode(slots[k], plain);
+            encryptor_->encrypt(plain, encrypted_batches[k], pool_);
+        }
+    }
+    
+    // Sender端：每个批次一次 negate + 一次 add_plain 得到全部 b_i - a_i，
+    // log2(B) 次旋转完成块内求和，再对整批加随机掩码。
+    // random_masks[c] 为第 c 个比较块首槽位的掩码
+    std::vector<Ciphertext> computeMaskedSumBatch(
+        const std::vector<Ciphertext>& encrypted_batches,
+        const std::vector<std::vector<uint8_t>>& shares_b,
+        std::vector<uint64_t>& random_masks,
+        PRNG& prng
+    ) {
+        if (!galois_keys_) {
+            throw std::runtime_error("Galois keys not set for batched threshold comparison");
+        }
+        
+        std::vector<std::vector<uint64_t>> slots;
+        size_t block = packShares(shares_b, slots);
+        if (slots.size() != encrypted_batches.size()) {
+            throw std::runtime_error("Share batch count mismatch");
+        }
+        
+        size_t slot_count = encoder_->slot_count();
+        uint64_t t = context_->first_context_data()->parms().plain_modulus().value();
+        random_masks.resize(shares_b.size());
+        
+        std::vector<Ciphertext> results(slots.size(), Ciphertext(pool_));
+        Plaintext plain(pool_);
+        Ciphertext rotated(pool_);
+        std::vector<uint64_t> mask_slots(slot_count);
+        
+        for (size_t k = 0; k < slots.size(); ++k) {
+            evaluator_->negate(encrypted_batches[k], results[k]);
+            encoder_->encode(slots[k], plain);
+            evaluator_->add_plain_inplace(results[k], plain, pool_);
+            
+            for (size_t step = block / 2; step >= 1; step >>= 1) {
+                evaluator_->rotate_rows(results[k], static_cast<int>(step), *galois_keys_, rotated, pool_);
+                evaluator_->add_inplace(results[k], rotated);
+            }
+            
+            // 所有槽位均加掩码：非块首槽位含相邻块的部分和，不能以明文形式暴露
+            for (size_t i = 0; i < slot_count; ++i) {
+                mask_slots[i] = prng.get<uint64_t>() % t;
+            }
+            size_t first = k * (slot_count / block);
+            for (size_t c = first; c < std::min(first + slot_count / block, shares_b.size()); ++c) {
+                random_masks[c] = mask_slots[(c - first) * block];
+            }
+            encoder_->encode(mask_slots, plain);
+            evaluator_->add_plain_inplace(results[k], plain, pool_);
+        }
+        
+        return results;
+    }
+    
+    // Receiver端：每个批次一次解密，返回每个比较是否满足阈值
+    std::vector<uint8_t> decryptAndCompareBatch(
+        const std::vector<Ciphertext>& masked_results,
+        const std::vector<uint64_t>& random_masks,
+        size_t total_bits,
+        int threshold
+    ) {
+        size_t slot_count = encoder_->slot_count();
+        size_t block = blockSize(total_bits);
+        size_t per_cipher = slot_count / block;
+        uint64_t t = context_->first_context_data()->parms().plain_modulus().value();
+        
+        std::vector<uint8_t> results(random_masks.size());
+        Plaintext plain_result(pool_);
+        std::vector<uint64_t> decoded;
+        
+        for (size_t c = 0; c < random_masks.size(); ++c) {
+            size_t k = c / per_cipher;
+            if (k >= masked_results.size()) {
+                throw std::runtime_error("Missing masked result ciphertext");
+            }
+            if (c % per_cipher == 0) {
+                decryptor_->decrypt(masked_results[k], plain_result);
+                encoder_->decode(plain_result, decoded, pool_);
+            }
+            uint64_t sum = (decoded[(c % per_cipher) * block] + t - random_masks[c] % t) % t;
+            results[c] = meetsThreshold(sum, total_bits, threshold) ? 1 : 0;
+        }
+        
+        return results;
+    }
+    
     // Receiver端：解密并判断阈值
     bool decryptAndCompare(
         const Ciphertext& masked_result,
@@ -128,25 +273,60 @@ public:
         size_t total_bits,
         int threshold
     ) {
-        Plaintext plain_result;
+        Plaintext plain_result(pool_);
         decryptor_->decrypt(masked_result, plain_result);
         
         std::vector<uint64_t> decoded;
-        encoder_->decode(plain_result, decoded);
+        encoder_->decode(plain_result, decoded, pool_);
         
         // 移除掩码
         uint64_t match_count = (decoded[0] - random_mask) % (1ULL << 32);
         
-        // 判断是否满足阈值
-        // match_count = sum(a_i - b_i) = 匹配数 * 2
-        // 因为当匹配时 a_i = b_i，差为0；不匹配时差非0
-        int actual_matches = total_bits - (match_count / 2);
-        
-        return actual_matches >= (total_bits - threshold);
+        return meetsThreshold(match_count, total_bits, threshold);
     }
 
 private:
+    // 判断是否满足阈值
+    // match_count = sum(a_i - b_i) = 匹配数 * 2
+    // 因为当匹配时 a_i = b_i，差为0；不匹配时差非0
+    static bool meetsThreshold(uint64_t match_count, size_t total_bits, int threshold) {
+        int64_t actual_matches = static_cast<int64_t>(total_bits) - static_cast<int64_t>(match_count / 2);
+        
+        return actual_matches >= static_cast<int64_t>(total_bits) - threshold;
+    }
+    
+    // 把每个比较的份额写入其槽位块（不足 B 的部分补 0，对差值无贡献），
+    // 超出单个密文容量时顺延到下一组槽位。返回块长度 B
+    size_t packShares(
+        const std::vector<std::vector<uint8_t>>& shares,
+        std::vector<std::vector<uint64_t>>& slots
+    ) const {
+        size_t max_shares = 1;
+        for (const auto& s : shares) {
+            max_shares = std::max(max_shares, s.size());
+        }
+        
+        size_t slot_count = encoder_->slot_count();
+        size_t block = blockSize(max_shares);
+        if (block > slot_count / 2) {
+            throw std::runtime_error("Too many shares per comparison for one ciphertext row");
+        }
+        size_t per_cipher = slot_count / block;
+        
+        slots.assign((shares.size() + per_cipher - 1) / per_cipher,
+                     std::vector<uint64_t>(slot_count, 0));
+        for (size_t c = 0; c < shares.size(); ++c) {
+            uint64_t* dst = slots[c / per_cipher].data() + (c % per_cipher) * block;
+            for (size_t i = 0; i < shares[c].size(); ++i) {
+                dst[i] = shares[c][i];
+            }
+        }
+        return block;
+    }
+    
+    std::shared_ptr<const GaloisKeys> galois_keys_;
     std::shared_ptr<SEALContext> context_;
+    MemoryPoolHandle pool_;     // 每个实例独立的内存池，并行时每个线程各建一个实例
     std::unique_ptr<Encryptor> encryptor_;
     std::unique_ptr<Decryptor> decryptor_;
     std::unique_ptr<Evaluator> evaluator_;
@@ -210,6 +390,46 @@ public:
             return result == 1;
         }
     }
+    
+    // 批量结果公开：Receiver 解密阈值测试时本就得到逐候选标志 e，自行按查询求 OR，
+    // 再把每个查询的匹配位按位打包发给 Sender（一条 ⌈num_queries/8⌉ 字节的消息）。
+    // 这一步不是隐私保护的等值测试：Sender 得知每个查询是否有匹配，即交集中的查询下标，
+    // 但不知道是哪个、有几个候选匹配；Receiver 不额外得到任何信息。
+    // 对 e 做异或分享后再比较只多一轮往返，泄露的仍是同一组匹配位
+    static void sendAnyOneBatch(const std::vector<uint8_t>& row_matches, Channel& chl) {
+        if (row_matches.empty()) {
+            return;
+        }
+        std::vector<uint8_t> packed((row_matches.size() + 7) / 8);
+        packBits(row_matches, packed);
+        chl.send(packed.data(), packed.size());
+    }
+    
+    // Sender：接收 sendAnyOneBatch 发出的 num_queries 个匹配位
+    static std::vector<uint8_t> receiveAnyOneBatch(size_t num_queries, Channel& chl) {
+        std::vector<uint8_t> results(num_queries);
+        if (num_queries == 0) {
+            return results;
+        }
+        std::vector<uint8_t> packed((num_queries + 7) / 8);
+        chl.recv(packed.data(), packed.size());
+        for (size_t j = 0; j < num_queries; ++j) {
+            results[j] = getBit(packed, j);
+        }
+        return results;
+    }
+    
+    // 按位打包：bits[i] 的最低位写入 packed 的第 i 位，packed 需要有 ⌈bits.size()/8⌉ 字节
+    static void packBits(const std::vector<uint8_t>& bits, std::vector<uint8_t>& packed) {
+        std::fill(packed.begin(), packed.end(), 0);
+        for (size_t i = 0; i < bits.size(); ++i) {
+            packed[i >> 3] |= static_cast<uint8_t>((bits[i] & 1) << (i & 7));
+        }
+    }
+    
+    static uint8_t getBit(const std::vector<uint8_t>& bytes, size_t i) {
+        return (bytes[i >> 3] >> (i & 7)) & 1;
+    }
 };
 
 // ============================================
@@ -269,11 +489,21 @@ private:
     template<typename T>
     static std::vector<uint8_t> encryptMessage(const T& msg, block key) {
         // 简化加密：XOR with key
+        // std::vector<uint8_t> 需要加密其内容，而不是 vector 对象本身
+        const uint8_t* msg_bytes;
+        size_t len;
+        if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            msg_bytes = msg.data();
+            len = msg.size();
+        } else {
+            msg_bytes = reinterpret_cast<const uint8_t*>(&msg);
+            len = sizeof(T);
+        }
+        
         std::vector<uint8_t> result;
-        const uint8_t* msg_bytes = reinterpret_cast<const uint8_t*>(&msg);
         const uint8_t* key_bytes = reinterpret_cast<const uint8_t*>(&key);
         
-        for (size_t i = 0; i < sizeof(T); ++i) {
+        for (size_t i = 0; i < len; ++i) {
             result.push_back(msg_bytes[i] ^ key_bytes[i % sizeof(block)]);
         }
         return result;
@@ -282,10 +512,19 @@ private:
     template<typename T>
     static T decryptMessage(const std::vector<uint8_t>& enc, block key) {
         T result;
-        uint8_t* result_bytes = reinterpret_cast<uint8_t*>(&result);
+        uint8_t* result_bytes;
+        size_t len;
+        if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+            result.resize(enc.size());
+            result_bytes = result.data();
+            len = enc.size();
+        } else {
+            result_bytes = reinterpret_cast<uint8_t*>(&result);
+            len = sizeof(T);
+        }
         const uint8_t* key_bytes = reinterpret_cast<const uint8_t*>(&key);
         
-        for (size_t i = 0; i < sizeof(T); ++i) {
+        for (size_t i = 0; i < len; ++i) {
             result_bytes[i] = enc[i] ^ key_bytes[i % sizeof(block)];
         }
         return result;
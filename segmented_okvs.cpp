@@ -0,0 +1,191 @@
+#include "segmented_okvs.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+std::vector<block> tagValues(const block* keys, const block* values, size_t n) {
+    std::vector<block> tagged(n);
+    for (size_t i = 0; i < n; ++i) {
+        tagged[i] = SegmentedOkvs::withTag(keys[i], values[i]);
+    }
+    return tagged;
+}
+
+ShardedOkvs encodeBase(const block* keys, const block* values, size_t n, block seed,
+                       ThreadPool* pool) {
+    std::vector<block> tagged = tagValues(keys, values, n);
+    ShardedOkvs base;
+    base.encode(keys, tagged.data(), n, 0, seed, pool);
+    return base;
+}
+
+}
+
+uint32_t SegmentedOkvs::tag(const block& key) {
+    // 与分片选择使用不同的混合常数，标签与分片号相互独立
+    uint64_t z = key.get<uint64_t>(1) ^ (key.get<uint64_t>(0) * 0xd6e8feb86659fd93ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return static_cast<uint32_t>(z >> 32);
+}
+
+block SegmentedOkvs::withTag(const block& key, const block& value) {
+    uint64_t high = (value.get<uint64_t>(1) & 0xffffffffULL) |
+                    (static_cast<uint64_t>(tag(key)) << 32);
+    return block(high, value.get<uint64_t>(0));
+}
+
+void SegmentedOkvs::resetBase(const block* keys, const block* values, size_t n, block seed,
+                              ThreadPool* pool) {
+    setBase(encodeBase(keys, values, n, seed, pool));
+}
+
+void SegmentedOkvs::setBase(ShardedOkvs base) {
+    finishCompaction(true);
+    base_ = std::move(base);
+    deltas_.clear();
+}
+
+int SegmentedOkvs::appendSegment(const block* keys, const block* values, size_t n, block seed) {
+    if (numSegments() == 0) {
+        throw std::runtime_error("OKVS base segment not initialized");
+    }
+
+    std::vector<block> tagged = tagValues(keys, values, n);
+    deltas_.push_back(ShardedOkvs::encodeSingle(keys, tagged.data(), n, seed));
+    return numSegments() - 1;
+}
+
+void SegmentedOkvs::startCompaction(std::vector<block> keys, std::vector<block> values,
+                                    block seed) {
+    if (compaction_) {
+        throw std::runtime_error("OKVS compaction already running");
+    }
+
+    auto compaction = std::make_unique<Compaction>();
+    compaction->snapshot_segments = numSegments();
+    compaction->result = std::async(std::launch::async,
+        [keys = std::move(keys), values = std::move(values), seed]() {
+            return encodeBase(keys.data(), values.data(), keys.size(), seed, nullptr);
+        });
+    compaction_ = std::move(compaction);
+}
+
+bool SegmentedOkvs::finishCompaction(bool wait) {
+    if (!compaction_) {
+        return false;
+    }
+    if (!wait && compaction_->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    std::unique_ptr<Compaction> compaction = std::move(compaction_);
+    install(compaction->result.get(), compaction->snapshot_segments);
+    return true;
+}
+
+void SegmentedOkvs::install(ShardedOkvs base, int snapshot_segments) {
+    // 快照覆盖基础段与前 snapshot_segments - 1 个 delta 段
+    base_ = std::move(base);
+    deltas_.erase(deltas_.begin(), deltas_.begin() + (snapshot_segments - 1));
+    ++generation_;
+}
+
+void SegmentedOkvs::decodeBatch(const block* keys, size_t n, block* out, uint8_t* found,
+                                ThreadPool* pool) const {
+    if (numSegments() == 0) {
+        throw std::runtime_error("OKVS not initialized");
+    }
+
+    std::fill(found, found + n, 0);
+
+    // 从最新的段往前，每段只解码仍未找到的键
+    std::vector<block> pending_keys(keys, keys + n);
+    std::vector<size_t> origin(n);
+    for (size_t i = 0; i < n; ++i) {
+        origin[i] = i;
+    }
+
+    std::vector<block> decoded;
+    for (int s = numSegments() - 1; s >= 0 && !pending_keys.empty(); --s) {
+        decoded.resize(pending_keys.size());
+        if (s == 0) {
+            base_.decodeBatch(pending_keys.data(), pending_keys.size(), decoded.data(), pool);
+        } else {
+            ShardedOkvs::decodeShardBatch(deltas_[s - 1], pending_keys.data(), pending_keys.size(),
+                                          decoded.data(), pool);
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < pending_keys.size(); ++i) {
+            if (tagMatches(pending_keys[i], decoded[i])) {
+                out[origin[i]] = decoded[i];
+                found[origin[i]] = 1;
+            } else {
+                pending_keys[kept] = pending_keys[i];
+                origin[kept] = origin[i];
+                ++kept;
+            }
+        }
+        pending_keys.resize(kept);
+        origin.resize(kept);
+    }
+}
+
+size_t SegmentedOkvs::deltaItems() const {
+    size_t total = 0;
+    for (const auto& delta : deltas_) {
+        total += delta.n_items;
+    }
+    return total;
+}
+
+uint64_t SegmentedOkvs::sendSince(Channel& chl, uint64_t peer_generation, int peer_segments) const {
+    uint32_t first = 0;
+    if (peer_generation == generation_ && peer_segments > 0 && peer_segments <= numSegments()) {
+        first = static_cast<uint32_t>(peer_segments);
+    }
+    uint32_t count = static_cast<uint32_t>(numSegments()) - first;
+
+    chl.send(generation_);
+    chl.send(first);
+    chl.send(count);
+    uint64_t bytes = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+    // 第 0 段按分片 OKVS 的格式发送（分片数 + 各分片），delta 段逐个发送
+    for (uint32_t s = first; s < first + count; ++s) {
+        bytes += s == 0 ? base_.send(chl) : ShardedOkvs::sendShard(chl, deltas_[s - 1]);
+    }
+
+    return bytes;
+}
+
+uint64_t SegmentedOkvs::receiveUpdate(Channel& chl) {
+    uint64_t generation = 0;
+    uint32_t first = 0, count = 0;
+    chl.recv(generation);
+    chl.recv(first);
+    chl.recv(count);
+    uint64_t bytes = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+    if (first > static_cast<uint32_t>(numSegments()) || (first == 0 && count == 0)) {
+        throw std::runtime_error("OKVS update does not extend local segments");
+    }
+    deltas_.resize(first > 0 ? first - 1 : 0);
+
+    for (uint32_t s = first; s < first + count; ++s) {
+        if (s == 0) {
+            bytes += base_.receive(chl);
+        } else {
+            deltas_.emplace_back();
+            bytes += ShardedOkvs::receiveShard(chl, deltas_.back());
+        }
+    }
+
+    generation_ = generation;
+    return bytes;
+}
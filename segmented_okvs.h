@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <future>
+#include <cstdint>
+#include <cstddef>
+#include "cryptoTools/Common/block.h"
+#include "cryptoTools/Network/Channel.h"
+#include "okvs_shard.h"
+#include "thread_pool.h"
+
+using namespace osuCrypto;
+
+// 追加式分段 OKVS：一个基础段之后追加若干 delta 段。基础段是分片 OKVS（各分片可并行编码，
+// 也不受单个 band OKVS 的规模上限限制），delta 段各是一个独立的 band OKVS。
+// 数据库增量更新时只为新增记录编码一个小 delta 段，对方只需拉取新增的段。
+//
+// 值的最高 32 位存放键的校验标签：键不在某段中时解码结果是随机的，标签吻合的概率只有 2^-32，
+// 因此解码时从最新的段往前找，第一个标签吻合的段给出该键的值，后写入的值覆盖旧值。
+// 段数增多后解码代价线性增长，压缩把全部存活的键重新编码为新的基础段（generation 加一），
+// 压缩在后台线程上执行，期间仍可以继续追加 delta 段。
+class SegmentedOkvs {
+public:
+    // 调用方的值只能使用低 96 位，最高 32 位由标签覆盖
+    static uint32_t tag(const block& key);
+    static block withTag(const block& key, const block& value);
+    static bool tagMatches(const block& key, const block& decoded) {
+        return static_cast<uint32_t>(decoded.get<uint64_t>(1) >> 32) == tag(key);
+    }
+
+    // 用 n 个键值对重建基础段（值在内部加标签），分片数自动选择，pool 非空时各分片并行编码
+    void resetBase(const block* keys, const block* values, size_t n, block seed,
+                   ThreadPool* pool = nullptr);
+
+    // 直接安装已编码的基础段（接收方或从缓存加载时使用），丢弃全部 delta 段
+    void setBase(ShardedOkvs base);
+
+    // 为 n 个新增或修改的键值对追加一个 delta 段，返回段号
+    int appendSegment(const block* keys, const block* values, size_t n, block seed);
+
+    // 后台压缩：在独立线程上把 (keys, values) 编码为新的基础段（分片逐个编码，不占用线程池）。
+    // 安装时保留压缩开始之后追加的 delta 段
+    void startCompaction(std::vector<block> keys, std::vector<block> values, block seed);
+    bool compactionPending() const { return compaction_ != nullptr; }
+
+    // 压缩已完成则安装并返回 true；wait 为 true 时阻塞直到完成
+    bool finishCompaction(bool wait = false);
+
+    // 批量解码：found[i] 表示是否有段的标签吻合，out[i] 为该段的解码值
+    void decodeBatch(const block* keys, size_t n, block* out, uint8_t* found,
+                     ThreadPool* pool = nullptr) const;
+
+    uint64_t generation() const { return generation_; }
+    int numSegments() const { return base_.numShards() > 0 ? 1 + static_cast<int>(deltas_.size()) : 0; }
+    const ShardedOkvs& base() const { return base_; }
+
+    // delta 段中的键数（不含基础段）
+    size_t deltaItems() const;
+
+    // 增量同步：对方持有 (peer_generation, peer_segments) 时只发送之后的段；
+    // 期间发生过压缩时从基础段开始全部发送。返回发送的字节数
+    uint64_t sendSince(Channel& chl, uint64_t peer_generation, int peer_segments) const;
+
+    // 接收 sendSince 发送的段并合并到本地，返回接收的字节数
+    uint64_t receiveUpdate(Channel& chl);
+
+private:
+    struct Compaction {
+        std::future<ShardedOkvs> result;
+        int snapshot_segments;      // 压缩快照覆盖的段数
+    };
+
+    void install(ShardedOkvs base, int snapshot_segments);
+
+    ShardedOkvs base_;                  // 第 0 段
+    std::vector<OkvsShard> deltas_;     // 第 1.. 段
+    uint64_t generation_ = 0;
+    std::unique_ptr<Compaction> compaction_;
+};
@@ -0,0 +1,101 @@
+#include "session_server.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace session_server {
+
+Options extractFlags(int& argc, char** argv) {
+    Options options;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        bool serve = std::strcmp(argv[i], "--serve") == 0;
+        bool concurrency = std::strcmp(argv[i], "--concurrency") == 0;
+        if (serve || concurrency) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(std::string(argv[i]) + " requires a value");
+            }
+            int value = std::atoi(argv[++i]);
+            if (serve) {
+                options.enabled = true;
+                options.max_sessions = value;
+            } else {
+                options.max_concurrent = std::max(value, 1);
+            }
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    return options;
+}
+
+void run(IOService& ios, const std::string& address, const Options& options,
+         const std::function<void(int, Channel&)>& handler) {
+    struct Worker {
+        std::thread thread;
+        bool done = false;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::list<Worker> workers;
+    int active = 0;
+
+    // 结束的会话线程及时回收，长期运行时线程列表不会无限增长
+    auto reap = [&]() {
+        for (auto it = workers.begin(); it != workers.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = workers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    };
+
+    for (int id = 0; options.max_sessions <= 0 || id < options.max_sessions; ++id) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return active < options.max_concurrent; });
+            reap();
+        }
+
+        // 同一地址上的每个 Server Session 对应下一个连接进来的 Sender
+        auto session = std::make_shared<Session>(ios, address, SessionMode::Server);
+        Channel chl = session->addChannel();
+        chl.waitForConnection();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++active;
+        workers.emplace_back();
+        Worker* worker = &workers.back();
+        worker->thread = std::thread([&, session, chl, id, worker]() mutable {
+            try {
+                handler(id, chl);
+            } catch (const std::exception& e) {
+                std::cerr << "Session " << id << " failed: " << e.what() << std::endl;
+            }
+            chl.close();
+            session->stop();
+
+            std::lock_guard<std::mutex> done_lock(mutex);
+            worker->done = true;
+            --active;
+            cv.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return active == 0; });
+    reap();
+}
+
+}
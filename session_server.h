@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include "cryptoTools/Network/Channel.h"
+#include "cryptoTools/Network/Session.h"
+#include "cryptoTools/Network/IOService.h"
+
+using namespace osuCrypto;
+
+// 长期运行的多会话服务：在同一地址上循环接受 Sender 会话，每个会话在独立线程上执行 handler。
+// 离线产物由调用方在开始服务前准备好，会话之间只读共享；会话私有的状态由 handler 自行创建
+namespace session_server {
+    struct Options {
+        bool enabled = false;
+        int max_sessions = 0;       // 服务的会话总数，<= 0 表示不限
+        int max_concurrent = 4;     // 同时运行的会话数上限
+    };
+
+    // 从命令行中取出 "--serve N" 与 "--concurrency C"（会从 argv 中移除）。
+    // 出现 --serve 即启用服务模式，N 为会话总数（0 表示不限）
+    Options extractFlags(int& argc, char** argv);
+
+    // 依次接受会话并调用 handler(session_id, channel)，达到并发上限时等待已有会话结束。
+    // 单个会话抛出的异常只结束该会话，不影响服务；返回前等待所有会话结束
+    void run(IOService& ios, const std::string& address, const Options& options,
+             const std::function<void(int, Channel&)>& handler);
+}
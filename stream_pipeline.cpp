@@ -0,0 +1,37 @@
+#include "stream_pipeline.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace stream_pipeline {
+
+Options extractFlags(int& argc, char** argv) {
+    Options options;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        bool stream = std::strcmp(argv[i], "--stream") == 0;
+        bool depth = std::strcmp(argv[i], "--stream-depth") == 0;
+        if (stream || depth) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(std::string(argv[i]) + " requires a value");
+            }
+            int value = std::atoi(argv[++i]);
+            if (stream) {
+                options.enabled = true;
+                if (value > 0) {
+                    options.batch_queries = value;
+                }
+            } else {
+                options.depth = std::max(value, 1);
+            }
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    return options;
+}
+
+}
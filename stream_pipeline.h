@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <utility>
+
+// 流式查询模式：查询按批读取并依次通过各处理阶段，阶段之间只缓存有限个批次，
+// 内存占用只取决于批大小与队列深度，与查询总数无关
+namespace stream_pipeline {
+    struct Options {
+        bool enabled = false;
+        int batch_queries = 65536;  // 每批的查询数
+        int depth = 2;              // 阶段之间最多缓存的批次数
+    };
+
+    // 从命令行中取出 "--stream B" 与 "--stream-depth K"（会从 argv 中移除）。
+    // 出现 --stream 即启用流式模式，B 为每批的查询数（<= 0 时使用默认值）
+    Options extractFlags(int& argc, char** argv);
+}
+
+// 有界阻塞队列：队列满时 push 阻塞，形成阶段之间的背压；
+// close 之后 push 返回 false，pop 取完剩余元素后返回 false
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    bool closed_ = false;
+};
@@ -0,0 +1,118 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+int ThreadPool::hardwareThreads() {
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : static_cast<int>(hw);
+}
+
+ThreadPool::ThreadPool(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = hardwareThreads();
+    }
+
+    // 调用线程也参与 parallelFor，因此只需再启动 num_threads - 1 个工作线程
+    for (int t = 1; t < num_threads; ++t) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push(std::move(job));
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+
+            if (stopping_ && jobs_.empty()) {
+                return;
+            }
+
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+        job();
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, size_t chunk,
+                             const std::function<void(size_t, size_t)>& fn) {
+    if (n == 0) {
+        return;
+    }
+
+    chunk = std::max<size_t>(chunk, 1);
+    size_t num_chunks = (n + chunk - 1) / chunk;
+
+    if (workers_.empty() || num_chunks == 1) {
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            fn(begin, std::min(begin + chunk, n));
+        }
+        return;
+    }
+
+    // 各线程从共享计数器领取块，直到全部领完
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+
+    auto run = [state, n, chunk, num_chunks, &fn]() {
+        size_t c;
+        while ((c = state->next.fetch_add(1)) < num_chunks) {
+            size_t begin = c * chunk;
+            try {
+                fn(begin, std::min(begin + chunk, n));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+
+            if (state->done.fetch_add(1) + 1 == num_chunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(workers_.size(), num_chunks - 1);
+    for (size_t t = 0; t < helpers; ++t) {
+        enqueue(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done.load() == num_chunks; });
+
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
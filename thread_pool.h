@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstddef>
+
+// 固定大小的线程池
+// parallelFor 将 [0, n) 切分为连续的块分发给工作线程（调用线程也参与计算），
+// 每个块只写自己的输出区间，因此结果与串行执行完全一致。
+class ThreadPool {
+public:
+    // num_threads <= 0 时使用全部硬件线程
+    explicit ThreadPool(int num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 参与计算的线程数（包括调用线程）
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // 并行执行 fn(begin, end)，阻塞直到所有块完成；任一块抛出的异常会在此重新抛出
+    void parallelFor(size_t n, size_t chunk,
+                     const std::function<void(size_t, size_t)>& fn);
+
+    // 异步提交一个任务
+    template<typename F>
+    auto submit(F&& task) -> std::future<decltype(task())> {
+        using R = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    static int hardwareThreads();
+
+private:
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
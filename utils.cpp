@@ -1,8 +1,13 @@
 #include "utils.h"
+#include "hamming.h"
 #include <iostream>
 #include <fstream>
 #include <algorithm>
 #include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
 
 void CommStats::print(const std::string& phase) const {
     std::cout << phase << " 通信统计:" << std::endl;
@@ -14,9 +19,14 @@ void CommStats::print(const std::string& phase) const {
 namespace utils {
 
 std::vector<uint8_t> generateRandomBinaryVector(int d, PRNG& prng) {
+    // 每次从 PRNG 取 64 位，而不是逐位调用 getBit()
     std::vector<uint8_t> vec(d);
-    for (int i = 0; i < d; ++i) {
-        vec[i] = prng.getBit();
+    for (int w = 0; w * 64 < d; ++w) {
+        uint64_t bits = prng.get<uint64_t>();
+        int end = std::min(64, d - w * 64);
+        for (int i = 0; i < end; ++i) {
+            vec[w * 64 + i] = (bits >> i) & 1;
+        }
     }
     return vec;
 }
@@ -37,9 +47,9 @@ std::vector<uint8_t> generateVectorWithDistance(
         positions[i] = i;
     }
     
-    // Fisher-Yates 洗牌
-    for (int i = d - 1; i > 0; --i) {
-        int j = prng.get<uint32_t>() % (i + 1);
+    // 部分 Fisher-Yates：只需确定前 distance 个位置
+    for (int i = 0; i < distance; ++i) {
+        int j = i + prng.get<uint32_t>() % (d - i);
         std::swap(positions[i], positions[j]);
     }
     
@@ -56,14 +66,34 @@ int hammingDistance(const std::vector<uint8_t>& v1, const std::vector<uint8_t>&
     size_t minSize = std::min(v1.size(), v2.size());
     
     for (size_t i = 0; i < minSize; ++i) {
-        if (v1[i] != v2[i]) {
-            ++dist;
-        }
+        dist += (v1[i] != v2[i]);
     }
     
     return dist;
 }
 
+int hammingDistance(const BitView& v1, const BitView& v2) {
+    int words = std::min(v1.wordCount(), v2.wordCount());
+    return static_cast<int>(hammingDistanceWords(v1.words, v2.words, words));
+}
+
+// 读取打包向量从第 offset 位开始的 64 位，越界部分补 0
+static uint64_t extractWord(const BitView& vec, int offset) {
+    if (offset >= vec.d) {
+        return 0;
+    }
+    
+    int word = offset >> 6;
+    int shift = offset & 63;
+    uint64_t value = vec.words[word] >> shift;
+    
+    if (shift != 0 && word + 1 < vec.wordCount()) {
+        value |= vec.words[word + 1] << (64 - shift);
+    }
+    
+    return value;
+}
+
 block vectorToBlock(const std::vector<uint8_t>& vec, int offset) {
     uint64_t low = 0, high = 0;
     
@@ -82,6 +112,47 @@ block vectorToBlock(const std::vector<uint8_t>& vec, int offset) {
     return block(low, high);
 }
 
+block vectorToBlock(const BitView& vec, int offset) {
+    uint64_t low = extractWord(vec, offset);
+    uint64_t high = extractWord(vec, offset + 64);
+    
+    return block(low, high);
+}
+
+block vectorFingerprint(const BitView& vec) {
+    if (vec.d <= 128) {
+        return vectorToBlock(vec, 0);
+    }
+    
+    // 两路 splitmix64 链分别吸收奇偶下标的字，最后交叉混合
+    auto mix = [](uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    };
+    
+    uint64_t lane[2] = {0x9e3779b97f4a7c15ULL ^ static_cast<uint64_t>(vec.d), 0xd6e8feb86659fd93ULL};
+    int words = vec.wordCount();
+    for (int w = 0; w < words; ++w) {
+        lane[w & 1] = mix(lane[w & 1] ^ vec.words[w]);
+    }
+    
+    uint64_t low = mix(lane[0] ^ (lane[1] >> 1));
+    uint64_t high = mix(lane[1] ^ low);
+    return block(low, high);
+}
+
+void expandMask(const block& seed, uint64_t* out, int words) {
+    uint64_t counter = seed.get<uint64_t>(0);
+    uint64_t key = seed.get<uint64_t>(1);
+    for (int w = 0; w < words; ++w) {
+        uint64_t z = (counter += 0x9e3779b97f4a7c15ULL) ^ key;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        out[w] = z ^ (z >> 31);
+    }
+}
+
 std::vector<uint8_t> blockToVector(const block& b, int d) {
     std::vector<uint8_t> vec(d);
     
@@ -125,12 +196,9 @@ void saveStats(const std::string& filename,
                const CommStats& online_comm,
                int n, int d, int delta) {
     
-    std::ofstream file(filename, std::ios::app);
-    if (!file.is_open()) {
-        std::cerr << "无法打开文件: " << filename << std::endl;
-        return;
-    }
-    
+    // 两端常在同一目录下同时结束：整条记录先写入内存，再在文件锁下一次 write 追加，
+    // 避免两条记录交错
+    std::ostringstream file;
     file << "========================================" << std::endl;
     file << "角色: " << role << std::endl;
     file << "参数: n=" << n << ", d=" << d << ", δ=" << delta << std::endl;
@@ -157,7 +225,25 @@ void saveStats(const std::string& filename,
          << " MB" << std::endl;
     file << std::endl;
     
-    file.close();
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return;
+    }
+    
+    std::string record = file.str();
+    ::flock(fd, LOCK_EX);
+    size_t written = 0;
+    while (written < record.size()) {
+        ssize_t chunk = ::write(fd, record.data() + written, record.size() - written);
+        if (chunk <= 0) {
+            std::cerr << "写入失败: " << filename << std::endl;
+            break;
+        }
+        written += static_cast<size_t>(chunk);
+    }
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
 }
 
 } // namespace utils
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include "cryptoTools/Common/Defines.h"
 #include "cryptoTools/Crypto/PRNG.h"
+#include "bit_vector.h"
 
 using namespace osuCrypto;
 
@@ -32,6 +33,13 @@ public:
         return duration.count() / 1000.0;
     }
 
+    // 计时尚未结束时，从 start() 到现在经过的时间
+    double getElapsedSecondsSoFar() const {
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - start_time_);
+        return duration.count() / 1000000.0;
+    }
+
 private:
     std::chrono::high_resolution_clock::time_point start_time_;
     std::chrono::high_resolution_clock::time_point end_time_;
@@ -56,6 +64,12 @@ public:
         bytes_received_ = 0;
     }
     
+    // 合并其他线程 / 信道的统计
+    void merge(const CommStats& other) {
+        bytes_sent_ += other.bytes_sent_;
+        bytes_received_ += other.bytes_received_;
+    }
+    
     void print(const std::string& phase) const;
 
 private:
@@ -75,9 +89,24 @@ namespace utils {
     // 计算 Hamming 距离
     int hammingDistance(const std::vector<uint8_t>& v1, const std::vector<uint8_t>& v2);
     
+    // 计算打包向量的 Hamming 距离（按字 XOR + popcount）
+    int hammingDistance(const BitView& v1, const BitView& v2);
+    
     // 将向量转换为 block
     block vectorToBlock(const std::vector<uint8_t>& vec, int offset = 0);
     
+    // 将打包向量从第 offset 位开始的 128 位转换为 block（与字节版本结果一致）。
+    // 只取 128 位，d > 128 时需要完整向量的调用方应使用 vectorFingerprint
+    block vectorToBlock(const BitView& vec, int offset = 0);
+    
+    // 整个向量的 128 位摘要：d <= 128 时与 vectorToBlock(vec, 0) 相同（无损），
+    // d > 128 时每个字都参与混合，不再静默截断为前 128 位
+    block vectorFingerprint(const BitView& vec);
+    
+    // 以 seed 为种子按计数器模式扩展出 words 个 64 位掩码字（splitmix64），
+    // 相同的 seed 总是得到相同的掩码
+    void expandMask(const block& seed, uint64_t* out, int words);
+    
     // 将 block 转换为向量
     std::vector<uint8_t> blockToVector(const block& b, int d);
     
@@ -0,0 +1,74 @@
+#include "zero_pool.h"
+#include <algorithm>
+
+EncryptedZeroPool::EncryptedZeroPool(std::shared_ptr<SEALContext> context,
+                                     const PublicKey& public_key)
+    : EncryptedZeroPool(context, public_key, context->first_parms_id()) {}
+
+EncryptedZeroPool::EncryptedZeroPool(std::shared_ptr<SEALContext> context,
+                                     const PublicKey& public_key,
+                                     parms_id_type parms_id)
+    : context_(context), public_key_(public_key), parms_id_(parms_id) {
+    encryptor_ = std::make_unique<Encryptor>(*context_, public_key_);
+}
+
+EncryptedZeroPool::~EncryptedZeroPool() {
+    stop_ = true;
+    wait();
+}
+
+void EncryptedZeroPool::startFill(size_t count, int threads) {
+    threads = std::max(threads, 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.reserve(items_.size() + count);
+    }
+
+    size_t base = count / threads;
+    size_t extra = count % threads;
+    for (int t = 0; t < threads; ++t) {
+        size_t share = base + (static_cast<size_t>(t) < extra ? 1 : 0);
+        if (share > 0) {
+            fillers_.emplace_back(&EncryptedZeroPool::fillWorker, this, share);
+        }
+    }
+}
+
+void EncryptedZeroPool::wait() {
+    for (auto& filler : fillers_) {
+        filler.join();
+    }
+    fillers_.clear();
+}
+
+void EncryptedZeroPool::fillWorker(size_t count) {
+    // 每个后台线程使用自己的 Encryptor 和内存池
+    Encryptor encryptor(*context_, public_key_);
+    MemoryPoolHandle pool = MemoryPoolHandle::New();
+    for (size_t i = 0; i < count && !stop_; ++i) {
+        Ciphertext zero(pool);
+        encryptor.encrypt_zero(parms_id_, zero, pool);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.push_back(std::move(zero));
+    }
+}
+
+void EncryptedZeroPool::take(Ciphertext& destination) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!items_.empty()) {
+            destination = std::move(items_.back());
+            items_.pop_back();
+            return;
+        }
+    }
+
+    ++misses_;
+    encryptor_->encrypt_zero(parms_id_, destination);
+}
+
+size_t EncryptedZeroPool::available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <seal/seal.h>
+
+using namespace seal;
+
+// 预先计算的 Enc(0) 池。公钥加密是 Sender 在线阶段最昂贵的操作，
+// 离线阶段由后台线程批量生成新鲜的 Enc(0)，在线时取出即可：
+// 重随机化为 ct + Enc(0)，新鲜加密 Enc(m) 为 Enc(0) + m（add_plain）。
+// 每个条目只使用一次；池取空后退回到当场加密，结果分布不变。
+class EncryptedZeroPool {
+public:
+    EncryptedZeroPool(std::shared_ptr<SEALContext> context, const PublicKey& public_key);
+
+    // 条目直接加密在 parms_id 层（与使用方的密文同层，条目也更小）
+    EncryptedZeroPool(std::shared_ptr<SEALContext> context, const PublicKey& public_key,
+                      parms_id_type parms_id);
+    ~EncryptedZeroPool();
+
+    EncryptedZeroPool(const EncryptedZeroPool&) = delete;
+    EncryptedZeroPool& operator=(const EncryptedZeroPool&) = delete;
+
+    // 启动 threads 个后台线程共生成 count 个条目，立即返回
+    void startFill(size_t count, int threads = 1);
+
+    // 等待后台生成结束
+    void wait();
+
+    // 取出一个 Enc(0)，可被多个线程同时调用
+    void take(Ciphertext& destination);
+
+    size_t available() const;
+
+    // 池为空时当场加密的次数
+    size_t misses() const { return misses_.load(); }
+
+private:
+    void fillWorker(size_t count);
+
+    std::shared_ptr<SEALContext> context_;
+    PublicKey public_key_;
+    parms_id_type parms_id_;
+    std::unique_ptr<Encryptor> encryptor_;    // 池为空时使用
+
+    mutable std::mutex mutex_;
+    std::vector<Ciphertext> items_;
+    std::vector<std::thread> fillers_;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> misses_{0};
+};